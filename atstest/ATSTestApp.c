@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <mpeg2ts_demux.h>
 #include <libts_common.h>
 #include <tpes.h>
+#include <ts_source.h>
 #include <ebp.h>
 #include <scte35.h>
 #include <pthread.h>
@@ -42,6 +43,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "EBPStreamIngestThread.h"
 #include "EBPSegmentAnalysisThread.h"
 #include "EBPSocketReceiveThread.h"
+#include "EBPThreadPlacement.h"
 
 #include "ATSTestApp.h"
 #include "ATSTestReport.h"
@@ -59,6 +61,7 @@ static int g_bEBPSearchEnded = 0;
 static vqarray_t *g_unfinishedPIDs = NULL;
 static vqarray_t *g_ebpStructs = NULL;
 static int64_t g_streamStartTimeMsecs;
+static pts_timeline_t g_prereadPTSTimeline;
 
 static int pmt_processor(mpeg2ts_program_t *m2p, void *arg);
 static int pat_processor(mpeg2ts_stream_t *m2s, void *arg);
@@ -378,7 +381,7 @@ static int handle_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi, v
    // if we get an ebp struct in each stream before that, then exit.
 
    // get time and exit if greater that limit
-   int64_t currentTimeMsecs = (pes->header.PTS * 1000) / 90000;
+   int64_t currentTimeMsecs = (pts_timeline_unwrap (&g_prereadPTSTimeline, pes->header.PTS) * 1000) / 90000;
    if (g_streamStartTimeMsecs == -1)
    {
       g_streamStartTimeMsecs = currentTimeMsecs;
@@ -486,7 +489,7 @@ static int pmt_processor(mpeg2ts_program_t *m2p, void *arg)
             demux_validator->arg_destructor = NULL;
 
             // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator);
+            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator, 0);
          }
          else if (IS_VIDEO_STREAM(pi->es_info->stream_type))
          {
@@ -533,24 +536,7 @@ static int pmt_processor(mpeg2ts_program_t *m2p, void *arg)
                LOG_INFO_ARGS ("EBP Descriptor present -- no EBP detection necessary for PID: %d", pi->es_info->elementary_PID);
             }
 
-            pes_demux_t *pd = pes_demux_new(handle_pes_packet);
-            pd->pes_arg = arg;
-            pd->pes_arg_destructor = NULL;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t *demux_handler = calloc(1, sizeof(demux_pid_handler_t));
-            demux_handler->process_ts_packet = pes_demux_process_ts_packet;
-            demux_handler->arg = pd;
-            demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t *demux_validator = calloc(1, sizeof(demux_pid_handler_t));
-            demux_validator->process_ts_packet = handle_ts_packet;
-            demux_validator->arg = arg;
-            demux_validator->arg_destructor = NULL;
-
-            // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator);
+            registerEBPPIDProcessor(m2p, pi->es_info->elementary_PID, handle_pes_packet, handle_ts_packet, arg, 0);
          }
       }
    }
@@ -580,8 +566,7 @@ int prereadFiles(int numFiles, char **fileNames, program_stream_info_t *programS
 {
    LOG_INFO ("prereadFiles: entering");
 
-   int num_packets = 4096;
-   uint8_t *ts_buf = malloc(TS_SIZE * 4096);
+   int num_packets = 0;
 
    for (int i=0; i<numFiles; i++)
    {
@@ -593,9 +578,10 @@ int prereadFiles(int numFiles, char **fileNames, program_stream_info_t *programS
       g_bPMTFound = 0;
       g_bEBPSearchEnded = 0;
       g_streamStartTimeMsecs = -1;
+      pts_timeline_init (&g_prereadPTSTimeline);
 
-      FILE *infile = NULL;
-      if ((infile = fopen(fileNames[i], "rb")) == NULL)
+      ts_source_t *source = NULL;
+      if ((source = ts_source_new_file(fileNames[i])) == NULL)
       {
          LOG_ERROR_ARGS("Main:prereadFiles: Cannot open file %s - %s", fileNames[i], strerror(errno));
          reportAddErrorLogArgs("Main:prereadFiles: Cannot open file %s - %s", fileNames[i], strerror(errno));
@@ -603,6 +589,7 @@ int prereadFiles(int numFiles, char **fileNames, program_stream_info_t *programS
       }
 
       mpeg2ts_stream_t *m2s = NULL;
+      ts_pool_t *ts_pool = ts_pool_new(TS_POOL_DEFAULT_SLAB_SIZE);
 
       if (NULL == (m2s = mpeg2ts_stream_new()))
       {
@@ -611,39 +598,19 @@ int prereadFiles(int numFiles, char **fileNames, program_stream_info_t *programS
          return -1;
       }
 
-       // Register EBP descriptor parser
-      // testing -- comment the following out to removes ebpDescriptor to test triggering without descriptor present
-      if (!ATS_TEST_CASE_NO_EBP_DESCRIPTOR)
-      {
-         descriptor_table_entry_t *desc = calloc(1, sizeof(descriptor_table_entry_t));
-         desc->tag = EBP_DESCRIPTOR;
-         desc->free_descriptor = ebp_descriptor_free;
-         desc->print_descriptor = ebp_descriptor_print;
-         desc->read_descriptor = ebp_descriptor_read;
-         if (!register_descriptor(desc))
-         {
-            LOG_ERROR_ARGS("Main:prereadFiles: FAIL: Could not register EBP descriptor parser for file %s", fileNames[i]);
-            reportAddErrorLogArgs("Main:prereadFiles: FAIL: Could not register EBP descriptor parser for file %s", fileNames[i]);
-            return -1;
-         }
-      }
-      
-
       m2s->pat_processor = (pat_processor_t)pat_processor;
       m2s->arg = &(programStreamInfo[i]);
       m2s->arg_destructor = NULL;
 
-      uint32_t num_packets_total = 0;
-
+      uint8_t *packets[TS_SOURCE_MAX_PACKETS];
       while (!(g_bPATFound && g_bPMTFound && g_bEBPSearchEnded) && 
-         (num_packets = fread(ts_buf, TS_SIZE, 4096, infile)) > 0)
+         (num_packets = ts_source_acquire(source, packets, TS_SOURCE_MAX_PACKETS)) > 0)
       {
-         num_packets_total += num_packets;
-         LOG_INFO_ARGS ("total_packets = %d, num_packets = %d", num_packets_total, num_packets);
+         LOG_INFO_ARGS ("total_packets = %"PRIu64", num_packets = %d", source->packets_read + num_packets, num_packets);
          for (int i = 0; i < num_packets; i++)
          {
-            ts_packet_t *ts = ts_new();
-            ts_read(ts, ts_buf + i * TS_SIZE, TS_SIZE);
+            ts_packet_t *ts = ts_pool_get(ts_pool);
+            ts_read_inplace(ts, packets[i], TS_SIZE);
             LOG_DEBUG_ARGS ("Main:prereadFiles: processing packet: %d (PID %d)", i, ts->header.PID);
             mpeg2ts_stream_read_ts_packet(m2s, ts);
 
@@ -654,15 +621,16 @@ int prereadFiles(int numFiles, char **fileNames, program_stream_info_t *programS
                break;
             }
          }
+         ts_source_release(source, num_packets);
       }
-      LOG_INFO_ARGS ("Main:prereadFiles: num packets read: %d", num_packets_total);
+      LOG_INFO_ARGS ("Main:prereadFiles: num packets read: %"PRIu64, source->packets_read);
 
       mpeg2ts_stream_free(m2s);
+      ts_pool_free(ts_pool);
 
-      fclose(infile);
+      ts_source_free(source);
    }
 
-   free (ts_buf);
    LOG_INFO ("Main:prereadFiles: exiting");
    return 0;
 }
@@ -1162,6 +1130,7 @@ int startSocketReceiveThreads (int numIngestStreams, char **mcastAddrs, circular
       pthread_t *socketThread = (*socketReceiveThreads)[threadIndex];
       LOG_INFO_ARGS("Main:startSocketReceiveThreads: creating socket receive thread %d, port = %d", 
          (*ebpSocketReceiveThreadParams)[threadIndex]->threadNum, port);
+      threadPlacementSetAttr(threadAttr);
       int returnCode = pthread_create(socketThread, threadAttr, EBPSocketReceiveThreadProc, 
          (void *)(*ebpSocketReceiveThreadParams)[threadIndex]);
       if (returnCode)
@@ -1207,15 +1176,40 @@ int stopSocketReceiveThreads (int numIngestStreams, pthread_t **socketReceiveThr
    return 0;
 }
 
+/**
+ * Sets the flow control credits of the file mode fifos: an ingest thread can only get
+ * fileIngestQueueDepth segments ahead of the analysis thread for each stream.
+ */
+void setFileIngestQueueDepth(int numFiles, int numStreams, ebp_stream_info_t **streamInfoArray)
+{
+   int queueDepth = g_ATSTestAppConfig.fileIngestQueueDepth;
+   if (queueDepth < FILE_INGEST_MIN_QUEUE_DEPTH || queueDepth > FIFO_DEFAULT_CAPACITY)
+   {
+      int clampedQueueDepth = (queueDepth < FILE_INGEST_MIN_QUEUE_DEPTH) ? FILE_INGEST_MIN_QUEUE_DEPTH : FIFO_DEFAULT_CAPACITY;
+      LOG_INFO_ARGS ("Main:setFileIngestQueueDepth: fileIngestQueueDepth %d out of range: using %d", 
+         queueDepth, clampedQueueDepth);
+      queueDepth = clampedQueueDepth;
+   }
+
+   for (int i=0; i<numFiles * numStreams; i++)
+   {
+      if (streamInfoArray[i] != NULL)
+      {
+         fifo_set_credits (streamInfoArray[i]->fifo, queueDepth);
+      }
+   }
+}
+
 int startThreads_FileIngest(int numFiles, int totalNumStreams, ebp_stream_info_t **streamInfoArray, char **fileNames,
-   int *filePassFails, pthread_t ***fileIngestThreads, pthread_t ***analysisThreads, pthread_attr_t *threadAttr)
+   int *filePassFails, ebp_file_ingest_pacing_t *pacing, pthread_t ***fileIngestThreads, int *numFileIngestThreads, 
+   pthread_t ***analysisThreads, pthread_attr_t *threadAttr)
 {
    LOG_INFO ("Main:startThreads_FileIngest: entering");
 
    int returnCode = 0;
 
    // one worker thread per file, one analysis thread per streamtype
-   // num worker thread = numFiles
+   // num worker thread = numFiles, or maxIngestThreads pool threads if there are more files than that
    // num analysis threads = totalNumStreams
 
    pthread_attr_init(threadAttr);
@@ -1242,6 +1236,7 @@ int startThreads_FileIngest(int numFiles, int totalNumStreams, ebp_stream_info_t
       (*analysisThreads)[threadIndex] = (pthread_t *)calloc (1, sizeof (pthread_t));
       pthread_t *analyzerThread = (*analysisThreads)[threadIndex];
       LOG_INFO_ARGS("Main:startThreads_FileIngest: creating analyzer thread %d", threadIndex);
+      threadPlacementSetAttr(threadAttr);
       returnCode = pthread_create(analyzerThread, threadAttr, EBPSegmentAnalysisThreadProc, (void *)ebpSegmentAnalysisThreadParams);
       if (returnCode)
       {
@@ -1255,29 +1250,52 @@ int startThreads_FileIngest(int numFiles, int totalNumStreams, ebp_stream_info_t
 
 
    // start the file ingest threads
-   *fileIngestThreads = (pthread_t **) calloc (numFiles, sizeof(pthread_t*));
-   for (int threadIndex = 0; threadIndex < numFiles; threadIndex++)
+   ebp_file_ingest_thread_params_t **ebpFileIngestThreadParamsArray = (ebp_file_ingest_thread_params_t **)calloc (numFiles, 
+      sizeof(ebp_file_ingest_thread_params_t *));
+   for (int fileIndex = 0; fileIndex < numFiles; fileIndex++)
    {
-      int arrayIndex = get2DArrayIndex (threadIndex, 0, totalNumStreams);
-      ebp_stream_info_t **streamInfos = &(streamInfoArray[arrayIndex]);
-             
       // pass ALL stream infos so that threads can do implicit triggering on each other
       ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams = (ebp_file_ingest_thread_params_t *)calloc (1, sizeof(ebp_file_ingest_thread_params_t));
       ebpFileIngestThreadParams->ebpIngestThreadParams = (ebp_ingest_thread_params_t *)calloc (1, sizeof(ebp_ingest_thread_params_t));
-      ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum = threadIndex;  // same as file index
+      ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum = fileIndex;  // same as file index
       ebpFileIngestThreadParams->ebpIngestThreadParams->numStreams = totalNumStreams;
       ebpFileIngestThreadParams->ebpIngestThreadParams->numIngests = numFiles;
       ebpFileIngestThreadParams->ebpIngestThreadParams->allStreamInfos = streamInfoArray;
-      ebpFileIngestThreadParams->filePath = fileNames[threadIndex];
-      ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail = &(filePassFails[threadIndex]);
+      ebpFileIngestThreadParams->filePath = fileNames[fileIndex];
+      ebpFileIngestThreadParams->pacing = pacing;
+      ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail = &(filePassFails[fileIndex]);
       ebpFileIngestThreadParams->ebpIngestThreadParams->mapOldSCTE35SpliceInserts = 
              hashtable_new(hashtable_hashfn_uint32, hashtable_eqfn_uint32);
 
+      ebpFileIngestThreadParamsArray[fileIndex] = ebpFileIngestThreadParams;
+   }
+
+   ebp_file_ingest_pool_t *fileIngestPool = NULL;
+   *numFileIngestThreads = numFiles;
+   if (g_ATSTestAppConfig.maxIngestThreads > 0 && g_ATSTestAppConfig.maxIngestThreads < numFiles)
+   {
+      *numFileIngestThreads = g_ATSTestAppConfig.maxIngestThreads;
+      fileIngestPool = fileIngestPoolNew(numFiles, ebpFileIngestThreadParamsArray, *numFileIngestThreads);
+      LOG_INFO_ARGS("Main:startThreads_FileIngest: ingesting %d files with a pool of %d threads", 
+         numFiles, *numFileIngestThreads);
+   }
 
+   *fileIngestThreads = (pthread_t **) calloc (*numFileIngestThreads, sizeof(pthread_t*));
+   for (int threadIndex = 0; threadIndex < *numFileIngestThreads; threadIndex++)
+   {
       (*fileIngestThreads)[threadIndex] = (pthread_t *)calloc (1, sizeof (pthread_t));
       pthread_t *fileIngestThread = (*fileIngestThreads)[threadIndex];
       LOG_INFO_ARGS("Main:startThreads_FileIngest: creating fileIngest thread %d", threadIndex);
-      returnCode = pthread_create(fileIngestThread, threadAttr, EBPFileIngestThreadProc, (void *)ebpFileIngestThreadParams);
+      threadPlacementSetAttr(threadAttr);
+      if (fileIngestPool != NULL)
+      {
+         returnCode = pthread_create(fileIngestThread, threadAttr, EBPFileIngestPoolThreadProc, (void *)fileIngestPool);
+      }
+      else
+      {
+         returnCode = pthread_create(fileIngestThread, threadAttr, EBPFileIngestThreadProc, 
+            (void *)ebpFileIngestThreadParamsArray[threadIndex]);
+      }
       if (returnCode)
       {
          LOG_ERROR_ARGS("Main:startThreads_FileIngest: FAIL: error %d creating fileIngest thread %d", 
@@ -1286,7 +1304,10 @@ int startThreads_FileIngest(int numFiles, int totalNumStreams, ebp_stream_info_t
             returnCode, threadIndex);
           return -1;
       }
-  }
+   }
+
+   // the params are freed by the ingest threads, and the pool by its last thread
+   free (ebpFileIngestThreadParamsArray);
 
    LOG_INFO("Main:startThreads_FileIngest: exiting");
    return 0;
@@ -1411,6 +1432,7 @@ int startThreads_StreamIngest(int numIngestStreams, int totalNumStreams, ebp_str
       (*analysisThreads)[threadIndex] = (pthread_t *)calloc (1, sizeof (pthread_t));
       pthread_t *analyzerThread = (*analysisThreads)[threadIndex];
       LOG_INFO_ARGS("Main:startThreads_StreamIngest: creating analyzer thread %d", threadIndex);
+      threadPlacementSetAttr(threadAttr);
       returnCode = pthread_create(analyzerThread, threadAttr, EBPSegmentAnalysisThreadProc, (void *)ebpSegmentAnalysisThreadParams);
       if (returnCode)
       {
@@ -1441,6 +1463,7 @@ int startThreads_StreamIngest(int numIngestStreams, int totalNumStreams, ebp_str
       ebpStreamIngestThreadParams->ebpIngestThreadParams->allStreamInfos = streamInfoArray;
       ebpStreamIngestThreadParams->cb = ingestBuffers[threadIndex];
       ebpStreamIngestThreadParams->ebpIngestThreadParams->ingestPassFail = &(filePassFails[threadIndex]);
+      ebpStreamIngestThreadParams->ebpIngestThreadParams->isStreamIngest = 1;
       ebpStreamIngestThreadParams->ebpIngestThreadParams->mapOldSCTE35SpliceInserts = 
              hashtable_new(hashtable_hashfn_uint32, hashtable_eqfn_uint32);
 
@@ -1450,6 +1473,7 @@ int startThreads_StreamIngest(int numIngestStreams, int totalNumStreams, ebp_str
       (*streamIngestThreads)[threadIndex] = (pthread_t *)calloc (1, sizeof (pthread_t));
       pthread_t *streamIngestThread = (*streamIngestThreads)[threadIndex];
       LOG_INFO_ARGS("Main:startThreads_StreamIngest: creating streamIngest thread %d", threadIndex);
+      threadPlacementSetAttr(threadAttr);
       returnCode = pthread_create(streamIngestThread, threadAttr, EBPStreamIngestThreadProc, (void *)ebpStreamIngestThreadParams);
       if (returnCode)
       {
@@ -1655,6 +1679,26 @@ void printStreamInfo(int numIngests, int numStreams, ebp_stream_info_t **streamI
    LOG_INFO ("");
 }
 
+int registerDescriptors()
+{
+   // Register EBP descriptor parser.  This must happen before any thread is started: the
+   // registry is frozen afterwards so ingest threads can look descriptors up without locking.
+   // ATS_TEST_CASE_NO_EBP_DESCRIPTOR drops the parsed descriptor in the PMT processors instead.
+   descriptor_table_entry_t desc = 
+   {
+      EBP_DESCRIPTOR, ebp_descriptor_read, ebp_descriptor_print
+   };
+   if (!register_descriptor(&desc))
+   {
+      LOG_ERROR("Main:registerDescriptors: FAIL: Could not register EBP descriptor parser");
+      reportAddErrorLog("Main:registerDescriptors: FAIL: Could not register EBP descriptor parser");
+      return -1;
+   }
+
+   freeze_descriptors();
+   return 0;
+}
+
 int main(int argc, char** argv) 
 {
    printf ("CableLabs ATS EBP Conformance Test Tool v1.0.0.1\n\n");
@@ -1727,6 +1771,13 @@ int main(int argc, char** argv)
    {
       LOG_INFO ("ERROR opening log file");
    }
+
+   threadPlacementInit(g_ATSTestAppConfig.threadPlacement, g_ATSTestAppConfig.threadCpuList);
+
+   if (registerDescriptors() != 0)
+   {
+      return 1;
+   }
   
    if (fileFlag && streamFlag)
    {
@@ -1753,6 +1804,7 @@ int main(int argc, char** argv)
    }
 
    reportCleanup();
+   threadPlacementCleanup();
    
    LOG_INFO ("Main: exiting");
 
@@ -1786,6 +1838,14 @@ void runStreamIngestMode(int numIngestStreams, char **ingestAddrs, int peekFlag,
          reportAddErrorLog ("runStreamIngestMode: FATAL ERROR creating circular buffer: exiting"); 
          exit (-1);
       }
+
+      cb_set_overflow_policy (ingestBuffers[i], g_ATSTestAppConfig.ingestOverflowPolicy);
+
+      if (g_ATSTestAppConfig.socketTimestamps && cb_enable_arrival_times (ingestBuffers[i]) != 0)
+      {
+         LOG_ERROR ("runStreamIngestMode: ERROR enabling arrival times: socket timestamps disabled"); 
+         reportAddErrorLog ("runStreamIngestMode: ERROR enabling arrival times: socket timestamps disabled"); 
+      }
    }
 
    pthread_t **socketReceiveThreads;
@@ -1839,6 +1899,9 @@ void runStreamIngestMode(int numIngestStreams, char **ingestAddrs, int peekFlag,
       exit (-1);
    }
 
+   ingest_stats_t *ingestStats = (ingest_stats_t *) calloc (numIngestStreams, sizeof (ingest_stats_t));
+   reportSetIngestStats (numIngestStreams, ingestStats);
+
    // keyboard listener here
    while (1)
    {
@@ -1863,6 +1926,7 @@ void runStreamIngestMode(int numIngestStreams, char **ingestAddrs, int peekFlag,
       else if (myChar == 'r')
       {
          printf ("Printing report...\n");
+         getIngestStats (ebpSocketReceiveThreadParams, numIngestStreams, ingestStats);
          char *reportPath = reportPrint(numIngestStreams, numStreamsPerIngest, streamInfoArray, ingestAddrs, 
             ingestPassFails, programStreamInfo);
          if (reportPath == NULL)
@@ -1943,6 +2007,9 @@ void runStreamIngestMode(int numIngestStreams, char **ingestAddrs, int peekFlag,
    freeProgramStreamInfo (programStreamInfo, numIngestStreams);
    free (ingestPassFails);
 
+   reportSetIngestStats (0, NULL);
+   free (ingestStats);
+
    // free circular buffers here
    for (int i=0; i<numIngestStreams; i++)
    {
@@ -1988,12 +2055,16 @@ void runFileIngestMode(int numFiles, char **filePaths, int peekFlag)
       return;
    }
 
+   setFileIngestQueueDepth(numFiles, numStreamsPerFile, streamInfoArray);
+   ebp_file_ingest_pacing_t *pacing = fileIngestPacingNew(numFiles, g_ATSTestAppConfig.fileIngestPTSWindowSecs);
+
    pthread_t **fileIngestThreads;
+   int numFileIngestThreads;
    pthread_t **analysisThreads;
    pthread_attr_t threadAttr;
 
-   returnCode = startThreads_FileIngest(numFiles, numStreamsPerFile, streamInfoArray, filePaths, filePassFails,
-      &fileIngestThreads, &analysisThreads, &threadAttr);
+   returnCode = startThreads_FileIngest(numFiles, numStreamsPerFile, streamInfoArray, filePaths, filePassFails, pacing,
+      &fileIngestThreads, &numFileIngestThreads, &analysisThreads, &threadAttr);
    if (returnCode != 0)
    {
       LOG_ERROR ("runFileIngestMode: FATAL ERROR during startThreads: exiting"); 
@@ -2001,7 +2072,7 @@ void runFileIngestMode(int numFiles, char **filePaths, int peekFlag)
       exit (-1);
    }
 
-   returnCode = waitForThreadsToExit(numFiles, numStreamsPerFile, fileIngestThreads, analysisThreads, &threadAttr);
+   returnCode = waitForThreadsToExit(numFileIngestThreads, numStreamsPerFile, fileIngestThreads, analysisThreads, &threadAttr);
    if (returnCode != 0)
    {
       LOG_ERROR ("runFileIngestMode: FATAL ERROR during waitForThreadsToExit: exiting"); 
@@ -2009,6 +2080,8 @@ void runFileIngestMode(int numFiles, char **filePaths, int peekFlag)
       exit (-1);
    }
 
+   fileIngestPacingFree(pacing);
+
    pthread_attr_destroy(&threadAttr);
 
 
@@ -2074,7 +2147,7 @@ void freeProgramStreamInfo(program_stream_info_t *programStreamInfoArray, int nu
          }
          if ((programStreamInfo->ebpDescriptors)[i] != NULL)
          {
-            ebp_descriptor_free ((descriptor_t *)((programStreamInfo->ebpDescriptors)[i]));
+            ebp_descriptor_release ((programStreamInfo->ebpDescriptors)[i]);
          }
          if ((programStreamInfo->ebpLists)[i] != NULL)
          {
@@ -2098,20 +2171,55 @@ void freeProgramStreamInfo(program_stream_info_t *programStreamInfoArray, int nu
    free (programStreamInfoArray);
 }
 
+void getIngestStats (ebp_socket_receive_thread_params_t **ebpSocketReceiveThreadParams, int numIngestStreams, 
+                     ingest_stats_t *ingestStats)
+{
+   for (int i=0; i<numIngestStreams; i++)
+   {
+      circular_buffer_t *cb = ebpSocketReceiveThreadParams[i]->cb;
+      cb_stats_t cbStats;
+      cb_get_stats (cb, &cbStats);
+
+      ingestStats[i].overflowPolicy = cb_overflow_policy_name (cb->overflowPolicy);
+      ingestStats[i].receivedBytes = ebpSocketReceiveThreadParams[i]->receivedBytes;
+      ingestStats[i].droppedBytes = cbStats.droppedBytes + cbStats.skippedBytes;
+      ingestStats[i].overflowEvents = cbStats.overflowEvents;
+      ingestStats[i].highWatermark = cbStats.highWatermark;
+      ingestStats[i].bufferSz = cb_get_total_size (cb);
+
+      // datagrams of plain 188-byte packets never go through the sync stage
+      ts_sync_t *sync = &(ebpSocketReceiveThreadParams[i]->sync);
+      ingestStats[i].packetSize = (sync->packet_size == 0) ? TS_SIZE : sync->packet_size;
+      ingestStats[i].lostSyncEvents = sync->lost_sync_events;
+      ingestStats[i].syncSkippedBytes = sync->skipped_bytes;
+   }
+}
+
 void printIngestStatus (ebp_socket_receive_thread_params_t **ebpSocketReceiveThreadParams, int numIngestStreams, int numStreams,
                         ebp_stream_info_t **streamInfoArray)
 {
    printf ("\nIngest Stream Status:\n");
    for (int i=0; i<numIngestStreams; i++)
    {
-      printf ("   Ingest %d (%u.%u.%u.%u:%u): ReceivedBytes = %d, Buffered Bytes = %d/%d\n",
+      printf ("   Ingest %d (%u.%u.%u.%u:%u): ReceivedBytes = %d, Datagrams = %u (%.1f per recv), Buffered Bytes = %d/%d\n",
          i, (unsigned int) ((ebpSocketReceiveThreadParams[i])->ipAddr >> 24),
          (unsigned int) ((ebpSocketReceiveThreadParams[i]->ipAddr >> 16) & 0x0FF), 
          (unsigned int) ((ebpSocketReceiveThreadParams[i]->ipAddr >> 8) & 0x0FF), 
          (unsigned int) ((ebpSocketReceiveThreadParams[i]->ipAddr) & 0x0FF), 
          ebpSocketReceiveThreadParams[i]->port,
-         ebpSocketReceiveThreadParams[i]->receivedBytes, cb_read_size (ebpSocketReceiveThreadParams[i]->cb),
+         ebpSocketReceiveThreadParams[i]->receivedBytes, ebpSocketReceiveThreadParams[i]->receivedDatagrams,
+         (ebpSocketReceiveThreadParams[i]->receiveCalls == 0) ? 0.0 :
+            (double)ebpSocketReceiveThreadParams[i]->receivedDatagrams / ebpSocketReceiveThreadParams[i]->receiveCalls,
+         cb_read_size (ebpSocketReceiveThreadParams[i]->cb),
          cb_get_total_size (ebpSocketReceiveThreadParams[i]->cb));
+
+      ingest_stats_t stats;
+      getIngestStats (&ebpSocketReceiveThreadParams[i], 1, &stats);
+      printf ("      Overflow policy %s: Dropped = %"PRIu64" bytes (%"PRIu64" packets), Overflows = %u, High Watermark = %d/%d\n",
+         stats.overflowPolicy, stats.droppedBytes, stats.droppedBytes / TS_SIZE, stats.overflowEvents, 
+         stats.highWatermark, stats.bufferSz);
+      printf ("      Packet size %d: Lost sync = %"PRIu64" times, Skipped = %"PRIu64" bytes\n",
+         stats.packetSize, stats.lostSyncEvents, stats.syncSkippedBytes);
    }
    printf ("\n");
 
@@ -2125,6 +2233,9 @@ void printIngestStatus (ebp_socket_receive_thread_params_t **ebpSocketReceiveThr
 
          printf ("Ingest %d, Stream %d (PID = %d): EBP detected = %d, EBP processed = %d\n", 
             ingestIndex, streamIndex, streamInfo->PID, streamInfo->fifo->push_counter, streamInfo->fifo->pop_counter);
+         printf ("      Packets = %"PRIu64", CC errors = %"PRIu64", Lost = %"PRIu64", Duplicates = %"PRIu64", Discontinuities = %"PRIu64"\n",
+            streamInfo->ccStats.num_packets, streamInfo->ccStats.num_cc_errors, streamInfo->ccStats.num_lost_packets,
+            streamInfo->ccStats.num_duplicates, streamInfo->ccStats.num_discontinuities);
       }
    }
    printf ("\n");
@@ -30,7 +30,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __H_ATSTESTAPP_767JKS
 
 #include "EBPStreamBuffer.h"
+#include "ATSTestReport.h"
 #include "EBPPreReadStreamIngestThread.h"
+#include "EBPFileIngestThread.h"
 
 
 //#define PREREAD_EBP_SEARCH_TIME_MSECS   10000
@@ -62,6 +64,7 @@ varray_t *getUniqueAudioIDArray(int numFiles, program_stream_info_t *programStre
 int setupQueues(int numIngests, program_stream_info_t *programStreamInfo,
                 ebp_stream_info_t ***streamInfoArray, int *numStreamsPerIngest);
 
+int registerDescriptors();
 void runFileIngestMode(int numFiles, char **filePaths, int peekFlag);
 void runStreamIngestMode(int numngestStreams, char **ingestAddrs, int peekFlag, int enableStreamDump);
 
@@ -73,8 +76,10 @@ int startThreads_PreReadStreamIngest(int numIngestStreams, program_stream_info_t
 int waitForPreReadStreamIngestToExit(int numIngestStreams,
    pthread_t **preReadStreamIngestThreads, pthread_attr_t *threadAttr);
 
+void setFileIngestQueueDepth(int numFiles, int numStreams, ebp_stream_info_t **streamInfoArray);
 int startThreads_FileIngest(int numFiles, int totalNumStreams, ebp_stream_info_t **streamInfoArray, char **fileNames,
-   int *filePassFails, pthread_t ***fileIngestThreads, pthread_t ***analysisThreads, pthread_attr_t *threadAttr);
+   int *filePassFails, ebp_file_ingest_pacing_t *pacing, pthread_t ***fileIngestThreads, int *numFileIngestThreads, 
+   pthread_t ***analysisThreads, pthread_attr_t *threadAttr);
 int startThreads_StreamIngest(int numIngestStreams, int totalNumStreams, ebp_stream_info_t **streamInfoArray, circular_buffer_t **ingestBuffers,
    int *filePassFails, pthread_t ***streamIngestThreads, pthread_t ***analysisThreads, pthread_attr_t *threadAttr,
    ebp_stream_ingest_thread_params_t ***ebpStreamIngestThreadParamsOut);
@@ -100,6 +105,8 @@ int getFileWithVideoPID(program_stream_info_t *programStreamInfo, int numFiles,
 
 void printIngestStatus (ebp_socket_receive_thread_params_t **ebpSocketReceiveThreadParams, int numIngestStreams, int numStreams,
                         ebp_stream_info_t **streamInfoArray);
+void getIngestStats (ebp_socket_receive_thread_params_t **ebpSocketReceiveThreadParams, int numIngestStreams, 
+                     ingest_stats_t *ingestStats);
 
 
 
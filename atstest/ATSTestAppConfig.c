@@ -33,6 +33,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "log.h"
 #include "ATSTestAppConfig.h"
 #include "ATSTestReport.h"
+#include "EBPStreamBuffer.h"
+#include "EBPThreadPlacement.h"
 
 ats_test_app_config_t g_ATSTestAppConfig;
 
@@ -47,7 +49,16 @@ void printTestConfig()
    LOG_INFO_ARGS ("     scte35MinimumPrerollSeconds = %f", g_ATSTestAppConfig.scte35MinimumPrerollSeconds);
    LOG_INFO_ARGS ("     scte35SpliceEventTimeToLiveSecs = %f", g_ATSTestAppConfig.scte35SpliceEventTimeToLiveSecs);
    LOG_INFO_ARGS ("     socketRcvBufferSz = %d", g_ATSTestAppConfig.socketRcvBufferSz);
+   LOG_INFO_ARGS ("     socketRecvBatchSz = %d", g_ATSTestAppConfig.socketRecvBatchSz);
+   LOG_INFO_ARGS ("     socketMaxDatagramSz = %d", g_ATSTestAppConfig.socketMaxDatagramSz);
+   LOG_INFO_ARGS ("     socketTimestamps = %d", g_ATSTestAppConfig.socketTimestamps);
    LOG_INFO_ARGS ("     ingestCircularBufferSz = %d", g_ATSTestAppConfig.ingestCircularBufferSz);
+   LOG_INFO_ARGS ("     ingestOverflowPolicy = %s", cb_overflow_policy_name (g_ATSTestAppConfig.ingestOverflowPolicy));
+   LOG_INFO_ARGS ("     threadPlacement = %s", threadPlacementPolicyName (g_ATSTestAppConfig.threadPlacement));
+   LOG_INFO_ARGS ("     threadCpuList = %s", g_ATSTestAppConfig.threadCpuList);
+   LOG_INFO_ARGS ("     maxIngestThreads = %d", g_ATSTestAppConfig.maxIngestThreads);
+   LOG_INFO_ARGS ("     fileIngestQueueDepth = %d", g_ATSTestAppConfig.fileIngestQueueDepth);
+   LOG_INFO_ARGS ("     fileIngestPTSWindowSecs = %f", g_ATSTestAppConfig.fileIngestPTSWindowSecs);
    LOG_INFO_ARGS ("     logLevel = %d", g_ATSTestAppConfig.logLevel);
 }
 
@@ -75,7 +86,16 @@ void setTestConfigDefaults()
    g_ATSTestAppConfig.scte35SpliceEventTimeToLiveSecs = 10.0;
 
    g_ATSTestAppConfig.socketRcvBufferSz = 2000000;
+   g_ATSTestAppConfig.socketRecvBatchSz = 64;
+   g_ATSTestAppConfig.socketMaxDatagramSz = 8972;  // 9000-byte jumbo frame less IP and UDP headers
+   g_ATSTestAppConfig.socketTimestamps = 0;
    g_ATSTestAppConfig.ingestCircularBufferSz = 1880000;
+   g_ATSTestAppConfig.ingestOverflowPolicy = CB_OVERFLOW_DROP_NEWEST;
+   g_ATSTestAppConfig.threadPlacement = THREAD_PLACEMENT_NONE;
+   g_ATSTestAppConfig.threadCpuList = (char *) calloc (1, 256);
+   g_ATSTestAppConfig.maxIngestThreads = 0;
+   g_ATSTestAppConfig.fileIngestQueueDepth = 256;
+   g_ATSTestAppConfig.fileIngestPTSWindowSecs = 10.0;
    g_ATSTestAppConfig.logLevel = 3;
 
 }
@@ -166,10 +186,72 @@ int readTestConfigFile()
          {
             g_ATSTestAppConfig.socketRcvBufferSz = atoi (valueTrimmed);
          }
+         else if (strcmp("socketRecvBatchSz", nameTrimmed) == 0)
+         {
+            g_ATSTestAppConfig.socketRecvBatchSz = atoi (valueTrimmed);
+         }
+         else if (strcmp("socketMaxDatagramSz", nameTrimmed) == 0)
+         {
+            g_ATSTestAppConfig.socketMaxDatagramSz = atoi (valueTrimmed);
+         }
+         else if (strcmp("socketTimestamps", nameTrimmed) == 0)
+         {
+            g_ATSTestAppConfig.socketTimestamps = atoi (valueTrimmed);
+         }
          else if (strcmp("ingestCircularBufferSz", nameTrimmed) == 0)
          {
             g_ATSTestAppConfig.ingestCircularBufferSz = atoi (valueTrimmed);
          }
+         else if (strcmp("ingestOverflowPolicy", nameTrimmed) == 0)
+         {
+            if (strcmp("block", valueTrimmed) == 0)
+            {
+               g_ATSTestAppConfig.ingestOverflowPolicy = CB_OVERFLOW_BLOCK;
+            }
+            else if (strcmp("dropNewest", valueTrimmed) == 0)
+            {
+               g_ATSTestAppConfig.ingestOverflowPolicy = CB_OVERFLOW_DROP_NEWEST;
+            }
+            else if (strcmp("dropOldest", valueTrimmed) == 0)
+            {
+               g_ATSTestAppConfig.ingestOverflowPolicy = CB_OVERFLOW_DROP_OLDEST;
+            }
+            else
+            {
+               LOG_ERROR_ARGS ("ATSTestAppConfig: Unknown ingestOverflowPolicy %s ignored", valueTrimmed);
+               reportAddErrorLogArgs ("ATSTestAppConfig: Unknown ingestOverflowPolicy %s ignored", valueTrimmed);
+            }
+         }
+         else if (strcmp("threadPlacement", nameTrimmed) == 0)
+         {
+            int policy = threadPlacementPolicyFromName (valueTrimmed);
+            if (policy >= 0)
+            {
+               g_ATSTestAppConfig.threadPlacement = policy;
+            }
+            else
+            {
+               LOG_ERROR_ARGS ("ATSTestAppConfig: Unknown threadPlacement %s ignored", valueTrimmed);
+               reportAddErrorLogArgs ("ATSTestAppConfig: Unknown threadPlacement %s ignored", valueTrimmed);
+            }
+         }
+         else if (strcmp("threadCpuList", nameTrimmed) == 0)
+         {
+            // threadCpuList mem is already allocated, and is as long as a config line
+            strcpy (g_ATSTestAppConfig.threadCpuList, valueTrimmed);
+         }
+         else if (strcmp("maxIngestThreads", nameTrimmed) == 0)
+         {
+            g_ATSTestAppConfig.maxIngestThreads = atoi (valueTrimmed);
+         }
+         else if (strcmp("fileIngestQueueDepth", nameTrimmed) == 0)
+         {
+            g_ATSTestAppConfig.fileIngestQueueDepth = atoi (valueTrimmed);
+         }
+         else if (strcmp("fileIngestPTSWindowSecs", nameTrimmed) == 0)
+         {
+            g_ATSTestAppConfig.fileIngestPTSWindowSecs = atof (valueTrimmed);
+         }
          else
          {
             LOG_INFO_ARGS ("Unknown configuration property %s ignored", nameTrimmed);
@@ -41,7 +41,17 @@ typedef struct
    float scte35SpliceEventTimeToLiveSecs;
 
    int socketRcvBufferSz;
+   int socketRecvBatchSz;
+   int socketMaxDatagramSz;  // receive slot per datagram: larger datagrams are truncated
+   int socketTimestamps;
    int ingestCircularBufferSz;
+   int ingestOverflowPolicy;  // cb_overflow_policy_t
+
+   int threadPlacement;  // thread_placement_policy_t
+   char *threadCpuList;  // empty: all CPUs the process may use
+   int maxIngestThreads;  // file mode: 0 for one ingest thread per file
+   int fileIngestQueueDepth;  // file mode: most segments queued per file and stream
+   float fileIngestPTSWindowSecs;  // file mode: 0 to let files get any distance apart
 
 } ats_test_app_config_t;
 
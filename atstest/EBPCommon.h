@@ -32,6 +32,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "log.h"
 #include "varray.h"
 #include "ebp.h"
+#include "mpeg2ts_demux.h"
+#include "video_sap.h"
 
 
 #define EBP_NUM_PARTITIONS 10  // 0 - 9
@@ -68,11 +70,17 @@ typedef struct
    ebp_boundary_info_t* ebpBoundaryInfo;  // contain info on which partitions are boundaries
 
    int streamPassFail;  // 1 == pass, 0 == fail
+   int fifoStalled;  // stream ingest only: a push to fifo gave up (FIFO_STALLED), so boundaries are no longer posted
 
    thread_safe_fifo_t *fifo;
 
    int ebpChunkCntr;
 
+   pid_cc_stats_t ccStats;  // continuity counter statistics, copied from the demuxer by the ingest thread
+
+   avc_sap_state_t avcSAPState;  // parameter set ids seen on this PID, used by the ingest thread for SAP detection
+   hevc_sap_state_t hevcSAPState;  // same, for HEVC
+
 } ebp_stream_info_t;
 
 typedef struct
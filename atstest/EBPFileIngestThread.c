@@ -31,14 +31,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <limits.h>
+#include <time.h>
 
 #include <mpeg2ts_demux.h>
 #include <libts_common.h>
 #include <tpes.h>
+#include <ts_source.h>
 #include <ebp.h>
 
 #include "h264_stream.h"
 
+#include "EBPCommon.h"
 #include "EBPSegmentAnalysisThread.h"
 #include "EBPIngestThreadCommon.h"
 #include "EBPFileIngestThread.h"
@@ -49,23 +53,44 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 void *EBPFileIngestThreadProc(void *threadParams)
 {
-   int returnCode = 0;
-
    ebp_file_ingest_thread_params_t * ebpFileIngestThreadParams = (ebp_file_ingest_thread_params_t *)threadParams;
    LOG_INFO_ARGS("EBPFileIngestThread %d starting...ebpFileIngestThreadParams = %p", 
       ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum, ebpFileIngestThreadParams);
 
+   if (fileIngestOpen(ebpFileIngestThreadParams) == 0)
+   {
+      while (1)
+      {
+         fileIngestWaitForWindow(ebpFileIngestThreadParams);
+         if (fileIngestStep(ebpFileIngestThreadParams, TS_SOURCE_MAX_PACKETS) <= 0)
+         {
+            break;
+         }
+         fileIngestUpdatePacing(ebpFileIngestThreadParams, 0 /* isFinished */);
+      }
+   }
+
+   fileIngestClose(ebpFileIngestThreadParams);
+
+   return NULL;
+}
+
+/**
+ * Opens the file and sets up its demux.  On failure the file is marked failed, and fileIngestClose
+ * must still be called to post end-of-stream to the analysis threads.
+ */
+int fileIngestOpen(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
+{
    // do file reading here
-   FILE *infile = NULL;
-   if ((infile = fopen(ebpFileIngestThreadParams->filePath, "rb")) == NULL)
+   if ((ebpFileIngestThreadParams->source = ts_source_new_file(ebpFileIngestThreadParams->filePath)) == NULL)
    {
       LOG_ERROR_ARGS("EBPFileIngestThread %d: FAIL: Cannot open file %s - %s", 
          ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum, ebpFileIngestThreadParams->filePath, strerror(errno));
       reportAddErrorLogArgs("EBPFileIngestThread %d: FAIL: Cannot open file %s - %s", 
          ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum, ebpFileIngestThreadParams->filePath, strerror(errno));
 
-      ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail = 0;
-      cleanupAndExit(ebpFileIngestThreadParams);
+      *(ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail) = 0;
+      return -1;
    }
 
    mpeg2ts_stream_t *m2s = NULL;
@@ -76,57 +101,94 @@ void *EBPFileIngestThreadProc(void *threadParams)
          ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum);
       reportAddErrorLogArgs("EBPFileIngestThread %d: FAIL: Error creating MPEG-2 STREAM object",
          ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum);
-      ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail = 0;
-      cleanupAndExit(ebpFileIngestThreadParams);
+      *(ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail) = 0;
+      return -1;
    }
+   ebpFileIngestThreadParams->m2s = m2s;
+
+   m2s->pat_processor = (pat_processor_t)ingest_pat_processor;
+   m2s->arg = ebpFileIngestThreadParams->ebpIngestThreadParams;
+   m2s->arg_destructor = NULL;
+
+   ebpFileIngestThreadParams->tsPool = ts_pool_new(TS_POOL_DEFAULT_SLAB_SIZE);
+
+   return 0;
+}
+
+/**
+ * Ingests up to maxPackets packets (at most TS_SOURCE_MAX_PACKETS).  Returns the number of packets
+ * ingested, 0 at the end of the file.
+ */
+int fileIngestStep(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams, int maxPackets)
+{
+   ts_source_t *source = ebpFileIngestThreadParams->source;
 
-   // Register EBP descriptor parser
-   descriptor_table_entry_t *desc = calloc(1, sizeof(descriptor_table_entry_t));
-   desc->tag = EBP_DESCRIPTOR;
-   desc->free_descriptor = ebp_descriptor_free;
-   desc->print_descriptor = ebp_descriptor_print;
-   desc->read_descriptor = ebp_descriptor_read;
-   if (!register_descriptor(desc))
+   if (maxPackets > TS_SOURCE_MAX_PACKETS)
    {
-      LOG_ERROR_ARGS("EBPFileIngestThread %d: FAIL: Could not register EBP descriptor parser",
-         ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum);
-      reportAddErrorLogArgs("EBPFileIngestThread %d: FAIL: Could not register EBP descriptor parser",
-         ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum);
-      ebpFileIngestThreadParams->ebpIngestThreadParams->ingestPassFail = 0;
+      maxPackets = TS_SOURCE_MAX_PACKETS;
+   }
 
-      cleanupAndExit(ebpFileIngestThreadParams);
+   // packets are parsed in place in the file mapping
+   uint8_t *packets[TS_SOURCE_MAX_PACKETS];
+   int num_packets = ts_source_acquire(source, packets, maxPackets);
+   if (num_packets <= 0)
+   {
+      return num_packets;
    }
 
-   m2s->pat_processor = (pat_processor_t)ingest_pat_processor;
-   m2s->arg = ebpFileIngestThreadParams->ebpIngestThreadParams;
-   m2s->arg_destructor = NULL;
+   LOG_INFO_ARGS ("total_packets = %"PRIu64", num_packets = %d", source->packets_read, num_packets);
+   for (int i = 0; i < num_packets; i++)
+   {
+      ts_packet_t *ts = ts_pool_get(ebpFileIngestThreadParams->tsPool);
+      ts_read_inplace(ts, packets[i], TS_SIZE);
+      int returnCode = mpeg2ts_stream_read_ts_packet(ebpFileIngestThreadParams->m2s, ts);
+      // GORP: error checking here: need to augment mpeg2ts_stream_read_ts_packet's error checking
+   }
+   ts_source_release(source, num_packets);
 
-   int num_packets = 4096;
-   uint8_t *ts_buf = malloc(TS_SIZE * 4096);
+   return num_packets;
+}
 
-   int total_packets = 0;
+/**
+ * Reports sync problems, frees the ingest state and posts end-of-stream to the analysis threads.
+ * Frees ebpFileIngestThreadParams.
+ */
+void fileIngestClose(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
+{
+   ts_source_t *source = ebpFileIngestThreadParams->source;
 
-   while ((num_packets = fread(ts_buf, TS_SIZE, 4096, infile)) > 0)
+   if (source != NULL)
    {
-      total_packets += num_packets;
-      LOG_INFO_ARGS ("total_packets = %d, num_packets = %d", total_packets, num_packets);
-      for (int i = 0; i < num_packets; i++)
+      LOG_INFO_ARGS ("total_packets = %"PRIu64", packet size = %d", source->packets_read, source->sync.packet_size);
+      if (source->sync.lost_sync_events > 0)
       {
-         ts_packet_t *ts = ts_new();
-         ts_read(ts, ts_buf + i * TS_SIZE, TS_SIZE);
-         int returnCode = mpeg2ts_stream_read_ts_packet(m2s, ts);
-         // GORP: error checking here: need to augment mpeg2ts_stream_read_ts_packet's error checking
+         LOG_ERROR_ARGS("EBPFileIngestThread %d: FAIL: Lost sync %"PRIu64" times in %s (%"PRIu64" bytes skipped)", 
+            ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum, source->sync.lost_sync_events, 
+            ebpFileIngestThreadParams->filePath, source->sync.skipped_bytes);
+         reportAddErrorLogArgs("EBPFileIngestThread %d: FAIL: Lost sync %"PRIu64" times in %s (%"PRIu64" bytes skipped)", 
+            ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum, source->sync.lost_sync_events, 
+            ebpFileIngestThreadParams->filePath, source->sync.skipped_bytes);
       }
    }
-   LOG_INFO_ARGS ("total_packets = %d, num_packets = %d", total_packets, num_packets);
-
-   mpeg2ts_stream_free(m2s);
 
-   fclose(infile);
+   // frees queued packets, so must precede the pool
+   if (ebpFileIngestThreadParams->m2s != NULL)
+   {
+      updateStreamCCStats(ebpFileIngestThreadParams->m2s, ebpFileIngestThreadParams->ebpIngestThreadParams);
+      reportStreamCCStats(ebpFileIngestThreadParams->ebpIngestThreadParams, ebpFileIngestThreadParams->filePath);
+      mpeg2ts_stream_free(ebpFileIngestThreadParams->m2s);
+   }
+   if (ebpFileIngestThreadParams->tsPool != NULL)
+   {
+      ts_pool_free(ebpFileIngestThreadParams->tsPool);
+   }
+   if (source != NULL)
+   {
+      ts_source_free(source);
+   }
 
+   fileIngestUpdatePacing(ebpFileIngestThreadParams, 1 /* isFinished */);
    cleanupAndExit(ebpFileIngestThreadParams);
-
-   return NULL;
 }
 
 void cleanupAndExit(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
@@ -139,6 +201,12 @@ void cleanupAndExit(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
    void *element = NULL;
    for (int i=0; i<ebpFileIngestThreadParams->ebpIngestThreadParams->numStreams; i++)
    {
+      if (streamInfos[i] == NULL)
+      {
+         // stream is absent from this file
+         continue;
+      }
+
       returnCode = fifo_push (streamInfos[i]->fifo, element);
       if (returnCode != 0)
       {
@@ -160,3 +228,301 @@ void cleanupAndExit(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
 }
 
 
+
+// an analysis thread may be waiting on an empty fifo, so its file must not be held back
+static int hasEmptyFIFO(ebp_ingest_thread_params_t *ebpIngestThreadParams)
+{
+   int arrayIndex = get2DArrayIndex (ebpIngestThreadParams->threadNum, 0, ebpIngestThreadParams->numStreams);
+   ebp_stream_info_t **streamInfos = &(ebpIngestThreadParams->allStreamInfos[arrayIndex]);
+
+   for (int i=0; i<ebpIngestThreadParams->numStreams; i++)
+   {
+      int size = 0;
+      if (streamInfos[i] != NULL && fifo_get_state (streamInfos[i]->fifo, &size) == 0 && size == 0)
+      {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+// caller holds pacing->mutex
+static int isAheadOfWindow(ebp_file_ingest_pacing_t *pacing, int fileIndex)
+{
+   if (!pacing->fileActive[fileIndex])
+   {
+      return 0;
+   }
+
+   for (int i=0; i<pacing->numFiles; i++)
+   {
+      if (i != fileIndex && pacing->fileActive[i] &&
+         (int64_t)(pacing->filePTS[fileIndex] - pacing->filePTS[i]) > (int64_t)pacing->windowPTS)
+      {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+ebp_file_ingest_pacing_t *fileIngestPacingNew(int numFiles, float windowSecs)
+{
+   ebp_file_ingest_pacing_t *pacing = (ebp_file_ingest_pacing_t *)calloc (1, sizeof(ebp_file_ingest_pacing_t));
+
+   pacing->numFiles = numFiles;
+   pacing->windowPTS = (windowSecs > 0) ? (uint64_t)(windowSecs * 90000) : 0;
+   pacing->fileActive = (int *)calloc (numFiles, sizeof(int));
+   pacing->filePTS = (uint64_t *)calloc (numFiles, sizeof(uint64_t));
+
+   pthread_mutex_init(&(pacing->mutex), NULL);
+   pthread_cond_init(&(pacing->cond), NULL);
+
+   return pacing;
+}
+
+void fileIngestPacingFree(ebp_file_ingest_pacing_t *pacing)
+{
+   if (pacing == NULL)
+   {
+      return;
+   }
+
+   pthread_mutex_destroy(&(pacing->mutex));
+   pthread_cond_destroy(&(pacing->cond));
+   free (pacing->fileActive);
+   free (pacing->filePTS);
+   free (pacing);
+}
+
+/**
+ * Non-blocking check used by the ingest pool: is the file too far ahead of the slowest file to be
+ * ingested now?
+ */
+int fileIngestIsAheadOfWindow(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
+{
+   ebp_file_ingest_pacing_t *pacing = ebpFileIngestThreadParams->pacing;
+   if (pacing == NULL || pacing->windowPTS == 0)
+   {
+      return 0;
+   }
+
+   pthread_mutex_lock(&(pacing->mutex));
+   int isAhead = isAheadOfWindow(pacing, ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum);
+   pthread_mutex_unlock(&(pacing->mutex));
+
+   return isAhead && !hasEmptyFIFO(ebpFileIngestThreadParams->ebpIngestThreadParams);
+}
+
+/**
+ * Blocks while the file is too far ahead of the slowest file.  Fifo pops do not signal the pacing
+ * condition, so the wait is timed in order to notice an analysis thread running this file's fifos dry.
+ */
+void fileIngestWaitForWindow(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams)
+{
+   ebp_file_ingest_pacing_t *pacing = ebpFileIngestThreadParams->pacing;
+   if (pacing == NULL || pacing->windowPTS == 0)
+   {
+      return;
+   }
+
+   int fileIndex = ebpFileIngestThreadParams->ebpIngestThreadParams->threadNum;
+
+   pthread_mutex_lock(&(pacing->mutex));
+   while (isAheadOfWindow(pacing, fileIndex) && !hasEmptyFIFO(ebpFileIngestThreadParams->ebpIngestThreadParams))
+   {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += FILE_INGEST_PACING_WAIT_USECS * 1000;
+      if (deadline.tv_nsec >= 1000000000)
+      {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000;
+      }
+
+      pthread_cond_timedwait(&(pacing->cond), &(pacing->mutex), &deadline);
+   }
+   pthread_mutex_unlock(&(pacing->mutex));
+}
+
+/**
+ * Publishes the file's latest PTS after a step, or removes it from the window once it is finished.
+ */
+void fileIngestUpdatePacing(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams, int isFinished)
+{
+   ebp_file_ingest_pacing_t *pacing = ebpFileIngestThreadParams->pacing;
+   if (pacing == NULL)
+   {
+      return;
+   }
+
+   ebp_ingest_thread_params_t *ebpIngestThreadParams = ebpFileIngestThreadParams->ebpIngestThreadParams;
+   int fileIndex = ebpIngestThreadParams->threadNum;
+
+   pthread_mutex_lock(&(pacing->mutex));
+   if (isFinished)
+   {
+      pacing->fileActive[fileIndex] = 0;
+   }
+   else if (ebpIngestThreadParams->lastPTSValid)
+   {
+      pacing->filePTS[fileIndex] = ebpIngestThreadParams->lastPTS;
+      pacing->fileActive[fileIndex] = 1;
+   }
+   pthread_cond_broadcast(&(pacing->cond));
+   pthread_mutex_unlock(&(pacing->mutex));
+}
+
+/**
+ * Free space of the fullest of the file's fifos
+ */
+static int getMinFIFOSpace(ebp_ingest_thread_params_t *ebpIngestThreadParams)
+{
+   int arrayIndex = get2DArrayIndex (ebpIngestThreadParams->threadNum, 0, ebpIngestThreadParams->numStreams);
+   ebp_stream_info_t **streamInfos = &(ebpIngestThreadParams->allStreamInfos[arrayIndex]);
+
+   int minSpace = INT_MAX;
+   for (int i=0; i<ebpIngestThreadParams->numStreams; i++)
+   {
+      if (streamInfos[i] == NULL)
+      {
+         continue;
+      }
+
+      // only a snapshot, but only the consumer changes it while this file is not being ingested, and
+      // the consumer only makes room
+      int space = 0;
+      fifo_get_free_space (streamInfos[i]->fifo, &space);
+      if (space < minSpace)
+      {
+         minSpace = space;
+      }
+   }
+
+   return minSpace;
+}
+
+ebp_file_ingest_pool_t *fileIngestPoolNew(int numFiles, ebp_file_ingest_thread_params_t **files, int numThreads)
+{
+   ebp_file_ingest_pool_t *pool = (ebp_file_ingest_pool_t *)calloc (1, sizeof(ebp_file_ingest_pool_t));
+
+   pool->numFiles = numFiles;
+   pool->files = (ebp_file_ingest_thread_params_t **)calloc (numFiles, sizeof(ebp_file_ingest_thread_params_t *));
+   memcpy (pool->files, files, numFiles * sizeof(ebp_file_ingest_thread_params_t *));
+   pool->fileBusy = (int *)calloc (numFiles, sizeof(int));
+   pool->numThreadsRunning = numThreads;
+
+   pthread_mutex_init(&(pool->mutex), NULL);
+
+   return pool;
+}
+
+void *EBPFileIngestPoolThreadProc(void *threadParams)
+{
+   ebp_file_ingest_pool_t *pool = (ebp_file_ingest_pool_t *)threadParams;
+   LOG_INFO_ARGS("EBPFileIngestPoolThread starting...pool = %p", pool);
+
+   int stalledUsecs = 0;  // how long no file has been runnable or being ingested
+   while (1)
+   {
+      ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams = NULL;
+      int fileIndex = -1;
+      int maxPackets = 0;
+      int anyBusy = 0;
+
+      pthread_mutex_lock(&(pool->mutex));
+      int allDone = (pool->numFilesDone == pool->numFiles);
+      for (int i=0; !allDone && i<pool->numFiles; i++)
+      {
+         int index = (pool->nextFile + i) % pool->numFiles;
+         if (pool->files[index] == NULL || pool->fileBusy[index])
+         {
+            anyBusy |= (pool->files[index] != NULL);
+            continue;
+         }
+
+         // a packet completes at most one PES, which posts at most one element per partition; one slot
+         // is kept for the end-of-stream NULL.  The space includes any overdraw granted by an analysis
+         // thread that is waiting on another file, so this file is not held back on its credits then.
+         int space = getMinFIFOSpace(pool->files[index]->ebpIngestThreadParams);
+         int packetsWithRoom = (space - 1) / EBP_NUM_PARTITIONS;
+         if (packetsWithRoom < 1 || fileIngestIsAheadOfWindow(pool->files[index]))
+         {
+            continue;
+         }
+
+         fileIndex = index;
+         ebpFileIngestThreadParams = pool->files[index];
+         maxPackets = (packetsWithRoom < FILE_INGEST_POOL_STEP_PACKETS) ? packetsWithRoom : FILE_INGEST_POOL_STEP_PACKETS;
+         pool->fileBusy[index] = 1;
+         pool->nextFile = index + 1;
+         break;
+      }
+      pthread_mutex_unlock(&(pool->mutex));
+
+      if (allDone)
+      {
+         break;
+      }
+      if (ebpFileIngestThreadParams == NULL)
+      {
+         // every unfinished file is being ingested, is waiting for an analysis thread or is ahead of
+         // the PTS window.  If none is being ingested for long, the analysis threads are waiting on
+         // files that are waiting on them, even with overdraw: fail rather than hang.
+         stalledUsecs = anyBusy ? 0 : stalledUsecs + FILE_INGEST_POOL_IDLE_USECS;
+         if (stalledUsecs >= FIFO_STALL_USECS)
+         {
+            LOG_ERROR_ARGS ("EBPFileIngestPoolThread: FAIL: no file has had room in its FIFOs for %d secs: a file posts no boundaries on a stream that the other files keep posting to: giving up",
+               FIFO_STALL_USECS / 1000000);
+            reportAddErrorLogArgs ("EBPFileIngestPoolThread: FAIL: no file has had room in its FIFOs for %d secs: a file posts no boundaries on a stream that the other files keep posting to: giving up",
+               FIFO_STALL_USECS / 1000000);
+            exit (-1);
+         }
+
+         usleep (FILE_INGEST_POOL_IDLE_USECS);
+         continue;
+      }
+      stalledUsecs = 0;
+
+      int num_packets = -1;
+      if (ebpFileIngestThreadParams->source != NULL || fileIngestOpen(ebpFileIngestThreadParams) == 0)
+      {
+         num_packets = fileIngestStep(ebpFileIngestThreadParams, maxPackets);
+      }
+
+      int fileDone = (num_packets <= 0);
+      if (fileDone)
+      {
+         fileIngestClose(ebpFileIngestThreadParams);
+      }
+      else
+      {
+         fileIngestUpdatePacing(ebpFileIngestThreadParams, 0 /* isFinished */);
+      }
+
+      pthread_mutex_lock(&(pool->mutex));
+      pool->fileBusy[fileIndex] = 0;
+      if (fileDone)
+      {
+         pool->files[fileIndex] = NULL;
+         pool->numFilesDone++;
+      }
+      pthread_mutex_unlock(&(pool->mutex));
+   }
+
+   pthread_mutex_lock(&(pool->mutex));
+   int isLastThread = (--pool->numThreadsRunning == 0);
+   pthread_mutex_unlock(&(pool->mutex));
+
+   LOG_INFO("EBPFileIngestPoolThread exiting...");
+   if (isLastThread)
+   {
+      pthread_mutex_destroy(&(pool->mutex));
+      free (pool->files);
+      free (pool->fileBusy);
+      free (pool);
+   }
+
+   return NULL;
+}
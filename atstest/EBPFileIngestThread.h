@@ -30,17 +30,90 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "ThreadSafeFIFO.h"
 #include <tpes.h>
+#include <mpeg2ts_demux.h>
+#include <ts_source.h>
+#include "EBPCommon.h"
 #include "EBPIngestThreadCommon.h"
 
+// Most packets a pool thread ingests from one file before moving on to the next file
+#define FILE_INGEST_POOL_STEP_PACKETS 1024
+
+// How long a pool thread sleeps when every unfinished file is waiting on a full fifo
+#define FILE_INGEST_POOL_IDLE_USECS 1000
+
+// Smallest fileIngestQueueDepth: a pool thread needs room for one packet's posts (one per partition)
+// plus the end-of-stream NULL before it can ingest from a file
+#define FILE_INGEST_MIN_QUEUE_DEPTH (2 * (EBP_NUM_PARTITIONS + 1))
+
+// How often a file held back by the PTS window rechecks whether an analysis thread is waiting on it
+#define FILE_INGEST_PACING_WAIT_USECS 10000
+
+/**
+ * Keeps the files of a file mode run within a PTS window of each other, so that no file gets far
+ * ahead of the others while the analysis threads, which pop every file's fifo in turn, wait on the
+ * slowest one.  A file ahead of the window still ingests if one of its fifos is empty, since an
+ * analysis thread may then be waiting on it.
+ */
+typedef struct
+{
+   int numFiles;
+   uint64_t windowPTS;  // 90kHz; 0 disables pacing
+   int *fileActive;     // file has a PTS and has not finished
+   uint64_t *filePTS;   // most recent (unwrapped) PTS ingested from each active file
+
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;  // broadcast when a file's PTS changes or it finishes
+
+} ebp_file_ingest_pacing_t;
+
 typedef struct 
 {
     char *filePath;
     ebp_ingest_thread_params_t *ebpIngestThreadParams;
+    ebp_file_ingest_pacing_t *pacing;  // shared by all files, NULL for no pacing
+
+    // ingest state, set up by fileIngestOpen
+    ts_source_t *source;
+    mpeg2ts_stream_t *m2s;
+    ts_pool_t *tsPool;
 
 } ebp_file_ingest_thread_params_t;
 
+/**
+ * Shared by the threads of a file ingest pool, which multiplex numFiles files over fewer threads.
+ * A file is ingested by one pool thread at a time, and only while its fifos have room for everything
+ * a step can post (including any overdraw, see fifo_set_overdraw), so a pool thread does not block on
+ * a fifo that is waiting on another file.
+ */
+typedef struct
+{
+   int numFiles;
+   ebp_file_ingest_thread_params_t **files;  // NULL once a file is finished
+   int *fileBusy;  // file is being ingested by a pool thread
+
+   int numFilesDone;
+   int nextFile;  // where the round-robin search starts
+   int numThreadsRunning;  // the last pool thread to exit frees the pool
+
+   pthread_mutex_t mutex;
+
+} ebp_file_ingest_pool_t;
+
+
+int fileIngestOpen(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams);
+int fileIngestStep(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams, int maxPackets);
+void fileIngestClose(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams);
 
 void cleanupAndExit(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams);
 void *EBPFileIngestThreadProc(void *threadParams);
 
+ebp_file_ingest_pacing_t *fileIngestPacingNew(int numFiles, float windowSecs);
+void fileIngestPacingFree(ebp_file_ingest_pacing_t *pacing);
+int fileIngestIsAheadOfWindow(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams);
+void fileIngestWaitForWindow(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams);
+void fileIngestUpdatePacing(ebp_file_ingest_thread_params_t *ebpFileIngestThreadParams, int isFinished);
+
+ebp_file_ingest_pool_t *fileIngestPoolNew(int numFiles, ebp_file_ingest_thread_params_t **files, int numThreads);
+void *EBPFileIngestPoolThreadProc(void *threadParams);
+
 #endif  // __H_EBPFILEINGESTTHREAD_67511FLKKJF
@@ -38,8 +38,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <psi.h>
 #include <ebp.h>
 #include <scte35.h>
+#include <audio_sap.h>
 
-#include "h264_stream.h"
 
 #include "EBPSegmentAnalysisThread.h"
 #include "EBPFileIngestThread.h"
@@ -58,6 +58,73 @@ static char *STREAM_TYPE_AUDIO = "AUDIO";
 static char* getStreamTypeDesc (elementary_stream_info_t *esi);
 
 
+// the first PTS seen by any ingest: the timelines of all ingests are anchored to it so that
+// ingests starting on either side of a PTS wraparound stay comparable
+static pts_timeline_t g_ptsAnchor;
+static pthread_mutex_t g_ptsAnchorMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void anchorIngestPTSTimeline(ebp_ingest_thread_params_t *ebpIngestThreadParams, uint64_t PTS)
+{
+   if (ebpIngestThreadParams->ptsTimeline.valid)
+   {
+      return;
+   }
+
+   pthread_mutex_lock (&g_ptsAnchorMutex);
+   if (!g_ptsAnchor.valid)
+   {
+      pts_timeline_unwrap (&g_ptsAnchor, PTS);
+   }
+   pts_timeline_seed (&(ebpIngestThreadParams->ptsTimeline), g_ptsAnchor.last);
+   pthread_mutex_unlock (&g_ptsAnchorMutex);
+}
+
+/**
+ * Returns the PTS on the 64-bit timeline of this ingest, advancing the timeline.
+ */
+static uint64_t unwrapIngestPTS(ebp_ingest_thread_params_t *ebpIngestThreadParams, uint64_t PTS)
+{
+   anchorIngestPTSTimeline (ebpIngestThreadParams, PTS);
+   return pts_timeline_unwrap (&(ebpIngestThreadParams->ptsTimeline), PTS);
+}
+
+static void unwrapSpliceTime(ebp_ingest_thread_params_t *ebpIngestThreadParams, scte35_splice_time *spliceTime,
+   uint64_t ptsAdjustment)
+{
+   if (spliceTime == NULL || !spliceTime->time_specified_flag)
+   {
+      return;
+   }
+
+   anchorIngestPTSTimeline (ebpIngestThreadParams, spliceTime->pts_time + ptsAdjustment);
+   spliceTime->pts_time = pts_unwrap (ebpIngestThreadParams->ptsTimeline.last, spliceTime->pts_time + ptsAdjustment);
+}
+
+/**
+ * Moves the splice times of a SCTE35 section onto the PTS timeline of this ingest, folding in pts_adjustment,
+ * so the SCTE35 lists can compare them directly with the (unwrapped) PES PTS.
+ */
+static void unwrapSCTE35PTS(ebp_ingest_thread_params_t *ebpIngestThreadParams, scte35_splice_info_section *splice_info)
+{
+   if (is_splice_insert (splice_info))
+   {
+      scte35_splice_insert* spliceInsert = get_splice_insert (splice_info);
+      unwrapSpliceTime (ebpIngestThreadParams, spliceInsert->splice_time, splice_info->pts_adjustment);
+
+      for (int i=0; spliceInsert->components != NULL && i<vqarray_length(spliceInsert->components); i++)
+      {
+         scte35_splice_insert_component *component = (scte35_splice_insert_component *) vqarray_get (spliceInsert->components, i);
+         unwrapSpliceTime (ebpIngestThreadParams, component->splice_time, splice_info->pts_adjustment);
+      }
+   }
+   else if (is_time_signal (splice_info))
+   {
+      unwrapSpliceTime (ebpIngestThreadParams, get_time_signal (splice_info)->splice_time, splice_info->pts_adjustment);
+   }
+
+   splice_info->pts_adjustment = 0;
+}
+
 static int validate_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_info, void *arg)
 {
 
@@ -92,6 +159,7 @@ static int validate_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_info
       }
 
       scte35_splice_info_section_print_stdout(splice_info); 
+      unwrapSCTE35PTS(ebpIngestThreadParams, splice_info);
 
       if (is_splice_insert (splice_info))
       {
@@ -161,7 +229,7 @@ static int validate_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_info
                   if (component->splice_time != NULL && component->splice_time->pts_time != 0)
                   {
                      uint64_t scte35PTS = component->splice_time->pts_time + splice_info->pts_adjustment;
-                     if (scte35PTS > (currentPTS + (uint64_t)(g_ATSTestAppConfig.scte35MinimumPrerollSeconds * 90000)))
+                     if (scte35PTS < (currentPTS + (uint64_t)(g_ATSTestAppConfig.scte35MinimumPrerollSeconds * 90000)))
                      {
                         LOG_WARN_ARGS("IngestThread %d: FAIL: current PTS %"PRId64" is too close to SCTE35 PTS %"PRId64" ", 
                            ebpIngestThreadParams->threadNum, currentPTS, scte35PTS);
@@ -271,10 +339,25 @@ static int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi,
       &fifo, &fifoIndex);
    ebp_stream_info_t * streamInfo = streamInfos[fifoIndex];
 
+   // everything downstream (boundaries, SCTE35 lists, analysis threads) compares unwrapped PTS
+   if (pes->header.PTS_DTS_flags & PES_PTS_FLAG)
+   {
+      pes->header.PTS = unwrapIngestPTS(ebpIngestThreadParams, pes->header.PTS);
+   }
+   if (pes->header.PTS_DTS_flags & PES_DTS_FLAG)
+   {
+      pes->header.DTS = pts_unwrap(ebpIngestThreadParams->ptsTimeline.last, pes->header.DTS);
+   }
+
    if (streamInfo->isVideo)
    {
       ebpIngestThreadParams->currentVideoPTS = pes->header.PTS;
    }
+   if (pes->header.PTS_DTS_flags & PES_PTS_FLAG)
+   {
+      ebpIngestThreadParams->lastPTS = pes->header.PTS;
+      ebpIngestThreadParams->lastPTSValid = 1;
+   }
    
    if (fifo == NULL)
    {
@@ -336,6 +419,11 @@ static int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi,
 
    int lastVideoPTSSet = 0;
 
+   if (!boundaryDetected)
+   {
+      // parameter sets can arrive in any PES packet; the ones at boundaries are seen by getSAPType
+      updateSAPState(pes, esi->stream_type, streamInfo);
+   }
 
    if (boundaryDetected)
    {
@@ -351,7 +439,7 @@ static int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi,
    {
       if (isBoundary[i])
       {
-         uint32_t sapType = getSAPType(pes, first_ts, esi->stream_type);
+         uint32_t sapType = getSAPType(pes, first_ts, esi->stream_type, streamInfo);
 
          ebp_descriptor_t* ebpDescriptor = getEBPDescriptor (esi);  // could be null
 
@@ -378,11 +466,41 @@ static int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi,
                ebpIngestThreadParams->threadNum, ebp_copy->ebp_acquisition_time);
          }
 
-         int returnCode = postToFIFO (pes->header.PTS, sapType, ebp_copy, ebpDescriptor, 
-            esi->elementary_PID, i, ebpIngestThreadParams->threadNum, 
-            ebpIngestThreadParams->numStreams, 
-            ebpIngestThreadParams->allStreamInfos);
-         if (returnCode != 0)
+         int returnCode = 0;
+         if (streamInfo->fifoStalled)
+         {
+            // already failed: see below
+            LOG_DEBUG_ARGS("IngestThread %d: dropping boundary for partition %d: PID %d (%s): FIFO stalled", 
+               ebpIngestThreadParams->threadNum, i, esi->elementary_PID, getStreamTypeDesc (esi));
+            if (ebp_copy != NULL) ebp_free (ebp_copy);
+         }
+         else
+         {
+            returnCode = postToFIFO (pes->header.PTS, sapType, ebp_copy, ebpDescriptor, 
+               esi->elementary_PID, i, ebpIngestThreadParams->threadNum, 
+               ebpIngestThreadParams->numStreams, 
+               ebpIngestThreadParams->allStreamInfos);
+         }
+
+         if (returnCode == FIFO_STALLED)
+         {
+            LOG_ERROR_ARGS("IngestThread %d: FAIL: FIFO for PID %d (%s) stayed full for %d secs while the other inputs posted no boundaries on this stream", 
+               ebpIngestThreadParams->threadNum, esi->elementary_PID, getStreamTypeDesc (esi), FIFO_STALL_USECS / 1000000);
+            reportAddErrorLogArgs("IngestThread %d: FAIL: FIFO for PID %d (%s) stayed full for %d secs while the other inputs posted no boundaries on this stream", 
+               ebpIngestThreadParams->threadNum, esi->elementary_PID, getStreamTypeDesc (esi), FIFO_STALL_USECS / 1000000);
+
+            if (!ebpIngestThreadParams->isStreamIngest)
+            {
+               // files can't be realigned: give up
+               exit (-1);
+            }
+
+            // a live input must keep running: fail this stream and drop its boundaries from now on,
+            // rather than block the ingest for FIFO_STALL_USECS on every one of them
+            streamInfo->streamPassFail = 0;
+            streamInfo->fifoStalled = 1;
+         }
+         else if (returnCode != 0)
          {
             LOG_ERROR_ARGS("IngestThread %d: FAIL: Error posting to FIFO for partition %d: PID %d (%s)", 
                ebpIngestThreadParams->threadNum, i, esi->elementary_PID, getStreamTypeDesc (esi));
@@ -453,23 +571,25 @@ static int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi,
 }
 
 
-uint32_t getSAPType(pes_packet_t *pes, ts_packet_t *first_ts,  uint32_t streamType)
+uint32_t getSAPType(pes_packet_t *pes, ts_packet_t *first_ts,  uint32_t streamType, ebp_stream_info_t *streamInfo)
 {
    switch (streamType) 
    {
       case STREAM_TYPE_AVC:
-         return getSAPType_AVC(pes, first_ts);
+         return getSAPType_AVC(pes, first_ts, &streamInfo->avcSAPState);
+      case STREAM_TYPE_HEVC:
+         return getSAPType_HEVC(pes, first_ts, &streamInfo->hevcSAPState);
       case STREAM_TYPE_MPEG2_AAC:
          return getSAPType_MPEG2_AAC(pes, first_ts);
       case STREAM_TYPE_MPEG4_AAC:
          return getSAPType_MPEG4_AAC(pes, first_ts);
       case STREAM_TYPE_AC3_AUDIO:
+      case STREAM_TYPE_EAC3_AUDIO:
          return getSAPType_AC3(pes, first_ts);
       case STREAM_TYPE_MPEG2_VIDEO:
          return getSAPType_MPEG2_VIDEO(pes, first_ts);
 
       // video
-      case STREAM_TYPE_HEVC:
       case STREAM_TYPE_MPEG1_VIDEO:
       case STREAM_TYPE_MPEG4_VIDEO:
       case STREAM_TYPE_SVC:
@@ -487,34 +607,58 @@ uint32_t getSAPType(pes_packet_t *pes, ts_packet_t *first_ts,  uint32_t streamTy
    }
 }
 
-uint32_t getSAPType_MPEG2_AAC(pes_packet_t *pes, ts_packet_t *first_ts)
+void updateSAPState(pes_packet_t *pes, uint32_t streamType, ebp_stream_info_t *streamInfo)
 {
-   // look for sync bits 0xFFF at start of PES to confirm that the PES starts an audio frame
-
-   uint8_t* buf = pes->payload;
-   int len = pes->payload_len;
+   switch (streamType) 
+   {
+      case STREAM_TYPE_AVC:
+         avc_sap_update_state(&streamInfo->avcSAPState, pes->payload, pes->payload_len);
+         break;
+      case STREAM_TYPE_HEVC:
+         hevc_sap_update_state(&streamInfo->hevcSAPState, pes->payload, pes->payload_len);
+         break;
+      default:
+         break;
+   }
+}
 
-   uint16_t syncWordExpected = 0xFFF;
-   uint16_t syncWordActual = ((0xF0 & buf[1]) << 4) | buf[0];  // GORP: byte order here?
+static uint32_t getSAPType_Audio(pes_packet_t *pes, uint32_t formats, const char *caller)
+{
+   // every audio frame is independently decodable, so it's sufficient to check that the PES
+   // packet starts with a frame (and that the next frame follows where the first one says)
+   audio_sap_info_t info;
+   int SAPType = audio_sap_classify(formats, pes->payload, pes->payload_len, &info);
+   if (SAPType != SAP_TYPE_NONE)
+   {
+      return SAPType;
+   }
 
-   if (syncWordExpected == syncWordActual)
+   if (info.frames_checked == 0)
    {
-      return 1;  // GORP: is this right??
+      LOG_ERROR_ARGS("%s: SAP_STREAM_TYPE_ERROR: PES does not start with a frame sync word (first bytes = %02x %02x)",
+         caller, pes->payload_len > 0 ? pes->payload[0] : 0, pes->payload_len > 1 ? pes->payload[1] : 0);
+      reportAddErrorLogArgs("%s: SAP_STREAM_TYPE_ERROR: PES does not start with a frame sync word (first bytes = %02x %02x)",
+         caller, pes->payload_len > 0 ? pes->payload[0] : 0, pes->payload_len > 1 ? pes->payload[1] : 0);
    }
    else
    {
-      LOG_ERROR_ARGS("getSAPType_MPEG2_AAC: SAP_STREAM_TYPE_ERROR: Expected sync word = %x. Actual sync word = %x",
-         syncWordExpected, syncWordActual);
-      reportAddErrorLogArgs("getSAPType_MPEG2_AAC: SAP_STREAM_TYPE_ERROR: Expected sync word = %x. Actual sync word = %x",
-         syncWordExpected, syncWordActual);
-      return SAP_STREAM_TYPE_ERROR;
+      LOG_ERROR_ARGS("%s: SAP_STREAM_TYPE_ERROR: first frame (%d bytes) is not followed by a valid frame",
+         caller, info.frame_size);
+      reportAddErrorLogArgs("%s: SAP_STREAM_TYPE_ERROR: first frame (%d bytes) is not followed by a valid frame",
+         caller, info.frame_size);
    }
+   return SAP_STREAM_TYPE_ERROR;
+}
+
+uint32_t getSAPType_MPEG2_AAC(pes_packet_t *pes, ts_packet_t *first_ts)
+{
+   return getSAPType_Audio(pes, AUDIO_SYNC_ADTS, "getSAPType_MPEG2_AAC");
 }
 
 uint32_t getSAPType_MPEG4_AAC(pes_packet_t *pes, ts_packet_t *first_ts)
 {
-   // same as MPEG 2
-   return getSAPType_MPEG4_AAC(pes, first_ts);
+   // stream_type 0x11 is LATM in a LOAS AudioSyncStream, not ADTS
+   return getSAPType_Audio(pes, AUDIO_SYNC_LOAS, "getSAPType_MPEG4_AAC");
 }
 
 uint32_t getSAPType_AC3(pes_packet_t *pes, ts_packet_t *first_ts)
@@ -527,64 +671,83 @@ uint32_t getSAPType_AC3(pes_packet_t *pes, ts_packet_t *first_ts)
 // through 5 may reuse exponents from previous blocks."
 // 
 // So, all AC3 frames are independent, and its sufficient to check that the PES packet 
-// contents start with a new AC3 frame.
+// contents start with a new AC3 frame.  The same holds for E-AC-3, which is told apart by bsid.
 
-   uint8_t* buf = pes->payload;
-   int len = pes->payload_len;
-
-   uint16_t syncWordExpected = 0x0B77;
-   uint16_t syncWordActual = (buf[1] << 8) | buf[0];  // GORP: byte order here?
+   return getSAPType_Audio(pes, AUDIO_SYNC_AC3 | AUDIO_SYNC_EAC3, "getSAPType_AC3");
+}
 
-   if (syncWordExpected == syncWordActual)
+uint32_t getSAPType_MPEG2_VIDEO(pes_packet_t *pes, ts_packet_t *first_ts)
+{
+   if (!first_ts->adaptation_field.random_access_indicator) 
    {
-      return 1;  // GORP: is this right??
+      return SAP_STREAM_TYPE_ERROR;
    }
-   else
+
+   // classify from the GOP header and picture_coding_type of the first picture
+   mpeg2_sap_info_t info;
+   int SAPType = mpeg2_sap_classify(pes->payload, pes->payload_len, &info);
+   if (SAPType == SAP_TYPE_NONE)
    {
+      LOG_INFO_ARGS("getSAPType_MPEG2_VIDEO: no SAP: picture_coding_type = %d", info.picture_coding_type);
       return SAP_STREAM_TYPE_ERROR;
    }
+
+   if (!info.sequence_header)
+   {
+      LOG_WARN_ARGS("getSAPType_MPEG2_VIDEO: SAP type %d is not preceded by a sequence header", SAPType);
+   }
+
+   return SAPType;
 }
 
-uint32_t getSAPType_MPEG2_VIDEO(pes_packet_t *pes, ts_packet_t *first_ts)
+uint32_t getSAPType_AVC(pes_packet_t *pes, ts_packet_t *first_ts, avc_sap_state_t *avcSAPState)
 {
-   // GORP: fill in
-   return SAP_STREAM_TYPE_NOT_SUPPORTED;
+   if (!first_ts->adaptation_field.random_access_indicator) 
+   {
+      return SAP_STREAM_TYPE_ERROR;
+   }
+
+   // classify from the NAL unit headers and the start of the first slice header; SPS/PPS ids
+   // seen on this PID are kept in avcSAPState
+   avc_sap_info_t info;
+   int SAPType = avc_sap_classify(avcSAPState, pes->payload, pes->payload_len, 1, &info);
+   if (SAPType == SAP_TYPE_NONE)
+   {
+      LOG_INFO_ARGS("getSAPType_AVC: no SAP: nal_unit_type = %d, slice_type = %d", 
+         info.nal_unit_type, info.slice_type);
+      return SAP_STREAM_TYPE_ERROR;
+   }
+
+   if (info.slice_type >= 0 && !info.param_sets_present)
+   {
+      LOG_WARN_ARGS("getSAPType_AVC: SAP type %d references PPS %d, but it or its SPS has not been seen", 
+         SAPType, info.pic_parameter_set_id);
+   }
+
+   return SAPType;
 }
 
-uint32_t getSAPType_AVC(pes_packet_t *pes, ts_packet_t *first_ts)
+uint32_t getSAPType_HEVC(pes_packet_t *pes, ts_packet_t *first_ts, hevc_sap_state_t *hevcSAPState)
 {
-   uint32_t SAPType = SAP_STREAM_TYPE_ERROR;
-   if (first_ts->adaptation_field.random_access_indicator) 
+   if (!first_ts->adaptation_field.random_access_indicator) 
    {
-      int nal_start, nal_end;
-      int returnCode;
-      uint8_t* buf = pes->payload;
-      int len = pes->payload_len;
+      return SAP_STREAM_TYPE_ERROR;
+   }
 
-      // walk the nal units in the PES payload and check to see if they are type 1 or type 5 -- these determine SAP type
-      int index = 0;
-      while ((len > index) && ((returnCode = find_nal_unit(buf + index, len - index, &nal_start, &nal_end)) !=  0))
-      {
-//         printf("nal_start = %d, nal_end = %d \n", nal_start, nal_end);
-         h264_stream_t* h = h264_new();
-         read_nal_unit(h, &buf[nal_start + index], nal_end - nal_start);
-//         printf("h->nal->nal_unit_type: %d \n", h->nal->nal_unit_type);
-         if (h->nal->nal_unit_type == 5)
-         {
-            SAPType = 1;
-            h264_free(h);
-            break;
-         }
-         else if (h->nal->nal_unit_type == 1)
-         {
-            SAPType = 2;
-            h264_free(h);
-            break;
-         }
+   // classify from the type of the first VCL NAL unit; VPS/SPS/PPS ids seen on this PID are
+   // kept in hevcSAPState
+   hevc_sap_info_t info;
+   int SAPType = hevc_sap_classify(hevcSAPState, pes->payload, pes->payload_len, 1, &info);
+   if (SAPType == SAP_TYPE_NONE)
+   {
+      LOG_INFO_ARGS("getSAPType_HEVC: no SAP: nal_unit_type = %d", info.nal_unit_type);
+      return SAP_STREAM_TYPE_ERROR;
+   }
 
-         h264_free(h);
-         index += nal_end;
-      }
+   if (info.pic_parameter_set_id >= 0 && !info.param_sets_present)
+   {
+      LOG_WARN_ARGS("getSAPType_HEVC: SAP type %d references PPS %d, but it or its SPS/VPS has not been seen", 
+         SAPType, info.pic_parameter_set_id);
    }
 
    return SAPType;
@@ -595,8 +758,7 @@ ebp_t* getEBP(ts_packet_t *ts, ebp_stream_info_t * streamInfo, int threadNum)
    ebp_t* ebp = NULL;
 
    vqarray_t *scte128_data;
-   if (!TS_HAS_ADAPTATION_FIELD(*ts) ||
-         (scte128_data = ts->adaptation_field.scte128_private_data) == NULL ||
+   if ((scte128_data = ts_get_scte128_private_data(ts)) == NULL ||
          vqarray_length(scte128_data) == 0)
    {
       return NULL;
@@ -766,6 +928,30 @@ language_descriptor_t* getLanguageDescriptor (elementary_stream_info_t *esi)
    return NULL;
 }
 
+void registerEBPPIDProcessor(mpeg2ts_program_t *m2p, uint32_t PID, pes_processor_t processPESPacket,
+   ts_pid_processor_t validateTSPacket, void *arg, size_t minPayloadLen)
+{
+   pes_demux_t *pd = pes_demux_new(processPESPacket);
+   pd->pes_arg = arg;
+   pd->pes_arg_destructor = NULL;
+   pd->min_payload_len = minPayloadLen;
+
+   // hook PES demuxer to the PID processor
+   demux_pid_handler_t *demux_handler = calloc(1, sizeof(demux_pid_handler_t));
+   demux_handler->process_ts_packet = pes_demux_process_ts_packet;
+   demux_handler->arg = pd;
+   demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;
+
+   // hook PES demuxer to the PID processor
+   demux_pid_handler_t *demux_validator = calloc(1, sizeof(demux_pid_handler_t));
+   demux_validator->process_ts_packet = validateTSPacket;
+   demux_validator->arg = arg;
+   demux_validator->arg_destructor = NULL;
+
+   // hook PID processor to PID; EBP is carried in SCTE-128 private data, see getEBP
+   mpeg2ts_program_register_pid_processor(m2p, PID, demux_handler, demux_validator, 1 /* scte128_enabled */);
+}
+
 int ingest_pmt_processor(mpeg2ts_program_t *m2p, void *arg)
 {
    if (m2p == NULL || m2p->pmt == NULL) // if we don't have any PSI, there's nothing we can do
@@ -803,24 +989,7 @@ int ingest_pmt_processor(mpeg2ts_program_t *m2p, void *arg)
          if (handle_pid)
          {
             LOG_INFO ("pmt_processor -- allocating....");
-            pes_demux_t *pd = pes_demux_new(validate_pes_packet);
-            pd->pes_arg = arg;
-            pd->pes_arg_destructor = NULL;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t *demux_handler = calloc(1, sizeof(demux_pid_handler_t));
-            demux_handler->process_ts_packet = pes_demux_process_ts_packet;
-            demux_handler->arg = pd;
-            demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t *demux_validator = calloc(1, sizeof(demux_pid_handler_t));
-            demux_validator->process_ts_packet = validate_ts_packet;
-            demux_validator->arg = arg;
-            demux_validator->arg_destructor = NULL;
-
-            // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator);
+            registerEBPPIDProcessor(m2p, pi->es_info->elementary_PID, validate_pes_packet, validate_ts_packet, arg, SAP_DETECTION_PAYLOAD_BYTES);
          }
       }
    }
@@ -882,8 +1051,8 @@ int postToFIFO  (uint64_t PTS, uint32_t sapType, ebp_t *ebp, ebp_descriptor_t *e
 
    ebpSegmentInfo->EBP = ebp;
    ebpSegmentInfo->partitionId = partitionId;
-   // make a copy of ebp_descriptor since this mem could be freed before being prcessed by analysis thread
-   ebpSegmentInfo->latestEBPDescriptor = ebp_descriptor_copy(ebpDescriptor);  
+   // the PMT could be replaced before the analysis thread processes this, so hold a reference to its arena
+   ebpSegmentInfo->latestEBPDescriptor = ebp_descriptor_retain(ebpDescriptor);  
    
    int arrayIndex = get2DArrayIndex (threadNum, 0, numStreams);
    ebp_stream_info_t **streamInfos = &(allStreamInfos[arrayIndex]);
@@ -913,7 +1082,14 @@ int postToFIFO  (uint64_t PTS, uint32_t sapType, ebp_t *ebp, ebp_descriptor_t *e
    reportAddPTS (PTS, partitionId, threadNum, fifoIndex, PID);
 
    int returnCode = fifo_push (fifo, ebpSegmentInfo);
-   if (returnCode != 0)
+   if (returnCode == FIFO_STALLED)
+   {
+      // the analysis thread is waiting on another input, which is not posting to this stream;
+      // the caller decides whether that ends the run
+      cleanupEBPSegmentInfo (ebpSegmentInfo);
+      return FIFO_STALLED;
+   }
+   else if (returnCode != 0)
    {
       LOG_ERROR_ARGS ("EBPIngestThread %d: FATAL error %d calling fifo_push on fifo %d (PID %d)", 
          threadNum, returnCode, (streamInfos[fifoIndex])->fifo->id, PID);
@@ -1124,6 +1300,49 @@ int detectBoundary(int threadNum, ebp_t* ebp, ebp_stream_info_t *streamInfo, uin
    return nReturnCode;
 }
 
+/**
+ * Copies the demuxer's continuity counter statistics into the stream infos of this ingest,
+ * where the report and the status menu pick them up.
+ */
+void updateStreamCCStats (mpeg2ts_stream_t *m2s, ebp_ingest_thread_params_t *ebpIngestThreadParams)
+{
+   int arrayIndex = get2DArrayIndex (ebpIngestThreadParams->threadNum, 0, ebpIngestThreadParams->numStreams);
+   ebp_stream_info_t **streamInfos = &(ebpIngestThreadParams->allStreamInfos[arrayIndex]);
+
+   for (int i=0; i<ebpIngestThreadParams->numStreams; i++)
+   {
+      if (streamInfos[i] != NULL)
+      {
+         mpeg2ts_stream_get_cc_stats (m2s, streamInfos[i]->PID, &(streamInfos[i]->ccStats));
+      }
+   }
+}
+
+/**
+ * Logs an error for each stream of this ingest that lost packets or had CC errors.
+ */
+void reportStreamCCStats (ebp_ingest_thread_params_t *ebpIngestThreadParams, char *ingestName)
+{
+   int arrayIndex = get2DArrayIndex (ebpIngestThreadParams->threadNum, 0, ebpIngestThreadParams->numStreams);
+   ebp_stream_info_t **streamInfos = &(ebpIngestThreadParams->allStreamInfos[arrayIndex]);
+
+   for (int i=0; i<ebpIngestThreadParams->numStreams; i++)
+   {
+      if (streamInfos[i] == NULL || streamInfos[i]->ccStats.num_cc_errors == 0)
+      {
+         continue;
+      }
+
+      pid_cc_stats_t *ccStats = &(streamInfos[i]->ccStats);
+      LOG_ERROR_ARGS("Ingest %d (%s): PID %d: %"PRIu64" CC errors, %"PRIu64" packets lost", 
+         ebpIngestThreadParams->threadNum, ingestName, streamInfos[i]->PID, 
+         ccStats->num_cc_errors, ccStats->num_lost_packets);
+      reportAddErrorLogArgs("Ingest %d (%s): PID %d: %"PRIu64" CC errors, %"PRIu64" packets lost", 
+         ebpIngestThreadParams->threadNum, ingestName, streamInfos[i]->PID, 
+         ccStats->num_cc_errors, ccStats->num_lost_packets);
+   }
+}
+
 uint64_t adjustPTSForTests (uint64_t PTSIn, int fileIndex, ebp_stream_info_t * streamInfo)
 {
    uint64_t PTSOut = PTSIn;
@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <tpes.h>
 #include <hashtable.h>
 #include "scte35.h"
+#include "pts_timeline.h"
 
 typedef struct 
 {
@@ -42,21 +43,37 @@ typedef struct
     ebp_stream_info_t **allStreamInfos;
 
     int *ingestPassFail;
+    int isStreamIngest;  // 1 for live stream ingest: a stalled fifo then fails the stream instead of ending the run
 
+    pts_timeline_t ptsTimeline;  // all PTS of this ingest are unwrapped on this timeline before use
     uint64_t currentVideoPTS;
+    uint64_t lastPTS;  // PTS of the most recent PES on any stream, valid once lastPTSValid is set
+    int lastPTSValid;
     hashtable_t *mapOldSCTE35SpliceInserts;  //hash map mapping eventIDs to latest PTS
 
     psi_table_buffer_t scte35TableBuffer;  // used for SCTE35 tabels that span mult TS packets
 
 } ebp_ingest_thread_params_t;
 
+// returns FIFO_STALLED, having dropped the boundary, if the fifo stayed full for FIFO_STALL_USECS
 int postToFIFO (uint64_t PTS, uint32_t sapType, ebp_t *ebp, ebp_descriptor_t *ebpDescriptor, uint32_t PID, 
                  uint8_t partitionId, int threadNum, int numStreams, ebp_stream_info_t **allStreamInfos);
 
+void updateStreamCCStats (mpeg2ts_stream_t *m2s, ebp_ingest_thread_params_t *ebpIngestThreadParams);
+void reportStreamCCStats (ebp_ingest_thread_params_t *ebpIngestThreadParams, char *ingestName);
+
 uint64_t adjustPTSForTests (uint64_t PTSIn, int fileIndex, ebp_stream_info_t * streamInfo);
 int ingest_pat_processor(mpeg2ts_stream_t *m2s, void *arg);
 int ingest_pmt_processor(mpeg2ts_program_t *m2p, void *arg);
 
+/**
+ * Hooks a PES demuxer calling processPESPacket (with minPayloadLen payload bytes contiguous) to PID,
+ * with validateTSPacket called for each of its TS packets, and enables SCTE-128 parsing on it for
+ * getEBP.  Replaces the PID's pid_info_t, so callers must not use it afterwards.
+ */
+void registerEBPPIDProcessor(mpeg2ts_program_t *m2p, uint32_t PID, pes_processor_t processPESPacket,
+   ts_pid_processor_t validateTSPacket, void *arg, size_t minPayloadLen);
+
 ebp_descriptor_t* getEBPDescriptor (elementary_stream_info_t *esi);
 component_name_descriptor_t* getComponentNameDescriptor (elementary_stream_info_t *esi);
 language_descriptor_t* getLanguageDescriptor (elementary_stream_info_t *esi);
@@ -70,8 +87,13 @@ int detectBoundary(int threadNum, ebp_t* ebp, ebp_stream_info_t *streamInfo, uin
 void triggerImplicitBoundaries (int threadNum, ebp_stream_info_t **streamInfoArray, int numStreams, int numFiles,
    int currentStreamInfoIndex, uint64_t PTS, uint8_t partitionId, int fileIndex);
 
-uint32_t getSAPType(pes_packet_t *pes, ts_packet_t *first_ts,  uint32_t streamType);
-uint32_t getSAPType_AVC(pes_packet_t *pes, ts_packet_t *first_ts);
+// PES payload bytes kept contiguous for SAP type detection -- the rest of the PES is never copied
+#define SAP_DETECTION_PAYLOAD_BYTES 4096
+
+uint32_t getSAPType(pes_packet_t *pes, ts_packet_t *first_ts,  uint32_t streamType, ebp_stream_info_t *streamInfo);
+void updateSAPState(pes_packet_t *pes, uint32_t streamType, ebp_stream_info_t *streamInfo);
+uint32_t getSAPType_AVC(pes_packet_t *pes, ts_packet_t *first_ts, avc_sap_state_t *avcSAPState);
+uint32_t getSAPType_HEVC(pes_packet_t *pes, ts_packet_t *first_ts, hevc_sap_state_t *hevcSAPState);
 uint32_t getSAPType_MPEG2_AAC(pes_packet_t *pes, ts_packet_t *first_ts);
 uint32_t getSAPType_MPEG4_AAC(pes_packet_t *pes, ts_packet_t *first_ts);
 uint32_t getSAPType_AC3(pes_packet_t *pes, ts_packet_t *first_ts);
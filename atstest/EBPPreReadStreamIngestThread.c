@@ -62,9 +62,8 @@ void *EBPPreReadStreamIngestThreadProc(void *threadParams)
    LOG_INFO_ARGS("EBPPreReadStreamIngestThread %d starting...ebpPreReadStreamIngestThreadParams = %p", 
       ebpPreReadStreamIngestThreadParams->threadNum, ebpPreReadStreamIngestThreadParams);
 
-   int num_packets = 4096;
-   int ts_buf_sz = TS_SIZE * num_packets;
-   uint8_t *ts_buf = malloc(ts_buf_sz);
+   int num_packets = 0;
+   ts_pool_t *ts_pool = ts_pool_new(TS_POOL_DEFAULT_SLAB_SIZE);
 
    LOG_INFO ("\n");
    LOG_INFO_ARGS ("Main:prereadIngestStreams: IngestStream %d", ebpPreReadStreamIngestThreadParams->threadNum); 
@@ -74,6 +73,7 @@ void *EBPPreReadStreamIngestThreadProc(void *threadParams)
    ebpPreReadStreamIngestThreadParams->bPMTFound = 0;
    ebpPreReadStreamIngestThreadParams->bEBPSearchEnded = 0;
    ebpPreReadStreamIngestThreadParams->streamStartTimeMsecs = -1;
+   pts_timeline_init (&(ebpPreReadStreamIngestThreadParams->ptsTimeline));
 
    mpeg2ts_stream_t *m2s = NULL;
 
@@ -87,47 +87,22 @@ void *EBPPreReadStreamIngestThreadProc(void *threadParams)
       return NULL;
    }
 
-   // Register EBP descriptor parser
-   descriptor_table_entry_t *desc = calloc(1, sizeof(descriptor_table_entry_t));
-   desc->tag = EBP_DESCRIPTOR;
-   desc->free_descriptor = ebp_descriptor_free;
-   desc->print_descriptor = ebp_descriptor_print;
-   desc->read_descriptor = ebp_descriptor_read;
-   if (!register_descriptor(desc))
-   {
-      LOG_ERROR_ARGS("Main:prereadIngestStreams: FAIL: Could not register EBP descriptor parser for ingest stream %d", 
-         ebpPreReadStreamIngestThreadParams->threadNum);
-      reportAddErrorLogArgs("Main:prereadIngestStreams: FAIL: Could not register EBP descriptor parser for ingest stream %d", 
-         ebpPreReadStreamIngestThreadParams->threadNum);
-      // GORP: fatal error here
-      return NULL;
-   }
-      
    m2s->pat_processor = (pat_processor_t)preread_pat_processor;
    m2s->arg = ebpPreReadStreamIngestThreadParams;
    m2s->arg_destructor = NULL;
 
-   int num_bytes = 0;
+   // peeks, so the stream ingest thread later starts from the same data
+   ts_source_t *source = cb_source_new(ebpPreReadStreamIngestThreadParams->cb, 1 /* isPeek */);
+   uint8_t *packets[TS_SOURCE_MAX_PACKETS];
    while (!(ebpPreReadStreamIngestThreadParams->bPATFound && 
             ebpPreReadStreamIngestThreadParams->bPMTFound && 
             ebpPreReadStreamIngestThreadParams->bEBPSearchEnded) 
-      && (num_bytes = cb_peek (ebpPreReadStreamIngestThreadParams->cb, ts_buf, ts_buf_sz)) > 0)
+      && (num_packets = ts_source_acquire (source, packets, TS_SOURCE_MAX_PACKETS)) > 0)
    {
-      if (num_bytes % TS_SIZE)
-      {
-         LOG_ERROR_ARGS("Main:prereadIngestStreams: FAIL: Incomplete transport packet received for ingest stream %d", 
-            ebpPreReadStreamIngestThreadParams->threadNum);
-         reportAddErrorLogArgs("Main:prereadIngestStreams: FAIL: Incomplete transport packet received for ingest stream %d", 
-            ebpPreReadStreamIngestThreadParams->threadNum);
-         // GORP: fatal error here
-         return NULL;
-      }
-      num_packets = num_bytes / TS_SIZE;
-
       for (int i = 0; i < num_packets; i++)
       {
-         ts_packet_t *ts = ts_new();
-         ts_read(ts, ts_buf + i * TS_SIZE, TS_SIZE);
+         ts_packet_t *ts = ts_pool_get(ts_pool);
+         ts_read_inplace(ts, packets[i], TS_SIZE);
          mpeg2ts_stream_read_ts_packet(m2s, ts);
 
          // check if PAT/PMT read -- if so, break out
@@ -139,11 +114,22 @@ void *EBPPreReadStreamIngestThreadProc(void *threadParams)
             break;
          }
       }
+      ts_source_release (source, num_packets);
    }
 
-   mpeg2ts_stream_free(m2s);  
+   if (num_packets < 0)
+   {
+      LOG_ERROR_ARGS("Main:prereadIngestStreams: FAIL: Error reading ingest stream %d", 
+         ebpPreReadStreamIngestThreadParams->threadNum);
+      reportAddErrorLogArgs("Main:prereadIngestStreams: FAIL: Error reading ingest stream %d", 
+         ebpPreReadStreamIngestThreadParams->threadNum);
+      // GORP: fatal error here
+   }
 
-   free (ts_buf);
+   // frees queued packets, so must precede the pool
+   mpeg2ts_stream_free(m2s);  
+   ts_pool_free(ts_pool);
+   ts_source_free(source);
    LOG_INFO_ARGS ("Main:prereadIngestStreams: exiting for ingest stream %d", ebpPreReadStreamIngestThreadParams->threadNum);
 
    return NULL;
@@ -173,7 +159,7 @@ static int preread_handle_pes_packet(pes_packet_t *pes, elementary_stream_info_t
    // if we get an ebp struct in each stream before that, then exit.
 
    // get time and exit if greater that limit
-   int64_t currentTimeMsecs = (pes->header.PTS * 1000) / 90000;
+   int64_t currentTimeMsecs = (pts_timeline_unwrap (&(ebpPreReadStreamIngestThreadParams->ptsTimeline), pes->header.PTS) * 1000) / 90000;
    if (ebpPreReadStreamIngestThreadParams->streamStartTimeMsecs == -1)
    {
       ebpPreReadStreamIngestThreadParams->streamStartTimeMsecs = currentTimeMsecs;
@@ -282,7 +268,7 @@ static int preread_pmt_processor(mpeg2ts_program_t *m2p, void *arg)
             demux_validator->arg_destructor = NULL;
 
             // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator);
+            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator, 0);
          }
          else if (IS_VIDEO_STREAM(pi->es_info->stream_type))
          {
@@ -329,24 +315,7 @@ static int preread_pmt_processor(mpeg2ts_program_t *m2p, void *arg)
                LOG_INFO_ARGS ("EBP Descriptor present -- no EBP detection necessary for PID: %d", pi->es_info->elementary_PID);
             }
 
-            pes_demux_t *pd = pes_demux_new(preread_handle_pes_packet);
-            pd->pes_arg = arg;
-            pd->pes_arg_destructor = NULL;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t *demux_handler = calloc(1, sizeof(demux_pid_handler_t));
-            demux_handler->process_ts_packet = pes_demux_process_ts_packet;
-            demux_handler->arg = pd;
-            demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;
-
-            // hook PES demuxer to the PID processor
-            demux_pid_handler_t *demux_validator = calloc(1, sizeof(demux_pid_handler_t));
-            demux_validator->process_ts_packet = preread_handle_ts_packet;
-            demux_validator->arg = arg;
-            demux_validator->arg_destructor = NULL;
-
-            // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator);
+            registerEBPPIDProcessor(m2p, pi->es_info->elementary_PID, preread_handle_pes_packet, preread_handle_ts_packet, arg, 0);
          }
       }
    }
@@ -433,7 +402,7 @@ void populateProgramStreamInfo(program_stream_info_t *programStreamInfo, mpeg2ts
          if (ebpDescriptor != NULL)
          {
             ebp_descriptor_print_stdout (ebpDescriptor);
-            programStreamInfo->ebpDescriptors[progStreamIndex] = ebp_descriptor_copy(ebpDescriptor);
+            programStreamInfo->ebpDescriptors[progStreamIndex] = ebp_descriptor_retain(ebpDescriptor);
          }
          else
          {
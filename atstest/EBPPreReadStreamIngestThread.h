@@ -44,6 +44,7 @@ typedef struct
     int bPMTFound;
     int bEBPSearchEnded;
     int64_t streamStartTimeMsecs;
+    pts_timeline_t ptsTimeline;
     vqarray_t *unfinishedPIDs;
     vqarray_t *ebpStructs;
 
@@ -43,6 +43,21 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ATSTestAppConfig.h"
 
 
+/**
+ * Pops (or peeks) the fifo of file fileIndex.  While it is empty, the other files' fifos for this stream
+ * may fill past their credits: otherwise a file with no boundaries on this stream for a while deadlocks
+ * with the files held back on this stream, which it may be waiting on for another stream.
+ */
+static int popPeekFileFIFO (int numFiles, ebp_stream_info_t **streamInfos, int fileIndex, void **element, int isPop)
+{
+   thread_safe_fifo_t *fifos[numFiles];
+   for (int i=0; i<numFiles; i++)
+   {
+      fifos[i] = (streamInfos[i] != NULL) ? streamInfos[i]->fifo : NULL;
+   }
+
+   return fifo_pop_peek_group (fifos, numFiles, fileIndex, element, isPop);
+}
 
 void *EBPSegmentAnalysisThreadProc(void *threadParams)
 {
@@ -89,11 +104,10 @@ void *EBPSegmentAnalysisThreadProc(void *threadParams)
             LOG_DEBUG_ARGS ("EBPSegmentAnalysisThread %d: fifo %d not active --- skipping", ebpSegmentAnalysisThreadParams->threadID, i);
             continue;
          }
-         thread_safe_fifo_t *fifo = streamInfo->fifo;
-
          void *element;
          LOG_DEBUG_ARGS ("EBPSegmentAnalysisThread %d: calling fifo_pop for fifo %d", ebpSegmentAnalysisThreadParams->threadID, i);
-         returnCode = fifo_pop (fifo, &element);
+         returnCode = popPeekFileFIFO (ebpSegmentAnalysisThreadParams->numFiles, ebpSegmentAnalysisThreadParams->streamInfos, 
+            i, &element, 1 /* isPop */);
          if (returnCode != 0)
          {
             LOG_ERROR_ARGS ("EBPSegmentAnalysisThread %d: FATAL error %d calling fifo_pop for fifo %d", ebpSegmentAnalysisThreadParams->threadID,
@@ -332,7 +346,7 @@ int syncIncomingStreams (int threadID, int numFiles, ebp_stream_info_t **streamI
       thread_safe_fifo_t *fifo = streamInfos[i]->fifo;
 
       LOG_DEBUG_ARGS ("EBPSegmentAnalysisThread:syncIncomingStreams %d: calling fifo_peek for fifo %d", threadID, i);
-      returnCode = fifo_peek (fifo, &element);
+      returnCode = popPeekFileFIFO (numFiles, streamInfos, i, &element, 0 /* isPop */);
       if (returnCode != 0)
       {
          LOG_ERROR_ARGS ("EBPSegmentAnalysisThread:syncIncomingStreams %d: FATAL error %d calling fifo_peek for fifo %d", threadID,
@@ -381,7 +395,7 @@ int syncIncomingStreams (int threadID, int numFiles, ebp_stream_info_t **streamI
       while (1)
       {
          LOG_DEBUG_ARGS ("EBPSegmentAnalysisThread:syncIncomingStreams %d: pruning: calling fifo_peek for fifo %d", threadID, i);
-         returnCode = fifo_peek (fifo, &element);
+         returnCode = popPeekFileFIFO (numFiles, streamInfos, i, &element, 0 /* isPop */);
          if (returnCode != 0)
          {
             LOG_ERROR_ARGS ("EBPSegmentAnalysisThread:syncIncomingStreams %d: pruning: FATAL error %d calling fifo_peek for fifo %d", threadID,
@@ -503,7 +517,7 @@ void cleanupEBPSegmentInfo (ebp_segment_info_t *ebpSegmentInfo)
 
    if (ebpSegmentInfo->latestEBPDescriptor != NULL)
    {
-      ebp_descriptor_free((descriptor_t *)(ebpSegmentInfo->latestEBPDescriptor));
+      ebp_descriptor_release(ebpSegmentInfo->latestEBPDescriptor);
    }
 
    free (ebpSegmentInfo);
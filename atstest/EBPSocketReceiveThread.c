@@ -29,10 +29,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
@@ -47,6 +51,167 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 static char *g_streamDumpBaseName = "EBPStreamDump";
 
+// Each datagram gets a receive slot of socketMaxDatagramSz bytes in the circular buffer; the slots are
+// packed together once the datagrams are in.  Larger datagrams are truncated and reported.  A slot
+// must at least hold 7 TS packets of any framing (RTP header, 192 or 204-byte packets), the most that
+// fits in an unfragmented datagram on a 1500-byte MTU.
+#define SOCKET_RECEIVE_MIN_DATAGRAM_SZ (7 * TS_SIZE_RS)
+
+// room for one SCM_TIMESTAMPNS control message per datagram
+#define SOCKET_RECEIVE_CONTROL_SZ 64
+
+/**
+ * Moves sz bytes within the reserved region from srcOffset down to dstOffset (dstOffset <= srcOffset),
+ * used to close the gap left in a datagram's slot when it was shorter than its slot.
+ */
+static void regionMove (cb_region_t *region, int dstOffset, int srcOffset, int sz)
+{
+   while (sz > 0)
+   {
+      int dstContiguousSz = 0;
+      int srcContiguousSz = 0;
+      uint8_t *dst = cb_region_ptr (region, dstOffset, &dstContiguousSz);
+      uint8_t *src = cb_region_ptr (region, srcOffset, &srcContiguousSz);
+
+      int chunkSz = sz;
+      if (chunkSz > dstContiguousSz)
+      {
+         chunkSz = dstContiguousSz;
+      }
+      if (chunkSz > srcContiguousSz)
+      {
+         chunkSz = srcContiguousSz;
+      }
+
+      memmove (dst, src, chunkSz);
+      dstOffset += chunkSz;
+      srcOffset += chunkSz;
+      sz -= chunkSz;
+   }
+}
+
+// copies sz bytes between the reserved region at offset and bytes, in either direction
+static void regionCopy (cb_region_t *region, int offset, uint8_t *bytes, int sz, int toRegion)
+{
+   while (sz > 0)
+   {
+      int contiguousSz = 0;
+      uint8_t *ptr = cb_region_ptr (region, offset, &contiguousSz);
+      if (contiguousSz > sz)
+      {
+         contiguousSz = sz;
+      }
+
+      if (toRegion)
+      {
+         memcpy (ptr, bytes, contiguousSz);
+      }
+      else
+      {
+         memcpy (bytes, ptr, contiguousSz);
+      }
+      offset += contiguousSz;
+      bytes += contiguousSz;
+      sz -= contiguousSz;
+   }
+}
+
+// true if the datagram at offset is nothing but whole 188-byte packets, the usual case
+static int isPlainDatagram (cb_region_t *region, int offset, int datagramSz)
+{
+   if (datagramSz == 0 || datagramSz % TS_SIZE != 0)
+   {
+      return 0;
+   }
+
+   for (int packetOffset = 0; packetOffset < datagramSz; packetOffset += TS_SIZE)
+   {
+      int contiguousSz = 0;
+      if (*cb_region_ptr (region, offset + packetOffset, &contiguousSz) != TS_SYNC_BYTE)
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/**
+ * Finds the TS packets in any other datagram (RTP encapsulation, 192 or 204-byte packets, corrupted
+ * data) and writes them as plain 188-byte packets to dstOffset, which is at or before the datagram.
+ * Returns the number of bytes written.
+ */
+static int normalizeDatagram (ts_sync_t *sync, cb_region_t *region, int dstOffset, int srcOffset, int datagramSz, 
+   uint8_t *scratch)
+{
+   regionCopy (region, srcOffset, scratch, datagramSz, 0);
+
+   // datagrams are framed independently, e.g. each may start with an RTP header
+   ts_sync_restart (sync);
+
+   int normalizedSz = 0;
+   size_t pos = 0;
+   size_t start = 0;
+   int numPackets = 0;
+   while ((numPackets = ts_sync_scan (sync, scratch + pos, datagramSz - pos, 1 /* is_eof */, datagramSz, &start)) > 0)
+   {
+      pos += start;
+      for (int i = 0; i < numPackets; i++)
+      {
+         regionCopy (region, dstOffset + normalizedSz, scratch + pos, TS_SIZE, 1);
+         normalizedSz += TS_SIZE;
+         pos += sync->packet_size;
+      }
+      if (pos > datagramSz)
+      {
+         pos = datagramSz;
+      }
+   }
+
+   return normalizedSz;
+}
+
+// returns the SO_TIMESTAMPNS receive time of a datagram in ns, or 0 if it has none
+static uint64_t getDatagramTimestamp (struct msghdr *msg)
+{
+   for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+   {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+      {
+         struct timespec ts;
+         memcpy (&ts, CMSG_DATA(cmsg), sizeof(ts));
+         return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+      }
+   }
+
+   return 0;
+}
+
+static void dumpStream (ebp_socket_receive_thread_params_t *ebpSocketReceiveThreadParams, FILE *streamLogFileHandle,
+   cb_region_t *region, int sz)
+{
+   int offset = 0;
+   while (offset < sz)
+   {
+      int contiguousSz = 0;
+      uint8_t *ptr = cb_region_ptr (region, offset, &contiguousSz);
+      if (contiguousSz > sz - offset)
+      {
+         contiguousSz = sz - offset;
+      }
+
+      size_t numBytesWritten = fwrite (ptr, 1, contiguousSz, streamLogFileHandle);
+      if (numBytesWritten != contiguousSz)
+      {
+         LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error writing to log file", 
+            ebpSocketReceiveThreadParams->threadNum);
+         reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error writing to log file", 
+            ebpSocketReceiveThreadParams->threadNum);
+         return;
+      }
+      offset += contiguousSz;
+   }
+}
+
 
 void *EBPSocketReceiveThreadProc(void *threadParams)
 {
@@ -56,9 +221,7 @@ void *EBPSocketReceiveThreadProc(void *threadParams)
    LOG_INFO_ARGS("EBPSocketReceiveThread %d starting...ebpSocketReceiveThreadParams->port = %d", 
       ebpSocketReceiveThreadParams->threadNum, ebpSocketReceiveThreadParams->port);
 
-   int num_bytes = 0;
    int ts_buf_sz = ebpSocketReceiveThreadParams->cb->bufSz;
-   int num_packets = ts_buf_sz / TS_SIZE;
    if (ts_buf_sz % TS_SIZE != 0)
    {
       LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Buffer not integral number of TS packets", 
@@ -68,10 +231,6 @@ void *EBPSocketReceiveThreadProc(void *threadParams)
       return NULL;
    }
 
-   uint8_t *ts_buf = malloc(ts_buf_sz);
-
-   int total_packets = 0;
-
 
    // create socket
    LOG_INFO_ARGS("EBPSocketReceiveThread %d: Creating socket...", ebpSocketReceiveThreadParams->threadNum);
@@ -154,12 +313,65 @@ void *EBPSocketReceiveThreadProc(void *threadParams)
    }
 
 
-   fd_set rfds;
+   // recvmmsg blocks for at most a second so that stopFlag and a disabled buffer are noticed
    struct timeval tv;
-   int retval;
-
    tv.tv_sec = 1;
    tv.tv_usec = 0;
+   if (setsockopt(mySocket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+   {
+      LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error from setsockopt: %s", 
+         ebpSocketReceiveThreadParams->threadNum, strerror(errno));
+      reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error from setsockopt: %s", 
+         ebpSocketReceiveThreadParams->threadNum, strerror(errno));
+      return NULL;
+   }
+
+   int enableTimestamps = (ebpSocketReceiveThreadParams->cb->arrivalTimes != NULL);
+   if (enableTimestamps)
+   {
+      int enable = 1;
+      if (setsockopt(mySocket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0)
+      {
+         LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error enabling SO_TIMESTAMPNS, arrival times not recorded: %s", 
+            ebpSocketReceiveThreadParams->threadNum, strerror(errno));
+         reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error enabling SO_TIMESTAMPNS, arrival times not recorded: %s", 
+            ebpSocketReceiveThreadParams->threadNum, strerror(errno));
+         enableTimestamps = 0;
+      }
+   }
+
+   int maxDatagrams = g_ATSTestAppConfig.socketRecvBatchSz;
+   if (maxDatagrams < 1)
+   {
+      maxDatagrams = 1;
+   }
+
+   int datagramSlotSz = g_ATSTestAppConfig.socketMaxDatagramSz;
+   if (datagramSlotSz < SOCKET_RECEIVE_MIN_DATAGRAM_SZ)
+   {
+      datagramSlotSz = SOCKET_RECEIVE_MIN_DATAGRAM_SZ;
+   }
+   if (datagramSlotSz > ts_buf_sz)
+   {
+      LOG_ERROR_ARGS("EBPSocketReceiveThread %d: socketMaxDatagramSz %d does not fit in the circular buffer (%d bytes)", 
+         ebpSocketReceiveThreadParams->threadNum, datagramSlotSz, ts_buf_sz);
+      reportAddErrorLogArgs("EBPSocketReceiveThread %d: socketMaxDatagramSz %d does not fit in the circular buffer (%d bytes)", 
+         ebpSocketReceiveThreadParams->threadNum, datagramSlotSz, ts_buf_sz);
+      close (mySocket);
+      return NULL;
+   }
+
+   // a datagram slot can wrap around the end of the buffer, so each one gets two iovecs
+   struct mmsghdr *msgs = (struct mmsghdr *) calloc (maxDatagrams, sizeof (struct mmsghdr));
+   struct iovec *iovecs = (struct iovec *) calloc (2 * maxDatagrams, sizeof (struct iovec));
+   uint8_t *controlBufs = enableTimestamps ? (uint8_t *) calloc (maxDatagrams, SOCKET_RECEIVE_CONTROL_SZ) : NULL;
+
+   // datagrams dropped by the overflow policy are still read from the socket, so that they are counted
+   uint8_t *discardBuf = NULL;
+
+   // contiguous copy of a datagram that needs normalizing
+   uint8_t *scratchBuf = (uint8_t *) malloc (datagramSlotSz);
+   ts_sync_init (&(ebpSocketReceiveThreadParams->sync));
 
    int totalTSPacketsReceived = 0;
 
@@ -210,61 +422,182 @@ void *EBPSocketReceiveThreadProc(void *threadParams)
 
    while (!ebpSocketReceiveThreadParams->stopFlag)
    {
-      // only ask for the number of bytes for which there is space
-      int availableSpace = cb_available_write_size (ebpSocketReceiveThreadParams->cb);
+      // receive straight into the free space of the circular buffer
+      cb_region_t region;
+      int availableSpace = cb_reserve (ebpSocketReceiveThreadParams->cb, ts_buf_sz, &region);
+      if (availableSpace == -99)
+      {
+         LOG_INFO_ARGS("EBPSocketReceiveThread %d: circular buffer disabled: exiting", 
+            ebpSocketReceiveThreadParams->threadNum);
+         break;
+      }
+      else if (availableSpace < 0)
+      {
+         LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error getting circular buffer write space", 
+            ebpSocketReceiveThreadParams->threadNum);
+         reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error getting circular buffer write space", 
+            ebpSocketReceiveThreadParams->threadNum);
+         break;
+      }
 
-//      LOG_INFO_ARGS("EBPSocketReceiveThread %d: availableSpace = %d", ebpSocketReceiveThreadParams->threadNum,
-//         availableSpace);
+      int isDiscarding = 0;
+      if (availableSpace < datagramSlotSz)
+      {
+         // buffer full: ask for room for a full batch
+         returnCode = cb_handle_overflow (ebpSocketReceiveThreadParams->cb, maxDatagrams * datagramSlotSz);
+         if (returnCode == -99)
+         {
+            LOG_INFO_ARGS("EBPSocketReceiveThread %d: circular buffer disabled: exiting", 
+               ebpSocketReceiveThreadParams->threadNum);
+            break;
+         }
+         else if (returnCode < 0)
+         {
+            LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error handling circular buffer overflow", 
+               ebpSocketReceiveThreadParams->threadNum);
+            reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error handling circular buffer overflow", 
+               ebpSocketReceiveThreadParams->threadNum);
+            break;
+         }
+         else if (returnCode == 0)
+         {
+            // blocked waiting for the reader: try again
+            continue;
+         }
 
+         if (discardBuf == NULL)
+         {
+            discardBuf = (uint8_t *) malloc (maxDatagrams * datagramSlotSz);
+         }
+         region.ptr1 = discardBuf;
+         region.sz1 = maxDatagrams * datagramSlotSz;
+         region.ptr2 = NULL;
+         region.sz2 = 0;
+         availableSpace = region.sz1;
+         isDiscarding = 1;
+      }
+
+      int numSlots = availableSpace / datagramSlotSz;
+      if (numSlots > maxDatagrams)
+      {
+         numSlots = maxDatagrams;
+      }
 
-      FD_ZERO(&rfds);
-      FD_SET(mySocket, &rfds);
+      for (int i = 0; i < numSlots; i++)
+      {
+         int offset = i * datagramSlotSz;
+         int contiguousSz = 0;
+         struct msghdr *hdr = &(msgs[i].msg_hdr);
+         memset (hdr, 0, sizeof(struct msghdr));
+
+         hdr->msg_iov = &iovecs[2 * i];
+         hdr->msg_iov[0].iov_base = cb_region_ptr (&region, offset, &contiguousSz);
+         if (contiguousSz >= datagramSlotSz)
+         {
+            hdr->msg_iov[0].iov_len = datagramSlotSz;
+            hdr->msg_iovlen = 1;
+         }
+         else
+         {
+            hdr->msg_iov[0].iov_len = contiguousSz;
+            hdr->msg_iov[1].iov_base = cb_region_ptr (&region, offset + contiguousSz, &contiguousSz);
+            hdr->msg_iov[1].iov_len = datagramSlotSz - hdr->msg_iov[0].iov_len;
+            hdr->msg_iovlen = 2;
+         }
 
-      returnCode = select(mySocket + 1, &rfds, NULL, NULL, &tv);
+         if (enableTimestamps)
+         {
+            hdr->msg_control = controlBufs + i * SOCKET_RECEIVE_CONTROL_SZ;
+            hdr->msg_controllen = SOCKET_RECEIVE_CONTROL_SZ;
+         }
+      }
 
-      if (returnCode == -1)
+      LOG_DEBUG_ARGS("EBPSocketReceiveThread %d: Receiving...", ebpSocketReceiveThreadParams->threadNum);
+      int numDatagrams = recvmmsg(mySocket, msgs, numSlots, MSG_WAITFORONE, NULL);
+      if (numDatagrams < 0)
       {
+         if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+         {
+            if (cb_is_disabled (ebpSocketReceiveThreadParams->cb))
+            {
+               break;
+            }
+
+            continue;
+         }
+
          LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error receiving from socket: %s", 
             ebpSocketReceiveThreadParams->threadNum, strerror(errno));
          reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error receiving from socket: %s", 
             ebpSocketReceiveThreadParams->threadNum, strerror(errno));
          break;
       }
-      else if (returnCode == 0)
+
+      ebpSocketReceiveThreadParams->receiveCalls++;
+      ebpSocketReceiveThreadParams->receivedDatagrams += numDatagrams;
+
+      if (isDiscarding)
       {
-         if (cb_is_disabled (ebpSocketReceiveThreadParams->cb))
+         int droppedSz = 0;
+         for (int i = 0; i < numDatagrams; i++)
          {
-            break;
+            droppedSz += msgs[i].msg_len;
          }
 
+         cb_count_dropped (ebpSocketReceiveThreadParams->cb, droppedSz);
+         ebpSocketReceiveThreadParams->receivedBytes += droppedSz;
          continue;
       }
 
-      LOG_DEBUG_ARGS("EBPSocketReceiveThread %d: Receiving...", ebpSocketReceiveThreadParams->threadNum);
-      returnCode = recv(mySocket, ts_buf, availableSpace, 0 /* flags */);
-      if (returnCode < 0)
+      // pack the datagrams together as plain 188-byte packets and tag them with arrival times
+      int receivedSz = 0;
+      int receivedDatagramBytes = 0;
+      for (int i = 0; i < numDatagrams; i++)
       {
-         LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error receiving from socket: %s", 
-            ebpSocketReceiveThreadParams->threadNum, strerror(errno));
-         reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error receiving from socket: %s", 
-            ebpSocketReceiveThreadParams->threadNum, strerror(errno));
-         break;
+         int datagramSz = msgs[i].msg_len;
+         LOG_DEBUG_ARGS ("EBPSocketReceiveThread %d: Received %d bytes", ebpSocketReceiveThreadParams->threadNum, datagramSz);
+         receivedDatagramBytes += datagramSz;
+
+         if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+         {
+            LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Datagram truncated to %d bytes: increase socketMaxDatagramSz", 
+               ebpSocketReceiveThreadParams->threadNum, datagramSz);
+            reportAddErrorLogArgs("EBPSocketReceiveThread %d: Datagram truncated to %d bytes: increase socketMaxDatagramSz", 
+               ebpSocketReceiveThreadParams->threadNum, datagramSz);
+         }
+
+         int slotOffset = i * datagramSlotSz;
+         int packetsSz = datagramSz;
+         if (isPlainDatagram (&region, slotOffset, datagramSz))
+         {
+            if (slotOffset != receivedSz)
+            {
+               regionMove (&region, receivedSz, slotOffset, datagramSz);
+            }
+         }
+         else
+         {
+            packetsSz = normalizeDatagram (&(ebpSocketReceiveThreadParams->sync), &region, receivedSz, slotOffset, 
+               datagramSz, scratchBuf);
+         }
+
+         if (enableTimestamps && packetsSz > 0)
+         {
+            int contiguousSz = 0;
+            cb_set_arrival_time (ebpSocketReceiveThreadParams->cb, cb_region_ptr (&region, receivedSz, &contiguousSz), 
+               packetsSz, getDatagramTimestamp (&(msgs[i].msg_hdr)));
+         }
+
+         receivedSz += packetsSz;
       }
 
-      LOG_DEBUG_ARGS ("EBPSocketReceiveThread %d: Received %d bytes", ebpSocketReceiveThreadParams->threadNum, returnCode);
-      if (returnCode%TS_SIZE != 0)
+      if (ebpSocketReceiveThreadParams->enableStreamDump && streamLogFileHandle != NULL)
       {
-         LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Received bytes not integral number of TS packets", 
-            ebpSocketReceiveThreadParams->threadNum);
-         reportAddErrorLogArgs("EBPSocketReceiveThread %d: Received bytes not integral number of TS packets", 
-            ebpSocketReceiveThreadParams->threadNum);
-         break;
+         // log to file
+         dumpStream (ebpSocketReceiveThreadParams, streamLogFileHandle, &region, receivedSz);
       }
 
-      ebpSocketReceiveThreadParams->receivedBytes += returnCode;
-
-//      LOG_INFO_ARGS ("EBPSocketReceiveThread %d: Writing %d bytes to circular buffer", ebpSocketReceiveThreadParams->threadNum, returnCode);
-      int returnCodeTemp = cb_write (ebpSocketReceiveThreadParams->cb, ts_buf, returnCode);
+      int returnCodeTemp = cb_commit (ebpSocketReceiveThreadParams->cb, receivedSz);
       if (returnCodeTemp == -99)
       {
          LOG_INFO_ARGS("EBPSocketReceiveThread %d: circular buffer disabled: exiting", 
@@ -280,25 +613,15 @@ void *EBPSocketReceiveThreadProc(void *threadParams)
          break;
       }
 
-      totalTSPacketsReceived += (returnCode / TS_SIZE);
-//      LOG_INFO_ARGS("EBPSocketReceiveThread %d: Total TS packets: %d", 
-//            ebpSocketReceiveThreadParams->threadNum, totalTSPacketsReceived);
-
-      if (ebpSocketReceiveThreadParams->enableStreamDump)
-      {
-         // log to file
-         size_t numBytesWritten = fwrite (ts_buf, 1, returnCode, streamLogFileHandle);
-         if (numBytesWritten != returnCode)
-         {
-            LOG_ERROR_ARGS("EBPSocketReceiveThread %d: Error writing to log file", 
-               ebpSocketReceiveThreadParams->threadNum);
-            reportAddErrorLogArgs("EBPSocketReceiveThread %d: Error writing to log file", 
-               ebpSocketReceiveThreadParams->threadNum);
-         }
-      }
+      ebpSocketReceiveThreadParams->receivedBytes += receivedDatagramBytes;
+      totalTSPacketsReceived += (receivedSz / TS_SIZE);
    }
 
-   free (ts_buf);
+   free (msgs);
+   free (iovecs);
+   free (controlBufs);
+   free (discardBuf);
+   free (scratchBuf);
 
    close (mySocket);
    if (streamLogFileHandle != NULL)
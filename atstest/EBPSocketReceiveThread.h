@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __H_EBP_SOCKET_RECEIVE_THREAD
 
 #include "EBPStreamBuffer.h"
+#include "ts_sync.h"
 
 typedef struct 
 {
@@ -42,6 +43,10 @@ typedef struct
 
     int stopFlag;
     unsigned int receivedBytes;
+    unsigned int receivedDatagrams;
+    unsigned int receiveCalls;  // number of recvmmsg calls that returned data
+
+    ts_sync_t sync;  // framing of datagrams that are not plain 188-byte packets
 
 } ebp_socket_receive_thread_params_t;
 
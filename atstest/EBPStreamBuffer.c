@@ -28,14 +28,25 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <inttypes.h>
 #include <memory.h>
+#include <errno.h>
+#include <time.h>
 
 #include "log.h"
 #include "EBPStreamBuffer.h"
 #include "ATSTestReport.h"
+#include "ts.h"
 
+// Each index is published by its owner with a release (or stronger) store and read by the other side
+// with an acquire load, so data written before a commit/release is visible after the matching load.
+#define CB_LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define CB_STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
 
-static int cb_read_size_internal (circular_buffer_t *cb);
-static int cb_peek_size_internal (circular_buffer_t *cb);
+
+static void cb_region_init (circular_buffer_t *cb, uint64_t index, int sz, cb_region_t *region);
+static int cb_wait_readable (circular_buffer_t *cb, volatile uint64_t *cursor);
+static uint64_t cb_skip_to (circular_buffer_t *cb, uint64_t readIndex);
+static int cb_publish_read_index (circular_buffer_t *cb, uint64_t readIndex);
+static int cb_wait_writable (circular_buffer_t *cb, int bytesSz);
 
 
 int cb_init (circular_buffer_t *cb, int bufferSz)
@@ -63,39 +74,132 @@ int cb_init (circular_buffer_t *cb, int bufferSz)
       return -1;
    }
 
+   returnCode = pthread_cond_init(&(cb->cb_nonfull_cond), NULL);
+   if (returnCode != 0)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_init: pthread_cond_init failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_init: pthread_cond_init failed: %d", returnCode);
+      return -1;
+   }
+
 
    LOG_INFO_ARGS ("EBPSreamBuffer: cb_init: initializing buffer with size %d", bufferSz);
    cb->buf = (uint8_t*) malloc (bufferSz);
    cb->bufSz = bufferSz;
-   cb->writePtr = cb->buf;
-   cb->readPtr = cb->buf;
-   cb->peekPtr = cb->buf;
 
-   cb->writeBufferTraversals = 0;
-   cb->readBufferTraversals = 0;
-   cb->peekBufferTraversals = 0;
+   cb->writeIndex = 0;
+   cb->readIndex = 0;
+   cb->peekIndex = 0;
+   cb->acquireIndex = 0;
+   cb->readerWaiting = 0;
+   cb->writerWaiting = 0;
+   cb->disabled = 0;
+
+   cb->overflowPolicy = CB_OVERFLOW_DROP_NEWEST;
+   cb->skipIndex = 0;
+   cb->overflowing = 0;
+   cb->droppedBytes = 0;
+   cb->skippedBytes = 0;
+   cb->overflowEvents = 0;
+   cb->highWatermark = 0;
+
+   cb->arrivalTimes = NULL;
+
+   return 0;
+}
+
+int cb_enable_arrival_times (circular_buffer_t *cb)
+{
+   if (cb->bufSz % TS_SIZE != 0)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_enable_arrival_times: buffer size %d not a multiple of TS packets", cb->bufSz);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_enable_arrival_times: buffer size %d not a multiple of TS packets", cb->bufSz);
+      return -1;
+   }
+
+   if (cb->arrivalTimes == NULL)
+   {
+      cb->arrivalTimes = (uint64_t *) calloc (cb->bufSz / TS_SIZE, sizeof (uint64_t));
+   }
 
    return 0;
 }
 
+void cb_set_arrival_time (circular_buffer_t *cb, uint8_t *ptr, int bytesSz, uint64_t arrivalTime)
+{
+   // no locking needed: ptr is in the writer's reserved space
+   if (cb->arrivalTimes == NULL)
+   {
+      return;
+   }
+
+   int numSlots = cb->bufSz / TS_SIZE;
+   int slot = (ptr - cb->buf) / TS_SIZE;
+   for (int i = 0; i < bytesSz / TS_SIZE; i++)
+   {
+      cb->arrivalTimes[(slot + i) % numSlots] = arrivalTime;
+   }
+}
+
+uint64_t cb_get_arrival_time (circular_buffer_t *cb, uint8_t *ptr)
+{
+   if (cb->arrivalTimes == NULL)
+   {
+      return 0;
+   }
+
+   return cb->arrivalTimes[(ptr - cb->buf) / TS_SIZE];
+}
+
 void cb_empty (circular_buffer_t *cb)
 {
-   cb->writePtr = cb->buf;
-   cb->readPtr = cb->buf;
-   cb->peekPtr = cb->buf;
+   // WARNING: only safe while neither the reader nor the writer is active
+   cb->writeIndex = 0;
+   cb->readIndex = 0;
+   cb->peekIndex = 0;
+   cb->acquireIndex = 0;
+   cb->skipIndex = 0;
+}
 
-   cb->writeBufferTraversals = 0;
-   cb->readBufferTraversals = 0;
-   cb->peekBufferTraversals = 0;
+void cb_set_overflow_policy (circular_buffer_t *cb, cb_overflow_policy_t overflowPolicy)
+{
+   cb->overflowPolicy = overflowPolicy;
+}
+
+const char *cb_overflow_policy_name (cb_overflow_policy_t overflowPolicy)
+{
+   switch (overflowPolicy)
+   {
+      case CB_OVERFLOW_BLOCK:
+         return "block";
+      case CB_OVERFLOW_DROP_NEWEST:
+         return "dropNewest";
+      case CB_OVERFLOW_DROP_OLDEST:
+         return "dropOldest";
+      default:
+         return "unknown";
+   }
+}
+
+void cb_get_stats (circular_buffer_t *cb, cb_stats_t *stats)
+{
+   // counters are written by one thread each and only read here, so this is a snapshot
+   stats->droppedBytes = cb->droppedBytes;
+   stats->skippedBytes = cb->skippedBytes;
+   stats->overflowEvents = cb->overflowEvents;
+   stats->highWatermark = cb->highWatermark;
 }
 
 int cb_is_disabled (circular_buffer_t *cb) 
 {
-   return cb->disabled;
+   return __atomic_load_n(&(cb->disabled), __ATOMIC_SEQ_CST);
 }
 
 int cb_disable (circular_buffer_t *cb) 
 {
+   __atomic_store_n(&(cb->disabled), 1, __ATOMIC_SEQ_CST);
+
+   // the reader checks disabled under the mutex before sleeping, so it either sees it or gets the signal
    int returnCode = pthread_mutex_lock (&(cb->mutex));
    if (returnCode != 0)
    {
@@ -104,9 +208,12 @@ int cb_disable (circular_buffer_t *cb)
       return -2;
    }
 
-   cb->disabled = 1;
-
    returnCode = pthread_cond_signal(&(cb->cb_nonempty_cond));
+   if (returnCode == 0)
+   {
+      // a writer blocked by CB_OVERFLOW_BLOCK
+      returnCode = pthread_cond_signal(&(cb->cb_nonfull_cond));
+   }
    if (returnCode != 0)
    {
       // unlock mutex before returning
@@ -138,200 +245,325 @@ void cb_free (circular_buffer_t *cb)
       reportAddErrorLogArgs ("EBPSreamBuffer: cb_free: Error %d calling pthread_cond_destroy", returnCode);
    }
 
+   returnCode = pthread_cond_destroy(&(cb->cb_nonfull_cond));
+   if (returnCode != 0)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_free: Error %d calling pthread_cond_destroy", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_free: Error %d calling pthread_cond_destroy", returnCode);
+   }
+
+   free (cb->arrivalTimes);
    free (cb->buf);
    free (cb);
 }
 
-int cb_peek (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
+void cb_region_init (circular_buffer_t *cb, uint64_t index, int sz, cb_region_t *region)
 {
-   return cb_read_or_peek (cb, bytes, bytesSz, 1);
-}
+   int pos = index % cb->bufSz;
 
-int cb_read (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
-{
-   return cb_read_or_peek (cb, bytes, bytesSz, 0);
+   region->ptr1 = cb->buf + pos;
+   region->sz1 = cb->bufSz - pos;
+   if (region->sz1 > sz)
+   {
+      region->sz1 = sz;
+   }
+   region->ptr2 = cb->buf;
+   region->sz2 = sz - region->sz1;
 }
 
-int cb_read_or_peek (circular_buffer_t *cb, uint8_t* bytes, int bytesSz, int isPeek)
+uint8_t *cb_region_ptr (cb_region_t *region, int offset, int *contiguousSz)
 {
-   int returnCode = pthread_mutex_lock (&(cb->mutex));
-   if (returnCode != 0)
+   if (offset < region->sz1)
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_read_or_peek: pthread_mutex_lock failed: %d", returnCode);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_read_or_peek: pthread_mutex_lock failed: %d", returnCode);
-      return -2;
+      *contiguousSz = region->sz1 - offset;
+      return region->ptr1 + offset;
    }
 
-   int usedSz = 0;
-   if (isPeek)
+   *contiguousSz = region->sz2 - (offset - region->sz1);
+   return region->ptr2 + (offset - region->sz1);
+}
+
+/**
+ * Reader side: returns the number of bytes available past *cursor (readIndex or peekIndex), sleeping
+ * while there are none.  readerWaiting is raised before the final check and the writer publishes
+ * writeIndex before checking readerWaiting (both sequentially consistent), so either we see the new
+ * data or the writer sees us waiting and signals -- under the mutex, which we hold until
+ * pthread_cond_wait releases it.  Returns -99 if the buffer is disabled and empty.
+ */
+int cb_wait_readable (circular_buffer_t *cb, volatile uint64_t *cursor)
+{
+   uint64_t availableSz = CB_LOAD_ACQUIRE(&(cb->writeIndex)) - *cursor;
+   if (availableSz != 0)
    {
-      usedSz = cb_peek_size_internal (cb);
+      return (int)availableSz;
    }
-   else
+
+   int returnCode = pthread_mutex_lock (&(cb->mutex));
+   if (returnCode != 0)
    {
-      usedSz = cb_read_size_internal (cb);
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_wait_readable: pthread_mutex_lock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_wait_readable: pthread_mutex_lock failed: %d", returnCode);
+      return -2;
    }
 
-   if (usedSz == 0)
+   while (1)
    {
-      if (cb->disabled)
+      __atomic_store_n(&(cb->readerWaiting), 1, __ATOMIC_SEQ_CST);
+      availableSz = __atomic_load_n(&(cb->writeIndex), __ATOMIC_SEQ_CST) - *cursor;
+      if (availableSz != 0 || cb_is_disabled (cb))
       {
-         // unlock mutex before returning
-         pthread_mutex_unlock (&(cb->mutex));
-         return -99;
+         break;
       }
 
       returnCode = pthread_cond_wait(&(cb->cb_nonempty_cond), &(cb->mutex));
       if (returnCode != 0)
       {
          // unlock mutex before returning
-         LOG_ERROR_ARGS ("EBPSreamBuffer: cb_read_or_peek: pthread_cond_wait failed: %d", returnCode);
-         reportAddErrorLogArgs ("EBPSreamBuffer: cb_read_or_peek: pthread_cond_wait failed: %d", returnCode);
+         LOG_ERROR_ARGS ("EBPSreamBuffer: cb_wait_readable: pthread_cond_wait failed: %d", returnCode);
+         reportAddErrorLogArgs ("EBPSreamBuffer: cb_wait_readable: pthread_cond_wait failed: %d", returnCode);
+         __atomic_store_n(&(cb->readerWaiting), 0, __ATOMIC_RELAXED);
          pthread_mutex_unlock (&(cb->mutex));
          return -1;
       }
+   }
+   __atomic_store_n(&(cb->readerWaiting), 0, __ATOMIC_RELAXED);
 
-      if (isPeek)
-      {
-         usedSz = cb_peek_size_internal (cb);
-      }
-      else
-      {
-         usedSz = cb_read_size_internal (cb);
-      }
+   returnCode = pthread_mutex_unlock (&(cb->mutex));
+   if (returnCode != 0)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_wait_readable: pthread_mutex_unlock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_wait_readable: pthread_mutex_unlock failed: %d", returnCode);
+      return -2;
    }
 
-   int sizeToCopy = usedSz;
-   if (usedSz > bytesSz)
+   if (availableSz == 0)
    {
-      sizeToCopy = bytesSz;
+      return -99;
    }
 
-   uint8_t *startPtr = 0;
-   if (isPeek)
+   return (int)availableSz;
+}
+
+/**
+ * Reader side: moves readIndex up to skipIndex if the writer asked for the oldest data to be dropped
+ * (CB_OVERFLOW_DROP_OLDEST), counting what was skipped.
+ */
+uint64_t cb_skip_to (circular_buffer_t *cb, uint64_t readIndex)
+{
+   uint64_t skipIndex = CB_LOAD_ACQUIRE(&(cb->skipIndex));
+   if (skipIndex > readIndex)
    {
-      startPtr = cb->peekPtr;
+      cb->skippedBytes += skipIndex - readIndex;
+      return skipIndex;
    }
-   else
+
+   return readIndex;
+}
+
+/**
+ * Reader side: frees everything before readIndex.  Published sequentially consistent so that it is
+ * ordered before the writerWaiting check (the mirror image of cb_commit and cb_wait_readable).
+ */
+int cb_publish_read_index (circular_buffer_t *cb, uint64_t readIndex)
+{
+   // read automatically resets peeks
+   cb->peekIndex = readIndex;
+   CB_STORE_RELEASE(&(cb->acquireIndex), readIndex);
+   __atomic_store_n(&(cb->readIndex), readIndex, __ATOMIC_SEQ_CST);
+
+   if (!__atomic_load_n(&(cb->writerWaiting), __ATOMIC_SEQ_CST))
    {
-      startPtr = cb->readPtr;
+      return 0;
    }
 
-  // uint8_t *readPtr_Original = cb->readPtr;
- //  LOG_INFO_ARGS ("cb_read_or_peek: isPeek = %d, startPtr = 0x%x, sizeToCopy = %d", isPeek, (unsigned int)startPtr, sizeToCopy);
+   int returnCode = pthread_mutex_lock (&(cb->mutex));
+   if (returnCode != 0)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_publish_read_index: pthread_mutex_lock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_publish_read_index: pthread_mutex_lock failed: %d", returnCode);
+      return -2;
+   }
 
-   int sz1 = cb->buf + cb->bufSz - startPtr;
-   if (sz1 > sizeToCopy)
+   returnCode = pthread_cond_signal(&(cb->cb_nonfull_cond));
+   if (returnCode != 0)
    {
-      sz1 = sizeToCopy;
+      // unlock mutex before returning
+      pthread_mutex_unlock (&(cb->mutex));
+      return -1;  
    }
-   int sz2 = sizeToCopy - sz1;
-//   LOG_INFO_ARGS ("cb_read_or_peek: sz1 = %d, sz2= %d", sz1, sz2);
 
-   memcpy (bytes, startPtr, sz1);
-   startPtr += sz1;
-   if (startPtr >= cb->buf + cb->bufSz)
+   returnCode = pthread_mutex_unlock (&(cb->mutex));
+   if (returnCode != 0)
    {
-      startPtr = cb->buf;
-      if (isPeek)
-      {
-         cb->peekBufferTraversals++;
- //        printf ("peekBufferTraversals incrementing\n");
-      }
-      else
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_publish_read_index: pthread_mutex_unlock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_publish_read_index: pthread_mutex_unlock failed: %d", returnCode);
+      return -2;
+   }
+
+   return 0;
+}
+
+int cb_acquire (circular_buffer_t *cb, int bytesSz, cb_region_t *region)
+{
+   uint64_t readIndex = cb_skip_to (cb, cb->readIndex);
+   if (readIndex != cb->readIndex)
+   {
+      int returnCode = cb_publish_read_index (cb, readIndex);
+      if (returnCode != 0)
       {
-         cb->readBufferTraversals++;
- //        printf ("readBufferTraversals incrementing\n");
+         return returnCode;
       }
    }
 
-   memcpy (bytes + sz1, startPtr, sz2);
-   startPtr += sz2;
+   int availableSz = cb_wait_readable (cb, &(cb->readIndex));
+   if (availableSz < 0)
+   {
+      return availableSz;
+   }
 
-   if (isPeek)
+   if (availableSz > bytesSz)
    {
-      cb->peekPtr = startPtr;
+      availableSz = bytesSz;
    }
-   else
+   if (cb->overflowPolicy == CB_OVERFLOW_DROP_OLDEST && availableSz > CB_DROP_OLDEST_MAX_ACQUIRE(cb))
    {
-      cb->readPtr = startPtr;
-
-      // read automatically resets peeks
-      cb->peekPtr = startPtr;
-      cb->peekBufferTraversals = cb->readBufferTraversals;
+      // a drop-oldest writer can only skip data after the acquired span, so leave it half the buffer
+      availableSz = CB_DROP_OLDEST_MAX_ACQUIRE(cb);
    }
-//   LOG_INFO_ARGS ("cb_read_or_peek: ending cb->readPtr = 0x%x", (unsigned int)cb->readPtr);
+   cb_region_init (cb, cb->readIndex, availableSz, region);
 
-   returnCode = pthread_mutex_unlock (&(cb->mutex));
-   if (returnCode != 0)
+   // lets a drop-oldest writer know which data is in use
+   CB_STORE_RELEASE(&(cb->acquireIndex), cb->readIndex + availableSz);
+
+   return availableSz;
+}
+
+int cb_release (circular_buffer_t *cb, int bytesSz)
+{
+   uint64_t readIndex = cb->readIndex + bytesSz;
+   if (readIndex > CB_LOAD_ACQUIRE(&(cb->writeIndex)))
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_read_or_peek: pthread_mutex_unlock failed: %d", returnCode);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_read_or_peek: pthread_mutex_unlock failed: %d", returnCode);
-      return -2;
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_release: released sz %d greater than read sz %d", 
+         bytesSz, (int)(cb->writeIndex - cb->readIndex));
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_release: released sz %d greater than read sz %d", 
+         bytesSz, (int)(cb->writeIndex - cb->readIndex));
+      return -1;
    }
 
-   return sizeToCopy;
+   return cb_publish_read_index (cb, cb_skip_to (cb, readIndex));
 }
 
-int cb_write (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
+int cb_peek (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
 {
-   int returnCode = pthread_mutex_lock (&(cb->mutex));
-   if (returnCode != 0)
+   return cb_read_or_peek (cb, bytes, bytesSz, 1);
+}
+
+int cb_read (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
+{
+   return cb_read_or_peek (cb, bytes, bytesSz, 0);
+}
+
+int cb_read_or_peek (circular_buffer_t *cb, uint8_t* bytes, int bytesSz, int isPeek)
+{
+   volatile uint64_t *cursor = isPeek ? &(cb->peekIndex) : &(cb->readIndex);
+
+   if (!isPeek)
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_write: pthread_mutex_lock failed: %d", returnCode);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_write: pthread_mutex_lock failed: %d", returnCode);
-      return -2;
+      uint64_t readIndex = cb_skip_to (cb, cb->readIndex);
+      if (readIndex != cb->readIndex)
+      {
+         int returnCode = cb_publish_read_index (cb, readIndex);
+         if (returnCode != 0)
+         {
+            return returnCode;
+         }
+      }
    }
-      
-   if (cb->disabled)
+
+   int sizeToCopy = cb_wait_readable (cb, cursor);
+   if (sizeToCopy < 0)
    {
-      // unlock mutex before returning
-      pthread_mutex_unlock (&(cb->mutex));
-      return -99;
+      return sizeToCopy;
+   }
+   if (sizeToCopy > bytesSz)
+   {
+      sizeToCopy = bytesSz;
    }
 
-   int availableSz = cb->bufSz - cb_read_size_internal (cb);
-//   LOG_INFO_ARGS ("EBPSreamBuffer: cb_write: cb->bufSz = %d, cb_read_size_internal (cb) = %d, availableSz = %d", 
-//      cb->bufSz, cb_read_size_internal (cb), availableSz);
+   cb_region_t region;
+   cb_region_init (cb, *cursor, sizeToCopy, &region);
+   memcpy (bytes, region.ptr1, region.sz1);
+   memcpy (bytes + region.sz1, region.ptr2, region.sz2);
 
-   if (bytesSz > availableSz)
+   if (isPeek)
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_write: requested sz %d greater than available sz %d", bytesSz, availableSz);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_write: requested sz %d greater than available sz %d", bytesSz, availableSz);
-
-      returnCode = pthread_mutex_unlock (&(cb->mutex));
+      cb->peekIndex += sizeToCopy;
+   }
+   else
+   {
+      int returnCode = cb_release (cb, sizeToCopy);
       if (returnCode != 0)
       {
-         LOG_ERROR_ARGS ("EBPSreamBuffer: cb_write: pthread_mutex_unlock failed: %d", returnCode);
-         reportAddErrorLogArgs ("EBPSreamBuffer: cb_write: pthread_mutex_unlock failed: %d", returnCode);
-         return -2;
+         return returnCode;
       }
+   }
 
-      return -1;
+   return sizeToCopy;
+}
+
+int cb_reserve (circular_buffer_t *cb, int bytesSz, cb_region_t *region)
+{
+   if (cb_is_disabled (cb))
+   {
+      return -99;
    }
 
- //  LOG_INFO_ARGS ("cb_write: cb->writePtr = 0x%x, bytesSz = %d", (unsigned int)cb->writePtr, bytesSz);
+   int availableSz = cb->bufSz - (int)(cb->writeIndex - CB_LOAD_ACQUIRE(&(cb->readIndex)));
+   if (availableSz > bytesSz)
+   {
+      availableSz = bytesSz;
+   }
+   cb_region_init (cb, cb->writeIndex, availableSz, region);
 
-   int sz1 = cb->buf + cb->bufSz - cb->writePtr;
-   if (sz1 > bytesSz)
+   return availableSz;
+}
+
+int cb_commit (circular_buffer_t *cb, int bytesSz)
+{
+   if (cb_is_disabled (cb))
    {
-      sz1 = bytesSz;
+      return -99;
    }
-   int sz2 = bytesSz - sz1;
-//   LOG_INFO_ARGS ("cb_write: sz1 = %d, sz2 = %d", sz1, sz2);
 
-   memcpy (cb->writePtr, bytes, sz1);
-   cb->writePtr += sz1;
-   if (cb->writePtr >= cb->buf + cb->bufSz)
+   int availableSz = cb->bufSz - (int)(cb->writeIndex - CB_LOAD_ACQUIRE(&(cb->readIndex)));
+   if (bytesSz > availableSz)
    {
-      cb->writePtr = cb->buf;
-      cb->writeBufferTraversals++;
- //     printf ("writeBufferTraversals incrementing\n");
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_commit: committed sz %d greater than available sz %d", bytesSz, availableSz);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_commit: committed sz %d greater than available sz %d", bytesSz, availableSz);
+      return -1;
+   }
 
+   int bufferedSz = cb->bufSz - availableSz + bytesSz;
+   if (bufferedSz > cb->highWatermark)
+   {
+      cb->highWatermark = bufferedSz;
    }
+   cb->overflowing = 0;
 
-   memcpy (cb->writePtr, bytes + sz1, sz2);
-   cb->writePtr += sz2;
+   // sequentially consistent so that it is ordered before the readerWaiting check -- see cb_wait_readable
+   __atomic_store_n(&(cb->writeIndex), cb->writeIndex + bytesSz, __ATOMIC_SEQ_CST);
+   if (!__atomic_load_n(&(cb->readerWaiting), __ATOMIC_SEQ_CST))
+   {
+      return 0;
+   }
+
+   int returnCode = pthread_mutex_lock (&(cb->mutex));
+   if (returnCode != 0)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_commit: pthread_mutex_lock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_commit: pthread_mutex_lock failed: %d", returnCode);
+      return -2;
+   }
 
    returnCode = pthread_cond_signal(&(cb->cb_nonempty_cond));
    if (returnCode != 0)
@@ -344,37 +576,163 @@ int cb_write (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
    returnCode = pthread_mutex_unlock (&(cb->mutex));
    if (returnCode != 0)
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_write: pthread_mutex_unlock failed: %d", returnCode);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_write: pthread_mutex_unlock failed: %d", returnCode);
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_commit: pthread_mutex_unlock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_commit: pthread_mutex_unlock failed: %d", returnCode);
       return -2;
    }
 
    return 0;
 }
 
-int cb_read_size (circular_buffer_t *cb)
+/**
+ * Writer side of CB_OVERFLOW_BLOCK: sleeps until bytesSz are free, the buffer is disabled or
+ * CB_BLOCK_TIMEOUT_MSECS have passed.
+ */
+int cb_wait_writable (circular_buffer_t *cb, int bytesSz)
 {
+   struct timespec deadline;
+   clock_gettime (CLOCK_REALTIME, &deadline);
+   deadline.tv_sec += CB_BLOCK_TIMEOUT_MSECS / 1000;
+   deadline.tv_nsec += (CB_BLOCK_TIMEOUT_MSECS % 1000) * 1000000L;
+   if (deadline.tv_nsec >= 1000000000L)
+   {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+   }
+
    int returnCode = pthread_mutex_lock (&(cb->mutex));
    if (returnCode != 0)
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_read_size: pthread_mutex_lock failed: %d", returnCode);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_read_size: pthread_mutex_lock failed: %d", returnCode);
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_wait_writable: pthread_mutex_lock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_wait_writable: pthread_mutex_lock failed: %d", returnCode);
       return -2;
    }
 
-   int size = cb_read_size_internal (cb);
+   while (1)
+   {
+      __atomic_store_n(&(cb->writerWaiting), 1, __ATOMIC_SEQ_CST);
+      int availableSz = cb->bufSz - (int)(cb->writeIndex - __atomic_load_n(&(cb->readIndex), __ATOMIC_SEQ_CST));
+      if (availableSz >= bytesSz || cb_is_disabled (cb))
+      {
+         break;
+      }
 
-//      printf ("cb->readPtr = %x, cb->writePtr = %x size = %d\n", (unsigned int)cb->readPtr, (unsigned int)cb->writePtr, size);
+      returnCode = pthread_cond_timedwait(&(cb->cb_nonfull_cond), &(cb->mutex), &deadline);
+      if (returnCode == ETIMEDOUT)
+      {
+         break;
+      }
+      else if (returnCode != 0)
+      {
+         // unlock mutex before returning
+         LOG_ERROR_ARGS ("EBPSreamBuffer: cb_wait_writable: pthread_cond_timedwait failed: %d", returnCode);
+         reportAddErrorLogArgs ("EBPSreamBuffer: cb_wait_writable: pthread_cond_timedwait failed: %d", returnCode);
+         __atomic_store_n(&(cb->writerWaiting), 0, __ATOMIC_RELAXED);
+         pthread_mutex_unlock (&(cb->mutex));
+         return -1;
+      }
+   }
+   __atomic_store_n(&(cb->writerWaiting), 0, __ATOMIC_RELAXED);
 
    returnCode = pthread_mutex_unlock (&(cb->mutex));
    if (returnCode != 0)
    {
-      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_read_size: pthread_mutex_unlock failed: %d", returnCode);
-      reportAddErrorLogArgs ("EBPSreamBuffer: cb_read_size: pthread_mutex_unlock failed: %d", returnCode);
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_wait_writable: pthread_mutex_unlock failed: %d", returnCode);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_wait_writable: pthread_mutex_unlock failed: %d", returnCode);
       return -2;
    }
 
-   return size;
+   return 0;
+}
+
+int cb_handle_overflow (circular_buffer_t *cb, int bytesSz)
+{
+   if (cb_is_disabled (cb))
+   {
+      return -99;
+   }
+
+   if (bytesSz > cb->bufSz)
+   {
+      bytesSz = cb->bufSz;
+   }
+
+   if (!cb->overflowing)
+   {
+      cb->overflowing = 1;
+      cb->overflowEvents++;
+   }
+
+   if (cb->overflowPolicy == CB_OVERFLOW_BLOCK)
+   {
+      return cb_wait_writable (cb, bytesSz);
+   }
+
+   if (cb->overflowPolicy == CB_OVERFLOW_DROP_OLDEST)
+   {
+      // The reader's acquired span can't be taken away from it, so skip the oldest data after that;
+      // cb_acquire keeps the span to half the buffer so that there is some.  The space is freed when
+      // the reader next releases or acquires; until then the writer drops.
+      uint64_t skipIndex = CB_LOAD_ACQUIRE(&(cb->acquireIndex));
+      uint64_t readIndex = CB_LOAD_ACQUIRE(&(cb->readIndex));
+      if (skipIndex < readIndex)
+      {
+         skipIndex = readIndex;
+      }
+      if (skipIndex < cb->skipIndex)
+      {
+         skipIndex = cb->skipIndex;
+      }
+
+      // indices of whole-packet writes stay on packet boundaries
+      skipIndex = ((skipIndex + bytesSz + TS_SIZE - 1) / TS_SIZE) * TS_SIZE;
+      if (skipIndex > cb->writeIndex)
+      {
+         skipIndex = cb->writeIndex;
+      }
+      if (skipIndex > cb->skipIndex)
+      {
+         CB_STORE_RELEASE(&(cb->skipIndex), skipIndex);
+      }
+   }
+
+   return 1;
+}
+
+void cb_count_dropped (circular_buffer_t *cb, int bytesSz)
+{
+   cb->droppedBytes += bytesSz;
+}
+
+int cb_write (circular_buffer_t *cb, uint8_t* bytes, int bytesSz)
+{
+   cb_region_t region;
+   int availableSz = cb_reserve (cb, bytesSz, &region);
+   if (availableSz < 0)
+   {
+      return availableSz;
+   }
+
+   if (availableSz < bytesSz)
+   {
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_write: requested sz %d greater than available sz %d", bytesSz, availableSz);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_write: requested sz %d greater than available sz %d", bytesSz, availableSz);
+      return -1;
+   }
+
+   memcpy (region.ptr1, bytes, region.sz1);
+   memcpy (region.ptr2, bytes + region.sz1, region.sz2);
+
+   return cb_commit (cb, bytesSz);
+}
+
+int cb_read_size (circular_buffer_t *cb)
+{
+   // may be called from any thread, so this is only a snapshot
+   uint64_t readIndex = CB_LOAD_ACQUIRE(&(cb->readIndex));
+   uint64_t writeIndex = CB_LOAD_ACQUIRE(&(cb->writeIndex));
+
+   return (int)(writeIndex - readIndex);
 }
 
 int cb_available_write_size (circular_buffer_t *cb)
@@ -387,19 +745,133 @@ int cb_get_total_size (circular_buffer_t *cb)
    return cb->bufSz;
 }
 
-int cb_read_size_internal (circular_buffer_t *cb)
+
+// packet source over a circular buffer: hands out the contiguous parts of an acquired region in turn
+typedef struct
+{
+   circular_buffer_t *cb;
+   int isPeek;
+   cb_region_t region;
+   int regionSz;      // bytes acquired from the buffer
+   int regionPos;     // bytes of the region released so far
+   uint8_t *peekBuf;  // peek mode: copy of the peeked bytes
+   int peekBufSz;
+} cb_source_t;
+
+static int cb_source_acquire (ts_source_t *src, uint8_t **packets, int maxPackets)
 {
-   // WARNING: THIS FUNCTION DOES NOT LOCK THE MUTEX AND SHOULD ONLY
-   // BE CALLED BY A FUNCTION THAT HAS ALREADY LOCKED IT
+   cb_source_t *cbs = (cb_source_t *)src->arg;
 
-   return cb->bufSz * (cb->writeBufferTraversals - cb->readBufferTraversals) + cb->writePtr - cb->readPtr;
+   if (cbs->isPeek)
+   {
+      int bytesSz = maxPackets * TS_SIZE;
+      int numBytes = cb_peek (cbs->cb, cbs->peekBuf, (bytesSz < cbs->peekBufSz) ? bytesSz : cbs->peekBufSz);
+      if (numBytes <= 0)
+      {
+         return (numBytes == -99) ? 0 : numBytes;
+      }
+      if (numBytes % TS_SIZE)
+      {
+         LOG_ERROR_ARGS ("EBPSreamBuffer: cb_source_acquire: incomplete transport packet peeked: %d bytes", numBytes);
+         reportAddErrorLogArgs ("EBPSreamBuffer: cb_source_acquire: incomplete transport packet peeked: %d bytes", numBytes);
+         return -1;
+      }
+
+      int numPackets = numBytes / TS_SIZE;
+      for (int i = 0; i < numPackets; i++)
+      {
+         packets[i] = cbs->peekBuf + i * TS_SIZE;
+      }
+      return numPackets;
+   }
+
+   while (1)
+   {
+      if (cbs->regionPos == cbs->regionSz)
+      {
+         if (cbs->regionSz > 0)
+         {
+            int returnCode = cb_release (cbs->cb, cbs->regionSz);
+            cbs->regionSz = cbs->regionPos = 0;
+            if (returnCode != 0)
+            {
+               return returnCode;
+            }
+         }
+
+         int numBytes = cb_acquire (cbs->cb, maxPackets * TS_SIZE, &(cbs->region));
+         if (numBytes <= 0)
+         {
+            return (numBytes == -99) ? 0 : numBytes;
+         }
+         cbs->regionSz = numBytes;
+      }
+
+      // the buffer and all writes to it are whole TS packets, so no packet straddles the wrap
+      int contiguousSz = 0;
+      uint8_t *ptr = cb_region_ptr (&(cbs->region), cbs->regionPos, &contiguousSz);
+      int numPackets = contiguousSz / TS_SIZE;
+      if (numPackets > 0)
+      {
+         if (numPackets > maxPackets)
+         {
+            numPackets = maxPackets;
+         }
+         for (int i = 0; i < numPackets; i++)
+         {
+            packets[i] = ptr + i * TS_SIZE;
+         }
+         return numPackets;
+      }
+
+      LOG_ERROR_ARGS ("EBPSreamBuffer: cb_source_acquire: bytes read not a multiple of TS packets: %d", contiguousSz);
+      reportAddErrorLogArgs ("EBPSreamBuffer: cb_source_acquire: bytes read not a multiple of TS packets: %d", contiguousSz);
+      cbs->regionPos += contiguousSz;
+   }
 }
 
-int cb_peek_size_internal (circular_buffer_t *cb)
+static void cb_source_release (ts_source_t *src, int numPackets)
 {
-   // WARNING: THIS FUNCTION DOES NOT LOCK THE MUTEX AND SHOULD ONLY
-   // BE CALLED BY A FUNCTION THAT HAS ALREADY LOCKED IT
+   cb_source_t *cbs = (cb_source_t *)src->arg;
+   if (!cbs->isPeek)
+   {
+      cbs->regionPos += numPackets * TS_SIZE;
+   }
+}
 
-   return cb->bufSz * (cb->writeBufferTraversals - cb->peekBufferTraversals) + cb->writePtr - cb->peekPtr;
+static uint64_t cb_source_arrival_time (ts_source_t *src, uint8_t *packet)
+{
+   cb_source_t *cbs = (cb_source_t *)src->arg;
+   return cb_get_arrival_time (cbs->cb, packet);
+}
+
+static int cb_source_free (void *arg)
+{
+   cb_source_t *cbs = (cb_source_t *)arg;
+   if (cbs->regionSz > 0)
+   {
+      cb_release (cbs->cb, cbs->regionSz);
+   }
+   free (cbs->peekBuf);
+   free (cbs);
+   return 0;
 }
 
+ts_source_t *cb_source_new (circular_buffer_t *cb, int isPeek)
+{
+   cb_source_t *cbs = (cb_source_t *)calloc (1, sizeof (cb_source_t));
+   cbs->cb = cb;
+   cbs->isPeek = isPeek;
+   if (isPeek)
+   {
+      cbs->peekBufSz = CB_SOURCE_PEEK_PACKETS * TS_SIZE;
+      cbs->peekBuf = (uint8_t *)malloc (cbs->peekBufSz);
+   }
+
+   ts_source_t *src = ts_source_new (cb_source_acquire, cb_source_release, cbs, cb_source_free);
+   if (!isPeek)
+   {
+      src->arrival_time = cb_source_arrival_time;
+   }
+   return src;
+}
@@ -29,27 +29,92 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define __H_EBP_STREAM_BUFFER_
 
 #include <pthread.h>
+#include <stdint.h>
 
+#include "ts_source.h"
 
+// keeps the writer-owned and reader-owned indices on separate cache lines
+#define CB_CACHE_LINE_SIZE 64
+
+// longest time cb_handle_overflow blocks under CB_OVERFLOW_BLOCK before returning to the writer
+#define CB_BLOCK_TIMEOUT_MSECS 1000
+
+// most bytes cb_acquire hands out at once under CB_OVERFLOW_DROP_OLDEST: half the buffer, in whole packets
+#define CB_DROP_OLDEST_MAX_ACQUIRE(cb) ((((cb)->bufSz / 2) / TS_SIZE) * TS_SIZE)
+
+/**
+ * What the writer does when the buffer is full (see cb_handle_overflow).  Drops are always whole
+ * TS packets.
+ */
+typedef enum
+{
+   CB_OVERFLOW_BLOCK,        // wait for the reader to free space
+   CB_OVERFLOW_DROP_NEWEST,  // discard incoming data until there is space again
+   CB_OVERFLOW_DROP_OLDEST   // make the reader skip the oldest data it has not started on yet
+} cb_overflow_policy_t;
+
+typedef struct
+{
+   uint64_t droppedBytes;        // incoming bytes discarded by the writer
+   uint64_t skippedBytes;        // buffered bytes discarded by the reader (drop-oldest)
+   unsigned int overflowEvents;  // number of times the buffer filled up
+   int highWatermark;            // most bytes ever buffered
+} cb_stats_t;
+
+/**
+ * Single-producer/single-consumer byte ring.  The writer (socket receive thread) and the reader (one
+ * ingest thread at a time: the preread thread peeks, then the stream ingest thread reads) synchronize
+ * only through the atomically published indices.  The mutex and condition variables are used only to
+ * put the reader to sleep on an empty buffer, and the writer on a full one under CB_OVERFLOW_BLOCK.
+ */
 typedef struct 
 {
    uint8_t *buf;
    int bufSz;
-   uint8_t* writePtr;
-   uint8_t* readPtr;
-   uint8_t* peekPtr;
 
-   unsigned int writeBufferTraversals;
-   unsigned int readBufferTraversals;
-   unsigned int peekBufferTraversals;
+   // free-running byte counts: (index % bufSz) is the position in buf
+   volatile uint64_t writeIndex;  // written by the writer only
+   char writeIndexPad[CB_CACHE_LINE_SIZE - sizeof(uint64_t)];
+   volatile uint64_t readIndex;   // written by the reader only
+   volatile uint64_t peekIndex;   // reader only: peeks start here, reset to readIndex by every read
+   volatile uint64_t acquireIndex;  // reader only: end of the span the reader is working on
+   char readIndexPad[CB_CACHE_LINE_SIZE - 3 * sizeof(uint64_t)];
+
+   volatile int readerWaiting;  // reader is asleep (or about to be) on cb_nonempty_cond
+   volatile int writerWaiting;  // writer is asleep (or about to be) on cb_nonfull_cond
 
    pthread_mutex_t mutex;
    pthread_cond_t cb_nonempty_cond;
+   pthread_cond_t cb_nonfull_cond;
+
+   volatile int disabled;
+
+   cb_overflow_policy_t overflowPolicy;
+   volatile uint64_t skipIndex;  // written by the writer only (drop-oldest): the reader discards data before this
+   int overflowing;              // writer only: set from overflow until the next commit
 
-   int disabled;
+   uint64_t droppedBytes;        // writer only
+   uint64_t skippedBytes;        // reader only
+   unsigned int overflowEvents;  // writer only
+   int highWatermark;            // writer only
+
+   // optional (see cb_enable_arrival_times): receive time in ns of each TS packet slot in buf
+   uint64_t *arrivalTimes;
 
 } circular_buffer_t;
 
+/**
+ * A span of the buffer handed out by cb_reserve or cb_acquire: sz1 bytes at ptr1, continuing with
+ * sz2 bytes at ptr2 (the start of the buffer) if the span wraps.
+ */
+typedef struct
+{
+   uint8_t *ptr1;
+   int sz1;
+   uint8_t *ptr2;
+   int sz2;
+} cb_region_t;
+
 int cb_init (circular_buffer_t *cb, int bufferSz);
 void cb_free (circular_buffer_t *cb);
 void cb_empty (circular_buffer_t *cb);
@@ -57,14 +122,68 @@ int cb_disable (circular_buffer_t *cb);
 int cb_is_disabled (circular_buffer_t *cb);
 int cb_get_total_size (circular_buffer_t *cb);
 
+void cb_set_overflow_policy (circular_buffer_t *cb, cb_overflow_policy_t overflowPolicy);
+const char *cb_overflow_policy_name (cb_overflow_policy_t overflowPolicy);
+void cb_get_stats (circular_buffer_t *cb, cb_stats_t *stats);
+
+// copying interface
 int cb_peek (circular_buffer_t *cb, uint8_t* bytes, int bytesSz);
 int cb_read (circular_buffer_t *cb, uint8_t* bytes, int bytesSz);
 int cb_read_or_peek (circular_buffer_t *cb, uint8_t* bytes, int bytesSz, int isPeek);
 int cb_write (circular_buffer_t *cb, uint8_t* bytes, int bytesSz);
 
+/**
+ * Zero-copy write: reserves up to bytesSz bytes of free space, which the writer fills in place and
+ * then publishes (all or a prefix of it) with cb_commit.  Returns the number of bytes reserved,
+ * -99 if the buffer is disabled, or < 0 on error.
+ */
+int cb_reserve (circular_buffer_t *cb, int bytesSz, cb_region_t *region);
+int cb_commit (circular_buffer_t *cb, int bytesSz);
+
+/**
+ * Called by the writer when it cannot reserve the bytesSz it needs.  Applies the overflow policy:
+ * CB_OVERFLOW_BLOCK waits (at most CB_BLOCK_TIMEOUT_MSECS) for the reader to free bytesSz and returns 0
+ * so the writer retries; CB_OVERFLOW_DROP_NEWEST returns 1 so the writer discards its incoming data
+ * (and reports it with cb_count_dropped); CB_OVERFLOW_DROP_OLDEST also tells the reader to skip
+ * bytesSz of the oldest data it has not acquired yet, freeing that space once the reader gets to it,
+ * and returns 1 until then.  Returns -99 if the buffer is disabled.
+ */
+int cb_handle_overflow (circular_buffer_t *cb, int bytesSz);
+void cb_count_dropped (circular_buffer_t *cb, int bytesSz);
+
+/**
+ * Zero-copy read: waits for data and returns up to bytesSz readable bytes in place; they stay valid
+ * until handed back with cb_release.  Returns the number of bytes acquired, -99 if the buffer is
+ * disabled and empty, or < 0 on error.
+ */
+int cb_acquire (circular_buffer_t *cb, int bytesSz, cb_region_t *region);
+int cb_release (circular_buffer_t *cb, int bytesSz);
+
+// address of byte offset within a region; contiguousSz gets the number of bytes up to the wrap or end
+uint8_t *cb_region_ptr (cb_region_t *region, int offset, int *contiguousSz);
+
+/**
+ * Per-packet arrival times.  Buffer and write sizes must be multiples of TS_SIZE.  The writer tags the
+ * packets in [ptr, ptr + bytesSz) of its reserved space before committing them, and the reader looks
+ * up the time of an acquired packet by its address.
+ */
+int cb_enable_arrival_times (circular_buffer_t *cb);
+void cb_set_arrival_time (circular_buffer_t *cb, uint8_t *ptr, int bytesSz, uint64_t arrivalTime);
+uint64_t cb_get_arrival_time (circular_buffer_t *cb, uint8_t *ptr);
+
 int cb_read_size (circular_buffer_t *cb);
 int cb_available_write_size (circular_buffer_t *cb);
 
+// most packets a peeking source hands out at once
+#define CB_SOURCE_PEEK_PACKETS 4096
 
-#endif  // __H_EBP_STREAM_BUFFER_
+/**
+ * The buffer as a packet source for the demuxer.  A reading source parses packets in place and
+ * hands them back to the writer as they are released, with their arrival times.  A peeking source
+ * (for the preread) copies the packets out and leaves the buffer contents for the next reader.
+ * Either way the source ends when the buffer is disabled and empty.
+ */
+ts_source_t *cb_source_new (circular_buffer_t *cb, int isPeek);
 
+
+#endif  // __H_EBP_STREAM_BUFFER_
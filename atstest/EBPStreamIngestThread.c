@@ -67,60 +67,40 @@ void *EBPStreamIngestThreadProc(void *threadParams)
       streamIngestCleanup(ebpStreamIngestThreadParams);
    }
 
-   // Register EBP descriptor parser
-   descriptor_table_entry_t *desc = calloc(1, sizeof(descriptor_table_entry_t));
-   desc->tag = EBP_DESCRIPTOR;
-   desc->free_descriptor = ebp_descriptor_free;
-   desc->print_descriptor = ebp_descriptor_print;
-   desc->read_descriptor = ebp_descriptor_read;
-   if (!register_descriptor(desc))
-   {
-      LOG_ERROR_ARGS("EBPStreamIngestThread %d: FAIL: Could not register EBP descriptor parser",
-         ebpStreamIngestThreadParams->ebpIngestThreadParams->threadNum);
-      reportAddErrorLogArgs("EBPStreamIngestThread %d: FAIL: Could not register EBP descriptor parser",
-         ebpStreamIngestThreadParams->ebpIngestThreadParams->threadNum);
-      ebpStreamIngestThreadParams->ebpIngestThreadParams->ingestPassFail = 0;
-
-      streamIngestCleanup(ebpStreamIngestThreadParams);
-   }
-
    m2s->pat_processor = (pat_processor_t)ingest_pat_processor;
    m2s->arg = ebpStreamIngestThreadParams->ebpIngestThreadParams;
    m2s->arg_destructor = NULL;
 
-   int num_packets = 4096;
-   int num_bytes = 0;
-   int ts_buf_sz = num_packets * TS_SIZE;
-   uint8_t *ts_buf = malloc(num_packets * TS_SIZE);
+   int num_packets = 0;
+   ts_pool_t *ts_pool = ts_pool_new(TS_POOL_DEFAULT_SLAB_SIZE);
+   ts_source_t *source = cb_source_new(ebpStreamIngestThreadParams->cb, 0 /* isPeek */);
 
-   int total_packets = 0;
-
-   while (((num_bytes = cb_read (ebpStreamIngestThreadParams->cb, ts_buf, ts_buf_sz)) > 0))
+   // Packets are parsed in place in the circular buffer.  Anything tslib keeps past
+   // mpeg2ts_stream_read_ts_packet is detached (copied) first, so the bytes can be released right after.
+   uint8_t *packets[TS_SOURCE_MAX_PACKETS];
+   while ((num_packets = ts_source_acquire(source, packets, TS_SOURCE_MAX_PACKETS)) > 0)
    {
-      if (num_bytes % TS_SIZE)
-      {
-         LOG_ERROR_ARGS ("EBPStreamIngestThread %d: FAIL: Bytes read not a multiple of TS packets: %d", 
-            ebpStreamIngestThreadParams->ebpIngestThreadParams->threadNum, num_bytes);
-         reportAddErrorLogArgs ("EBPStreamIngestThread %d: FAIL: Bytes read not a multiple of TS packets: %d", 
-            ebpStreamIngestThreadParams->ebpIngestThreadParams->threadNum, num_bytes);
-      }
-      num_packets = num_bytes / TS_SIZE;
-
- //     LOG_INFO_ARGS ("buf: 0x%x, 0x%x, 0x%x, 0x%x", ts_buf[0], ts_buf[1], ts_buf[2], ts_buf[3]);
       for (int i = 0; i < num_packets; i++)
       {
-         total_packets++;
-//         LOG_INFO_ARGS ("packet #%d, total_packets = %d", i, total_packets);
-         ts_packet_t *ts = ts_new();
-         ts_read(ts, ts_buf + i * TS_SIZE, TS_SIZE);
+         uint8_t *ts_bytes = packets[i];
+         ts_packet_t *ts = ts_pool_get(ts_pool);
+         ts_read_inplace(ts, ts_bytes, TS_SIZE);
+         ts->arrival_time = ts_source_arrival_time(source, ts_bytes);
          int returnCode = mpeg2ts_stream_read_ts_packet(m2s, ts);
          // GORP: error checking here: need to augment mpeg2ts_stream_read_ts_packet's error checking
       }
 
-//      LOG_INFO_ARGS ("total_packets = %d", total_packets);
+      ts_source_release(source, num_packets);
+      updateStreamCCStats(m2s, ebpStreamIngestThreadParams->ebpIngestThreadParams);
    }
+   LOG_INFO_ARGS ("EBPStreamIngestThread %d: total_packets = %"PRIu64, 
+      ebpStreamIngestThreadParams->ebpIngestThreadParams->threadNum, source->packets_read);
 
+   ts_source_free(source);
+
+   // frees queued packets, so must precede the pool
    mpeg2ts_stream_free(m2s);
+   ts_pool_free(ts_pool);
 
    streamIngestCleanup(ebpStreamIngestThreadParams);
 
@@ -138,7 +118,14 @@ void streamIngestCleanup(ebp_stream_ingest_thread_params_t *ebpStreamIngestThrea
    // push a NULL element onto each queue to signal the analysis threads that all data has been processed
    for (int i=0; i<ebpStreamIngestThreadParams->ebpIngestThreadParams->numStreams; i++)
    {
-      returnCode = fifo_push (streamInfos[i]->fifo, element);
+      // the analysis thread needs the NULL to finish, so keep trying past a stall: it ends once the
+      // other inputs end too
+      while ((returnCode = fifo_push (streamInfos[i]->fifo, element)) == FIFO_STALLED)
+      {
+         LOG_WARN_ARGS ("EBPStreamIngestThread %d: fifo %d (PID %d) stalled during cleanup: retrying", 
+            ebpStreamIngestThreadParams->ebpIngestThreadParams->threadNum, 
+            streamInfos[i]->fifo->id, streamInfos[i]->PID);
+      }
       if (returnCode != 0)
       {
          LOG_ERROR_ARGS ("EBPStreamIngestThread %d: FATAL error %d calling fifo_push on fifo %d (PID %d) during cleanup", 
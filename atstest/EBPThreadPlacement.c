@@ -0,0 +1,335 @@
+/*
+Copyright (c) 2015, Cable Television Laboratories, Inc.(“CableLabs”)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of CableLabs nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CABLELABS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "EBPThreadPlacement.h"
+#include "ATSTestReport.h"
+
+// node directories beyond this are not looked for
+#define THREAD_PLACEMENT_MAX_NODES 64
+
+static thread_placement_policy_t g_placementPolicy = THREAD_PLACEMENT_NONE;
+
+// CPUs the process may use (after threadCpuList is applied)
+static cpu_set_t g_allowedCPUs;
+static int g_restrictToAllowed = 0;
+
+// usable CPUs of each NUMA node that has any
+static cpu_set_t *g_nodeCPUSets = NULL;
+static int g_numNodes = 0;
+
+// CPUs in the order threads are placed on them (compact and spread policies)
+static int *g_placementCPUs = NULL;
+static int g_numPlacementCPUs = 0;
+
+static int g_nextSlot = 0;
+
+
+/**
+ * Parses a Linux style CPU list ("0-15,32-47", as in the sysfs cpulist files) into cpuSet.
+ */
+static int parseCPUList(const char *cpuList, cpu_set_t *cpuSet)
+{
+   CPU_ZERO(cpuSet);
+
+   const char *p = cpuList;
+   while (1)
+   {
+      while (isspace((int)*p) || *p == ',')
+      {
+         p++;
+      }
+      if (*p == 0)
+      {
+         break;
+      }
+
+      char *end = NULL;
+      long firstCPU = strtol(p, &end, 10);
+      if (end == p || firstCPU < 0)
+      {
+         return -1;
+      }
+      long lastCPU = firstCPU;
+      p = end;
+
+      if (*p == '-')
+      {
+         p++;
+         lastCPU = strtol(p, &end, 10);
+         if (end == p || lastCPU < firstCPU)
+         {
+            return -1;
+         }
+         p = end;
+      }
+      if (lastCPU >= CPU_SETSIZE)
+      {
+         return -1;
+      }
+      if (*p != 0 && *p != ',' && !isspace((int)*p))
+      {
+         return -1;
+      }
+
+      for (long cpu = firstCPU; cpu <= lastCPU; cpu++)
+      {
+         CPU_SET(cpu, cpuSet);
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * Fills g_nodeCPUSets from /sys/devices/system/node, keeping only allowed CPUs.  Machines without
+ * NUMA information are treated as a single node.
+ */
+static void readNodeCPUSets()
+{
+   g_nodeCPUSets = (cpu_set_t *) calloc (THREAD_PLACEMENT_MAX_NODES, sizeof(cpu_set_t));
+   g_numNodes = 0;
+
+   char path[128];
+   char line[4096];
+   for (int node = 0; node < THREAD_PLACEMENT_MAX_NODES; node++)
+   {
+      snprintf (path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+      FILE *cpuListFile = fopen (path, "rt");
+      if (cpuListFile == NULL)
+      {
+         continue;
+      }
+
+      cpu_set_t nodeCPUs;
+      if (fgets (line, sizeof(line), cpuListFile) != NULL && parseCPUList (line, &nodeCPUs) == 0)
+      {
+         CPU_AND (&nodeCPUs, &nodeCPUs, &g_allowedCPUs);
+         if (CPU_COUNT (&nodeCPUs) > 0)
+         {
+            g_nodeCPUSets[g_numNodes++] = nodeCPUs;
+         }
+      }
+      fclose (cpuListFile);
+   }
+
+   if (g_numNodes == 0)
+   {
+      g_nodeCPUSets[0] = g_allowedCPUs;
+      g_numNodes = 1;
+   }
+}
+
+/**
+ * Orders the usable CPUs for the compact (node by node) or spread (alternating nodes) policies.
+ */
+static void buildPlacementCPUs(thread_placement_policy_t policy)
+{
+   g_placementCPUs = (int *) calloc (CPU_COUNT (&g_allowedCPUs), sizeof(int));
+   g_numPlacementCPUs = 0;
+
+   if (policy == THREAD_PLACEMENT_COMPACT)
+   {
+      for (int node = 0; node < g_numNodes; node++)
+      {
+         for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+         {
+            if (CPU_ISSET (cpu, &(g_nodeCPUSets[node])))
+            {
+               g_placementCPUs[g_numPlacementCPUs++] = cpu;
+            }
+         }
+      }
+   }
+   else
+   {
+      // take the next unused CPU of each node in turn
+      int *nextCPU = (int *) calloc (g_numNodes, sizeof(int));
+      int added = 1;
+      while (added)
+      {
+         added = 0;
+         for (int node = 0; node < g_numNodes; node++)
+         {
+            while (nextCPU[node] < CPU_SETSIZE && !CPU_ISSET (nextCPU[node], &(g_nodeCPUSets[node])))
+            {
+               nextCPU[node]++;
+            }
+            if (nextCPU[node] < CPU_SETSIZE)
+            {
+               g_placementCPUs[g_numPlacementCPUs++] = nextCPU[node]++;
+               added = 1;
+            }
+         }
+      }
+      free (nextCPU);
+   }
+}
+
+int threadPlacementInit(thread_placement_policy_t policy, const char *cpuList)
+{
+   g_placementPolicy = THREAD_PLACEMENT_NONE;
+   g_restrictToAllowed = 0;
+   g_nextSlot = 0;
+
+   int hasCPUList = (cpuList != NULL && cpuList[0] != 0);
+   if (policy == THREAD_PLACEMENT_NONE && !hasCPUList)
+   {
+      return 0;
+   }
+
+   if (sched_getaffinity (0, sizeof(cpu_set_t), &g_allowedCPUs) != 0)
+   {
+      LOG_ERROR("EBPThreadPlacement: FAIL: Error reading process CPU affinity: thread placement disabled");
+      reportAddErrorLog("EBPThreadPlacement: FAIL: Error reading process CPU affinity: thread placement disabled");
+      return -1;
+   }
+
+   if (hasCPUList)
+   {
+      cpu_set_t listCPUs;
+      if (parseCPUList (cpuList, &listCPUs) != 0)
+      {
+         LOG_ERROR_ARGS("EBPThreadPlacement: FAIL: Invalid threadCpuList %s: thread placement disabled", cpuList);
+         reportAddErrorLogArgs("EBPThreadPlacement: FAIL: Invalid threadCpuList %s: thread placement disabled", cpuList);
+         return -1;
+      }
+
+      CPU_AND (&g_allowedCPUs, &g_allowedCPUs, &listCPUs);
+      if (CPU_COUNT (&g_allowedCPUs) == 0)
+      {
+         LOG_ERROR_ARGS("EBPThreadPlacement: FAIL: threadCpuList %s contains no usable CPUs: thread placement disabled", cpuList);
+         reportAddErrorLogArgs("EBPThreadPlacement: FAIL: threadCpuList %s contains no usable CPUs: thread placement disabled", cpuList);
+         return -1;
+      }
+      g_restrictToAllowed = 1;
+   }
+
+   readNodeCPUSets();
+   if (policy == THREAD_PLACEMENT_COMPACT || policy == THREAD_PLACEMENT_SPREAD)
+   {
+      buildPlacementCPUs(policy);
+   }
+   g_placementPolicy = policy;
+
+   LOG_INFO_ARGS("EBPThreadPlacement: policy %s, %d CPUs on %d NUMA nodes", 
+      threadPlacementPolicyName (policy), CPU_COUNT (&g_allowedCPUs), g_numNodes);
+
+   return 0;
+}
+
+int threadPlacementSetAttr(pthread_attr_t *threadAttr)
+{
+   cpu_set_t threadCPUs;
+   int slot = g_nextSlot++;
+
+   switch (g_placementPolicy)
+   {
+      case THREAD_PLACEMENT_COMPACT:
+      case THREAD_PLACEMENT_SPREAD:
+         CPU_ZERO (&threadCPUs);
+         CPU_SET (g_placementCPUs[slot % g_numPlacementCPUs], &threadCPUs);
+         LOG_INFO_ARGS("EBPThreadPlacement: thread slot %d placed on CPU %d", 
+            slot, g_placementCPUs[slot % g_numPlacementCPUs]);
+         break;
+
+      case THREAD_PLACEMENT_NODE:
+         threadCPUs = g_nodeCPUSets[slot % g_numNodes];
+         LOG_INFO_ARGS("EBPThreadPlacement: thread slot %d placed on NUMA node index %d", 
+            slot, slot % g_numNodes);
+         break;
+
+      default:
+         if (!g_restrictToAllowed)
+         {
+            return 0;
+         }
+         threadCPUs = g_allowedCPUs;
+         break;
+   }
+
+   int returnCode = pthread_attr_setaffinity_np (threadAttr, sizeof(cpu_set_t), &threadCPUs);
+   if (returnCode != 0)
+   {
+      LOG_ERROR_ARGS("EBPThreadPlacement: FAIL: error %d setting affinity for thread slot %d", returnCode, slot);
+      reportAddErrorLogArgs("EBPThreadPlacement: FAIL: error %d setting affinity for thread slot %d", returnCode, slot);
+      return -1;
+   }
+
+   return 0;
+}
+
+void threadPlacementCleanup()
+{
+   free (g_nodeCPUSets);
+   g_nodeCPUSets = NULL;
+   g_numNodes = 0;
+
+   free (g_placementCPUs);
+   g_placementCPUs = NULL;
+   g_numPlacementCPUs = 0;
+
+   g_placementPolicy = THREAD_PLACEMENT_NONE;
+   g_restrictToAllowed = 0;
+}
+
+int threadPlacementPolicyFromName(const char *name)
+{
+   for (int policy = THREAD_PLACEMENT_NONE; policy <= THREAD_PLACEMENT_NODE; policy++)
+   {
+      if (strcmp (name, threadPlacementPolicyName (policy)) == 0)
+      {
+         return policy;
+      }
+   }
+
+   return -1;
+}
+
+const char *threadPlacementPolicyName(thread_placement_policy_t policy)
+{
+   switch (policy)
+   {
+      case THREAD_PLACEMENT_NONE:
+         return "none";
+      case THREAD_PLACEMENT_COMPACT:
+         return "compact";
+      case THREAD_PLACEMENT_SPREAD:
+         return "spread";
+      case THREAD_PLACEMENT_NODE:
+         return "node";
+      default:
+         return "unknown";
+   }
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2015, Cable Television Laboratories, Inc.(“CableLabs”)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of CableLabs nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CABLELABS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __H_EBP_THREAD_PLACEMENT
+#define __H_EBP_THREAD_PLACEMENT
+
+#include <pthread.h>
+
+// Where each created thread is allowed to run (threadPlacement in ATSTestApp.props)
+typedef enum
+{
+   THREAD_PLACEMENT_NONE,     // leave placement to the scheduler
+   THREAD_PLACEMENT_COMPACT,  // one CPU per thread, filling a NUMA node before moving to the next
+   THREAD_PLACEMENT_SPREAD,   // one CPU per thread, alternating NUMA nodes
+   THREAD_PLACEMENT_NODE      // all CPUs of one NUMA node per thread, nodes assigned round-robin
+
+} thread_placement_policy_t;
+
+
+/**
+ * Builds the CPU ordering used by threadPlacementSetAttr from the process affinity mask, the NUMA
+ * topology in /sys/devices/system/node and, if cpuList is non-empty, a CPU list such as "0-15,32-47"
+ * restricting the CPUs used.  Falls back to THREAD_PLACEMENT_NONE on error.  Main thread only.
+ */
+int threadPlacementInit(thread_placement_policy_t policy, const char *cpuList);
+
+/**
+ * Sets the affinity of threadAttr for the next thread to be created.  Each call takes the next
+ * placement slot, so this must be called once per pthread_create.  Main thread only.
+ */
+int threadPlacementSetAttr(pthread_attr_t *threadAttr);
+
+void threadPlacementCleanup();
+
+int threadPlacementPolicyFromName(const char *name);
+const char *threadPlacementPolicyName(thread_placement_policy_t policy);
+
+#endif  // __H_EBP_THREAD_PLACEMENT
@@ -28,15 +28,42 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 
 #include "ThreadSafeFIFO.h"
 #include "EBPThreadLogging.h"
 
+// head and tail are free-running counters: (tail - head) is the number of queued elements and
+// (index & mask) is the slot.  Each index is written by one thread only.  Publishing an index is
+// sequentially consistent (rather than just release) so that it is ordered against the following
+// check of the other side's waiting flag -- see fifo_sleep.
+#define FIFO_LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define FIFO_PUBLISH(p, v)        __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
 
 int fifo_create (thread_safe_fifo_t *fifo, int id)
 {
    fifo->id = id;
 
+   fifo->capacity = FIFO_DEFAULT_CAPACITY;
+   fifo->mask = fifo->capacity - 1;
+   fifo->credits = fifo->capacity;
+   fifo->head = 0;
+   fifo->tail = 0;
+   fifo->consumer_waiting = 0;
+   fifo->producer_waiting = 0;
+   fifo->overdraw = 0;
+   fifo->push_counter = 0;
+   fifo->pop_counter = 0;
+
+   fifo->ring = (void **)calloc(fifo->capacity, sizeof(void *));
+   if (fifo->ring == NULL)
+   {
+      printThreadDebugMessage ("fifo_create (%d): Error allocating %u slots\n", fifo->id, fifo->capacity);
+      return -1;
+   }
+
    int returnCode = pthread_mutex_init(&(fifo->fifo_mutex), NULL);
    if (returnCode != 0)
    {
@@ -51,7 +78,12 @@ int fifo_create (thread_safe_fifo_t *fifo, int id)
       return -1;
    }
 
-   fifo->queue = varray_new();
+   returnCode = pthread_cond_init(&(fifo->fifo_nonfull_cond), NULL);
+   if (returnCode != 0)
+   {
+      printThreadDebugMessage ("fifo_create (%d): Error %d calling pthread_cond_init\n", fifo->id, returnCode);
+      return -1;
+   }
 
    return 0;
 }
@@ -70,54 +102,221 @@ int fifo_destroy (thread_safe_fifo_t *fifo)
       printThreadDebugMessage ("fifo_destroy (%d): Error %d calling pthread_cond_destroy\n", fifo->id, returnCode);
    }
 
-   varray_free(fifo->queue);
+   returnCode = pthread_cond_destroy(&(fifo->fifo_nonfull_cond));
+   if (returnCode != 0)
+   {
+      printThreadDebugMessage ("fifo_destroy (%d): Error %d calling pthread_cond_destroy\n", fifo->id, returnCode);
+   }
+
+   free(fifo->ring);
+   fifo->ring = NULL;
 
    return 0;
 }
 
-int fifo_push (thread_safe_fifo_t *fifo, void *element)
+/**
+ * Slow path shared by producer and consumer: sleeps on cond until ready() reports a nonzero count.
+ * The waiting flag is raised before the final check (both sequentially consistent), and the other side
+ * raises its index before checking the flag, so either we see the new index or it sees our flag and
+ * signals -- under the mutex, which we hold until pthread_cond_wait releases it.
+ *
+ * If stall is non-NULL, the sleep gives up with FIFO_STALLED once *stall has been set, and ready()
+ * has reported 0, for FIFO_STALL_USECS.
+ */
+static int fifo_sleep (thread_safe_fifo_t *fifo, volatile int *waiting, pthread_cond_t *cond,
+                       unsigned int (*ready)(thread_safe_fifo_t *), unsigned int *count, volatile int *stall)
 {
-   int returnCode = 0;
-   printThreadDebugMessage ("fifo_push (%d): entering...\n", fifo->id);
-
-   printThreadDebugMessage ("fifo_push (%d): calling pthread_mutex_lock\n", fifo->id);
-   returnCode = pthread_mutex_lock (&(fifo->fifo_mutex));
+   int returnCode = pthread_mutex_lock (&(fifo->fifo_mutex));
    if (returnCode != 0)
    {
-      printThreadDebugMessage ("fifo_push (%d): error %d calling pthread_mutex_lock\n", fifo->id, returnCode);
+      printThreadDebugMessage ("fifo_sleep (%d): error %d calling pthread_mutex_lock\n", fifo->id, returnCode);
       return -1;
    }
 
+   struct timespec deadline;
+   int deadlineSet = 0;
+   int timedOut = 0;
+   int result = 0;
+   while (1)
+   {
+      __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+      *count = ready(fifo);
+      if (*count != 0)
+      {
+         break;
+      }
 
-   printThreadDebugMessage ("fifo_push (%d): doing push\n", fifo->id);
+      if (stall != NULL && __atomic_load_n(stall, __ATOMIC_SEQ_CST))
+      {
+         if (timedOut)
+         {
+            result = FIFO_STALLED;
+            break;
+         }
+
+         if (!deadlineSet)
+         {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += FIFO_STALL_USECS / 1000000;
+            deadline.tv_nsec += (FIFO_STALL_USECS % 1000000) * 1000;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+               deadline.tv_sec++;
+               deadline.tv_nsec -= 1000000000;
+            }
+            deadlineSet = 1;
+         }
+
+         returnCode = pthread_cond_timedwait(cond, &(fifo->fifo_mutex), &deadline);
+         if (returnCode == ETIMEDOUT)
+         {
+            // check again before giving up: the stall may have just ended
+            timedOut = 1;
+            returnCode = 0;
+         }
+      }
+      else
+      {
+         deadlineSet = 0;
+         timedOut = 0;
+         returnCode = pthread_cond_wait(cond, &(fifo->fifo_mutex));
+      }
 
-   // do push onto queue here
-   varray_insert(fifo->queue, 0, element);
+      if (returnCode != 0)
+      {
+         printThreadDebugMessage ("fifo_sleep (%d): error %d calling pthread_cond_wait\n", fifo->id, returnCode);
+         __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+         pthread_mutex_unlock (&(fifo->fifo_mutex));
+         return -1;
+      }
+   }
+   __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
 
-   fifo->push_counter++;
-   
-   printThreadDebugMessage ("fifo_push (%d): doing push: fifo->value = %p\n", fifo->id, element);
+   returnCode = pthread_mutex_unlock (&(fifo->fifo_mutex));
+   if (returnCode != 0)
+   {
+      printThreadDebugMessage ("fifo_sleep (%d): error %d calling pthread_mutex_unlock\n", fifo->id, returnCode);
+      return -1;
+   }
 
+   return result;
+}
 
-   printThreadDebugMessage ("fifo_push (%d): calling pthread_cond_signal\n", fifo->id);
-   returnCode = pthread_cond_signal(&(fifo->fifo_nonempty_cond));
+/**
+ * Called after publishing a new head or tail: signals the other side only if it is asleep, i.e. only
+ * on an empty->non-empty (or full->non-full) transition it is actually waiting for.
+ */
+static int fifo_wake (thread_safe_fifo_t *fifo, volatile int *waiting, pthread_cond_t *cond)
+{
+   if (!__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+   {
+      return 0;
+   }
+
+   int returnCode = pthread_mutex_lock (&(fifo->fifo_mutex));
    if (returnCode != 0)
    {
-      printThreadDebugMessage ("fifo_push (%d): error %d calling pthread_cond_signal\n", fifo->id, returnCode);
-      // unlock mutex before returning
+      printThreadDebugMessage ("fifo_wake (%d): error %d calling pthread_mutex_lock\n", fifo->id, returnCode);
+      return -1;
+   }
+
+   returnCode = pthread_cond_signal(cond);
+   if (returnCode != 0)
+   {
+      printThreadDebugMessage ("fifo_wake (%d): error %d calling pthread_cond_signal\n", fifo->id, returnCode);
       pthread_mutex_unlock (&(fifo->fifo_mutex));
-      return -1;  
+      return -1;
    }
 
-   printThreadDebugMessage ("fifo_push (%d): calling pthread_mutex_unlock\n", fifo->id);
    returnCode = pthread_mutex_unlock (&(fifo->fifo_mutex));
    if (returnCode != 0)
    {
-      printThreadDebugMessage ("fifo_push (%d): error %d calling pthread_mutex_unlock\n", fifo->id, returnCode);
+      printThreadDebugMessage ("fifo_wake (%d): error %d calling pthread_mutex_unlock\n", fifo->id, returnCode);
       return -1;
    }
 
-   printThreadDebugMessage ("fifo_push (%d): exiting\n", fifo->id);
+   return 0;
+}
+
+// number of queued elements, as seen by the consumer
+static unsigned int fifo_available (thread_safe_fifo_t *fifo)
+{
+   return __atomic_load_n(&(fifo->tail), __ATOMIC_SEQ_CST) - fifo->head;
+}
+
+// number of free slots, as seen by the producer; after an overdraw ends, more than credits elements
+// may still be queued
+static unsigned int fifo_free_space (thread_safe_fifo_t *fifo)
+{
+   unsigned int limit = __atomic_load_n(&(fifo->overdraw), __ATOMIC_SEQ_CST) ? fifo->capacity : fifo->credits;
+   unsigned int queued = fifo->tail - __atomic_load_n(&(fifo->head), __ATOMIC_SEQ_CST);
+   return (queued < limit) ? limit - queued : 0;
+}
+
+static int fifo_wait_nonempty (thread_safe_fifo_t *fifo, unsigned int *available)
+{
+   *available = FIFO_LOAD_ACQUIRE(&(fifo->tail)) - fifo->head;
+   if (*available != 0)
+   {
+      return 0;
+   }
+
+   return fifo_sleep (fifo, &(fifo->consumer_waiting), &(fifo->fifo_nonempty_cond), fifo_available, available, NULL);
+}
+
+static int fifo_wait_nonfull (thread_safe_fifo_t *fifo, unsigned int *space)
+{
+   *space = fifo_free_space (fifo);
+   if (*space != 0)
+   {
+      return 0;
+   }
+
+   return fifo_sleep (fifo, &(fifo->producer_waiting), &(fifo->fifo_nonfull_cond), fifo_free_space, space,
+                      &(fifo->overdraw));
+}
+
+int fifo_push (thread_safe_fifo_t *fifo, void *element)
+{
+   return fifo_push_batch (fifo, &element, 1);
+}
+
+int fifo_push_batch (thread_safe_fifo_t *fifo, void **elements, int num_elements)
+{
+   unsigned int tail = fifo->tail;
+   int pushed = 0;
+
+   while (pushed < num_elements)
+   {
+      unsigned int space = 0;
+      int returnCode = fifo_wait_nonfull (fifo, &space);
+      if (returnCode != 0)
+      {
+         return returnCode;
+      }
+
+      unsigned int count = num_elements - pushed;
+      if (count > space)
+      {
+         count = space;
+      }
+
+      for (unsigned int i = 0; i < count; i++)
+      {
+         fifo->ring[(tail + i) & fifo->mask] = elements[pushed + i];
+      }
+      tail += count;
+      pushed += count;
+
+      FIFO_PUBLISH(&(fifo->tail), tail);
+      fifo->push_counter += count;
+
+      if (fifo_wake (fifo, &(fifo->consumer_waiting), &(fifo->fifo_nonempty_cond)) != 0)
+      {
+         return -1;
+      }
+   }
+
    return 0;
 }
 
@@ -131,87 +330,123 @@ int fifo_peek (thread_safe_fifo_t *fifo, void **element)
    return fifo_pop_peek (fifo, element, 0 /* isPop */);
 }
 
-int fifo_pop_peek (thread_safe_fifo_t *fifo, void **element, int isPop)
+int fifo_pop_batch (thread_safe_fifo_t *fifo, void **elements, int max_elements, int *num_elements)
 {
-   int returnCode = 0;
-
-   printThreadDebugMessage ("fifo_pop_peek (%d): entering...\n", fifo->id);
+   *num_elements = 0;
+   if (max_elements <= 0)
+   {
+      return 0;
+   }
 
-   returnCode = pthread_mutex_lock (&(fifo->fifo_mutex));
-   if (returnCode != 0)
+   unsigned int available = 0;
+   if (fifo_wait_nonempty (fifo, &available) != 0)
    {
-      printThreadDebugMessage ("fifo_pop_peek (%d): error %d calling pthread_mutex_lock\n", fifo->id, returnCode);
       return -1;
    }
 
-   printThreadDebugMessage ("fifo_pop_peek (%d): doing pop\n", fifo->id);
-
-   // check queue not empty here
-   if (varray_length(fifo->queue) != 0)
+   unsigned int head = fifo->head;
+   unsigned int count = (available < (unsigned int)max_elements) ? available : (unsigned int)max_elements;
+   for (unsigned int i = 0; i < count; i++)
    {
-      printThreadDebugMessage ("fifo_pop_peek (%d): queue not empty -- fifo_pop setting element\n", fifo->id);
+      elements[i] = fifo->ring[(head + i) & fifo->mask];
    }
-   else
+
+   FIFO_PUBLISH(&(fifo->head), head + count);
+   fifo->pop_counter += count;
+   *num_elements = count;
+
+   return fifo_wake (fifo, &(fifo->producer_waiting), &(fifo->fifo_nonfull_cond));
+}
+
+int fifo_pop_peek_group (thread_safe_fifo_t **fifos, int num_fifos, int index, void **element, int isPop)
+{
+   thread_safe_fifo_t *fifo = fifos[index];
+   int isEmpty = (FIFO_LOAD_ACQUIRE(&(fifo->tail)) == fifo->head);
+   if (isEmpty)
    {
-      printThreadDebugMessage ("fifo_pop_peek (%d): queue empty -- pop entering wait\n", fifo->id);
-      returnCode = pthread_cond_wait(&(fifo->fifo_nonempty_cond), &(fifo->fifo_mutex));
-      if (returnCode != 0)
+      for (int i = 0; i < num_fifos; i++)
       {
-         printThreadDebugMessage ("fifo_pop_peek (%d): error %d calling pthread_cond_signal\n", fifo->id, returnCode);
-         // unlock mutex before returning
-         pthread_mutex_unlock (&(fifo->fifo_mutex));
-         return -1;
+         if (i != index && fifos[i] != NULL && fifo_set_overdraw (fifos[i], 1) != 0)
+         {
+            return -1;
+         }
       }
-
    }
 
-   if (isPop)
+   int returnCode = fifo_pop_peek (fifo, element, isPop);
+
+   if (isEmpty)
    {
-      printThreadDebugMessage ("fifo_pop_peek (%d): calling varray_pop\n", fifo->id);
-      *element = varray_pop(fifo->queue);
-      fifo->pop_counter++;
+      for (int i = 0; i < num_fifos; i++)
+      {
+         if (i != index && fifos[i] != NULL)
+         {
+            fifo_set_overdraw (fifos[i], 0);
+         }
+      }
    }
-   else
+
+   return returnCode;
+}
+
+int fifo_pop_peek (thread_safe_fifo_t *fifo, void **element, int isPop)
+{
+   if (isPop)
    {
-      printThreadDebugMessage ("fifo_pop_peek (%d): calling varray_peek\n", fifo->id);
-      *element = varray_peek(fifo->queue);
+      int num_elements = 0;
+      return fifo_pop_batch (fifo, element, 1, &num_elements);
    }
 
-   printThreadDebugMessage ("fifo_pop_peek (%d): setting element: *element = %p\n", fifo->id, *element);
-
-   printThreadDebugMessage ("fifo_pop_peek (%d): calling pthread_mutex_unlock\n", fifo->id);
-   returnCode = pthread_mutex_unlock (&(fifo->fifo_mutex));
-   if (returnCode != 0)
+   unsigned int available = 0;
+   if (fifo_wait_nonempty (fifo, &available) != 0)
    {
-      printThreadDebugMessage ("fifo_pop_peek (%d): Error %d calling pthread_mutex_unlock\n", fifo->id, returnCode);
       return -1;
    }
 
-   printThreadDebugMessage ("fifo_pop_peek (%d): exiting\n", fifo->id);
+   *element = fifo->ring[fifo->head & fifo->mask];
    return 0;
 }
 
 int fifo_get_state (thread_safe_fifo_t *fifo, int *size)
 {
-   int returnCode = 0;
-   printThreadDebugMessage ("fifo_get_state (%d): entering\n", fifo->id);
+   // may be called from any thread, so this is only a snapshot
+   unsigned int head = FIFO_LOAD_ACQUIRE(&(fifo->head));
+   unsigned int tail = FIFO_LOAD_ACQUIRE(&(fifo->tail));
+   *size = (int)(tail - head);
 
-   returnCode = pthread_mutex_lock (&(fifo->fifo_mutex));
-   if (returnCode != 0)
+   return 0;
+}
+
+int fifo_set_credits (thread_safe_fifo_t *fifo, unsigned int credits)
+{
+   if (credits == 0 || credits > fifo->capacity)
    {
-      printThreadDebugMessage ("fifo_get_state (%d): Error %d calling pthread_mutex_lock\n", fifo->id, returnCode);
+      printThreadDebugMessage ("fifo_set_credits (%d): %u credits out of range 1..%u\n", fifo->id, credits, fifo->capacity);
       return -1;
    }
 
-   *size = varray_length(fifo->queue);
+   fifo->credits = credits;
+   return 0;
+}
 
-   returnCode = pthread_mutex_unlock (&(fifo->fifo_mutex));
-   if (returnCode != 0)
+int fifo_set_overdraw (thread_safe_fifo_t *fifo, int overdraw)
+{
+   // ordered against the producer's waiting flag like a pop: see fifo_sleep
+   __atomic_store_n(&(fifo->overdraw), overdraw, __ATOMIC_SEQ_CST);
+   if (!overdraw)
    {
-      printThreadDebugMessage ("fifo_get_state (%d): Error %d calling pthread_mutex_unlock\n", fifo->id, returnCode);
-      return -1;
+      return 0;
    }
 
-   return 0;
+   return fifo_wake (fifo, &(fifo->producer_waiting), &(fifo->fifo_nonfull_cond));
 }
 
+int fifo_get_free_space (thread_safe_fifo_t *fifo, int *space)
+{
+   unsigned int head = FIFO_LOAD_ACQUIRE(&(fifo->head));
+   unsigned int tail = FIFO_LOAD_ACQUIRE(&(fifo->tail));
+   unsigned int limit = __atomic_load_n(&(fifo->overdraw), __ATOMIC_SEQ_CST) ? fifo->capacity : fifo->credits;
+   *space = (tail - head < limit) ? (int)(limit - (tail - head)) : 0;
+
+   return 0;
+}
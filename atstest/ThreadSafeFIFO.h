@@ -31,14 +31,52 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pthread.h>
 #include "varray.h"
 
+// Number of slots allocated by fifo_create; must be a power of 2.  A full fifo blocks the producer
+// until the consumer catches up.
+#define FIFO_DEFAULT_CAPACITY 4096
+
+// How long a producer waits on a fifo that is full up to its capacity while overdraw is set (see
+// fifo_set_overdraw) before the push gives up with FIFO_STALLED
+#ifndef FIFO_STALL_USECS
+#define FIFO_STALL_USECS 10000000
+#endif
+
+// fifo_push and fifo_push_batch return code when the producer gave up after FIFO_STALL_USECS
+#define FIFO_STALLED 1
+
+// Keeps the producer-owned and consumer-owned indices on separate cache lines
+#define FIFO_CACHE_LINE_SIZE 64
+
+/**
+ * Bounded single-producer/single-consumer fifo of void* (NULL is a legal element and is used as an
+ * end-of-stream sentinel).  The producer and consumer only synchronize through the head/tail indices;
+ * fifo_mutex and the condition variables are used only to sleep on an empty (consumer) or full
+ * (producer) fifo, and are only signaled when the other side is actually asleep.
+ */
 typedef struct
 {
    int id;  // ID to uniquely tag this fifo
 
-   varray_t* queue;
+   void **ring;
+   unsigned int capacity;  // power of 2
+   unsigned int mask;      // capacity - 1
+   unsigned int credits;   // most elements the producer may have queued (<= capacity); each pop returns one
+
+   // written by the producer only: total number of elements pushed
+   volatile unsigned int tail;
+   char tail_pad[FIFO_CACHE_LINE_SIZE - sizeof(unsigned int)];
+
+   // written by the consumer only: total number of elements popped
+   volatile unsigned int head;
+   char head_pad[FIFO_CACHE_LINE_SIZE - sizeof(unsigned int)];
+
+   volatile int consumer_waiting;  // consumer is asleep (or about to be) on fifo_nonempty_cond
+   volatile int producer_waiting;  // producer is asleep (or about to be) on fifo_nonfull_cond
+   volatile int overdraw;  // producer may queue up to capacity rather than credits
 
    pthread_mutex_t fifo_mutex;
    pthread_cond_t fifo_nonempty_cond;
+   pthread_cond_t fifo_nonfull_cond;
 
    int push_counter;
    int pop_counter;
@@ -53,6 +91,45 @@ int fifo_pop (thread_safe_fifo_t *fifo, void **element);
 int fifo_peek (thread_safe_fifo_t *fifo, void **element);
 int fifo_get_state (thread_safe_fifo_t *fifo, int *size);
 
+/**
+ * Limits the number of queued elements to credits (at most the capacity), so that the producer
+ * blocks once it is that far ahead of the consumer.  Call before the fifo is in use.
+ */
+int fifo_set_credits (thread_safe_fifo_t *fifo, unsigned int credits);
+
+/**
+ * While overdraw is set, lets the producer queue past its credits, up to the capacity, and wakes it if
+ * it is waiting for credits.  Used by a consumer that is about to wait on another of its fifos.
+ */
+int fifo_set_overdraw (thread_safe_fifo_t *fifo, int overdraw);
+
+/**
+ * Snapshot of the number of elements that can be pushed without blocking.  Exact when called by
+ * the producer, since the consumer only adds space.
+ */
+int fifo_get_free_space (thread_safe_fifo_t *fifo, int *space);
+
+/**
+ * Pushes num_elements elements, publishing them to the consumer in as few index updates as the free
+ * space allows.  Blocks while the fifo is full; returns FIFO_STALLED if it stays full up to its
+ * capacity for FIFO_STALL_USECS while overdraw is set.  Producer thread only.
+ */
+int fifo_push_batch (thread_safe_fifo_t *fifo, void **elements, int num_elements);
+
+/**
+ * Pops up to max_elements elements into elements, blocking until at least one is available.
+ * The number of elements popped is returned in num_elements.  Consumer thread only.
+ */
+int fifo_pop_batch (thread_safe_fifo_t *fifo, void **elements, int max_elements, int *num_elements);
+
+/**
+ * Pops (or peeks, if isPop is 0) fifos[index], one of num_fifos fifos (NULL entries are skipped) that
+ * the calling consumer drains in turn.  While it waits on an empty fifos[index], the other fifos may
+ * overdraw: their producers may be stuck on a full fifo of the group until fifos[index]'s producer,
+ * which may in turn be waiting on them elsewhere, makes progress.
+ */
+int fifo_pop_peek_group (thread_safe_fifo_t **fifos, int num_fifos, int index, void **element, int isPop);
+
 // intternal methods
 int fifo_pop_peek (thread_safe_fifo_t *fifo, void **element, int isPop);
 
@@ -0,0 +1,237 @@
+/*
+Copyright (c) 2015, Cable Television Laboratories, Inc.(“CableLabs”)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of CableLabs nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL CABLELABS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Test of the fifos between file ingest and analysis threads for two files, where one file has no
+ * boundaries on one stream.  Each file posts to its own fifo per stream, with limited credits, and
+ * each stream's analysis thread pops the two files' fifos in turn.  The file with boundaries on
+ * both streams runs past its credits on the stream the other file is silent on, while the analysis
+ * thread waits on the silent file -- see fifo_pop_peek_group.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ThreadSafeFIFO.h"
+#include "test_macros.h"
+
+#define NUM_FILES 2
+#define NUM_STREAMS 2
+#define TEST_CREDITS 256
+
+// longer than FIFO_STALL_USECS, which the Makefile shortens for this test
+#define TEST_JOIN_SECS 20
+
+typedef struct
+{
+   thread_safe_fifo_t *fifos[NUM_STREAMS];
+   int hasBoundaries[NUM_STREAMS];
+   int numBoundaries;
+   int returnCode;
+} test_file_t;
+
+typedef struct
+{
+   thread_safe_fifo_t *fifos[NUM_FILES];
+   int numPopped;
+} test_stream_t;
+
+static int g_boundary;  // every posted boundary points here
+
+static void *testFileProc(void *arg)
+{
+   test_file_t *file = (test_file_t *)arg;
+
+   for (int n=0; n<file->numBoundaries; n++)
+   {
+      for (int s=0; s<NUM_STREAMS; s++)
+      {
+         if (file->hasBoundaries[s] && (file->returnCode = fifo_push (file->fifos[s], &g_boundary)) != 0)
+         {
+            return NULL;
+         }
+      }
+   }
+
+   // end of stream
+   for (int s=0; s<NUM_STREAMS; s++)
+   {
+      if ((file->returnCode = fifo_push (file->fifos[s], NULL)) != 0)
+      {
+         return NULL;
+      }
+   }
+
+   return NULL;
+}
+
+// pops each file's fifo in turn, like EBPSegmentAnalysisThreadProc
+static void *testStreamProc(void *arg)
+{
+   test_stream_t *stream = (test_stream_t *)arg;
+   int active[NUM_FILES] = { 1, 1 };
+
+   while (active[0] || active[1])
+   {
+      for (int f=0; f<NUM_FILES; f++)
+      {
+         void *element = NULL;
+         if (!active[f])
+         {
+            continue;
+         }
+         if (fifo_pop_peek_group (stream->fifos, NUM_FILES, f, &element, 1 /* isPop */) != 0)
+         {
+            return NULL;
+         }
+
+         if (element == NULL)
+         {
+            active[f] = 0;
+         }
+         else
+         {
+            stream->numPopped++;
+         }
+      }
+   }
+
+   return NULL;
+}
+
+static int joinWithTimeout(pthread_t thread)
+{
+   struct timespec deadline;
+   clock_gettime(CLOCK_REALTIME, &deadline);
+   deadline.tv_sec += TEST_JOIN_SECS;
+   return pthread_timedjoin_np(thread, NULL, &deadline);
+}
+
+// file 1 posts no boundaries on stream 0; file 0 posts numBoundaries on both streams.  The fifos are
+// returned, indexed by file and stream; they are not reused, since a failed test leaves threads on them.
+static thread_safe_fifo_t *startTest(int numBoundaries, test_file_t *files, test_stream_t *streams,
+                                     pthread_t *fileThreads, pthread_t *streamThreads)
+{
+   thread_safe_fifo_t *fifos = (thread_safe_fifo_t *)calloc (NUM_FILES * NUM_STREAMS, sizeof(thread_safe_fifo_t));
+
+   for (int f=0; f<NUM_FILES; f++)
+   {
+      for (int s=0; s<NUM_STREAMS; s++)
+      {
+         thread_safe_fifo_t *fifo = &fifos[f * NUM_STREAMS + s];
+         fifo_create (fifo, f * NUM_STREAMS + s);
+         fifo_set_credits (fifo, TEST_CREDITS);
+         files[f].fifos[s] = fifo;
+         files[f].hasBoundaries[s] = (f == 0 || s != 0);
+         streams[s].fifos[f] = fifo;
+         streams[s].numPopped = 0;
+      }
+      files[f].numBoundaries = numBoundaries;
+      files[f].returnCode = 0;
+   }
+
+   for (int s=0; s<NUM_STREAMS; s++)
+   {
+      pthread_create (&streamThreads[s], NULL, testStreamProc, &streams[s]);
+   }
+   for (int f=0; f<NUM_FILES; f++)
+   {
+      pthread_create (&fileThreads[f], NULL, testFileProc, &files[f]);
+   }
+
+   return fifos;
+}
+
+START_TEST (test_missing_boundaries)
+{
+   // more boundaries than credits, but fewer than the fifo capacity
+   int numBoundaries = 4 * TEST_CREDITS;
+
+   test_file_t files[NUM_FILES];
+   test_stream_t streams[NUM_STREAMS];
+   pthread_t fileThreads[NUM_FILES];
+   pthread_t streamThreads[NUM_STREAMS];
+   thread_safe_fifo_t *fifos = startTest (numBoundaries, files, streams, fileThreads, streamThreads);
+
+   int joined = 1;
+   for (int f=0; f<NUM_FILES; f++)
+   {
+      joined = joined && joinWithTimeout (fileThreads[f]) == 0;
+   }
+   for (int s=0; s<NUM_STREAMS; s++)
+   {
+      joined = joined && joinWithTimeout (streamThreads[s]) == 0;
+   }
+   fail_unless(joined, "deadlock");
+   if (!joined)
+   {
+      return rc;
+   }
+
+   fail_unless(files[0].returnCode == 0 && files[1].returnCode == 0, "push failed");
+   fail_unless2(streams[0].numPopped == numBoundaries, "wrong number of elements popped", "%d", streams[0].numPopped);
+   fail_unless2(streams[1].numPopped == 2 * numBoundaries, "wrong number of elements popped", "%d", streams[1].numPopped);
+
+   for (int i=0; i<NUM_FILES * NUM_STREAMS; i++)
+   {
+      fifo_destroy (&fifos[i]);
+   }
+   free (fifos);
+}
+END_TEST
+
+START_TEST (test_stall_fails)
+{
+   // the file with boundaries gets more than the fifo capacity ahead on stream 0, and the other file
+   // more than that ahead on stream 1 once the first one has stalled
+   int numBoundaries = 3 * FIFO_DEFAULT_CAPACITY;
+
+   test_file_t files[NUM_FILES];
+   test_stream_t streams[NUM_STREAMS];
+   pthread_t fileThreads[NUM_FILES];
+   pthread_t streamThreads[NUM_STREAMS];
+   thread_safe_fifo_t *fifos = startTest (numBoundaries, files, streams, fileThreads, streamThreads);
+
+   int joined = (joinWithTimeout (fileThreads[0]) == 0);
+   fail_unless(joined, "deadlock");
+   fail_unless2(!joined || files[0].returnCode == FIFO_STALLED, "push did not stall", "%d", files[0].returnCode);
+
+   // the analysis threads are left waiting on the stalled files
+}
+END_TEST
+
+int main(int argc, char** argv)
+{
+   int _testnum = 1;
+
+   ok( test_missing_boundaries() , "two files, one with no boundaries on one stream");
+   ok( test_stall_fails() ,        "stall past the fifo capacity fails");
+
+   return 0;
+}
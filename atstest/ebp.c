@@ -270,19 +270,6 @@ void ebp_print_stdout(const ebp_t *ebp)
 
 }
 
-static descriptor_t* ebp_descriptor_new(descriptor_t *desc)
-{
-   ebp_descriptor_t *ebp = NULL;
-   ebp = (ebp_descriptor_t *)calloc(1, sizeof(ebp_descriptor_t));
-   ebp->descriptor.tag = EBP_DESCRIPTOR;
-   if (desc != NULL)
-   {
-      ebp->descriptor.length = desc->length;
-      free(desc);
-   }
-   return (descriptor_t *)ebp;
-}
-
 int ebp_descriptor_free(descriptor_t *desc)
 {
 //   LOG_INFO_ARGS ("ebp_descriptor_free: %x", (unsigned int)desc);
@@ -291,6 +278,9 @@ int ebp_descriptor_free(descriptor_t *desc)
 
     ebp_descriptor_t *ebp = (ebp_descriptor_t *)desc;
 
+   // descriptors parsed from a PMT are released with the PMT arena
+   if (ebp->arena != NULL) return 0;
+
    // walk the partition_data array and free all entries
    // then free partition_data using vqarray_free(vqarray_t* v)
    while (1)
@@ -309,9 +299,9 @@ int ebp_descriptor_free(descriptor_t *desc)
    return 1;
 }
 
-descriptor_t* ebp_descriptor_read(descriptor_t *desc, bs_t *b)
+descriptor_t* ebp_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena)
 {
-   if ((desc == NULL) || (b == NULL)) return NULL;
+   if ((desc == NULL) || (b == NULL) || (arena == NULL)) return NULL;
 
    
  /*  printf ("ebp_descriptor_read: %d: ", desc->length);
@@ -325,8 +315,9 @@ descriptor_t* ebp_descriptor_read(descriptor_t *desc, bs_t *b)
    */
   
 
-   ebp_descriptor_t *ebp =
-         (ebp_descriptor_t *)ebp_descriptor_new(desc);
+   ebp_descriptor_t *ebp = (ebp_descriptor_t *)arena_calloc(arena, 1, sizeof(ebp_descriptor_t));
+   ebp->descriptor = *desc;
+   ebp->arena = arena;
 //   LOG_INFO_ARGS ("ebp_descriptor_read: %x", (unsigned int)ebp);
 
    ebp->num_partitions = bs_read_u(b, 5);
@@ -339,10 +330,10 @@ descriptor_t* ebp_descriptor_read(descriptor_t *desc, bs_t *b)
    if (ebp->num_partitions > 0)
    {
       int i = ebp->num_partitions;
-      ebp->partition_data = vqarray_new();
+      ebp->partition_data = vqarray_new_in(arena);
       while (i-- > 0)
       {
-         ebp_partition_data_t *partition_data = calloc(1, sizeof(ebp_partition_data_t));
+         ebp_partition_data_t *partition_data = arena_calloc(arena, 1, sizeof(ebp_partition_data_t));
          partition_data->ebp_data_explicit_flag = bs_read_u1(b);
          partition_data->representation_id_flag = bs_read_u1(b);
          partition_data->partition_id = bs_read_u(b, 5);
@@ -449,6 +440,39 @@ ebp_descriptor_t* ebp_descriptor_copy(const ebp_descriptor_t *ebp_in)
    return ebp;
 }
 
+ebp_descriptor_t* ebp_descriptor_retain(ebp_descriptor_t *ebp_desc)
+{
+   if (ebp_desc == NULL)
+   {
+      return NULL;
+   }
+
+   if (ebp_desc->arena == NULL)
+   {
+      return ebp_descriptor_copy(ebp_desc);
+   }
+
+   arena_ref(ebp_desc->arena);
+   return ebp_desc;
+}
+
+void ebp_descriptor_release(ebp_descriptor_t *ebp_desc)
+{
+   if (ebp_desc == NULL)
+   {
+      return;
+   }
+
+   if (ebp_desc->arena == NULL)
+   {
+      ebp_descriptor_free((descriptor_t *)ebp_desc);
+   }
+   else
+   {
+      arena_free(ebp_desc->arena);
+   }
+}
+
 
 void ebp_descriptor_print_stdout(const ebp_descriptor_t *ebp_desc)
 {
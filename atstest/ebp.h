@@ -101,16 +101,23 @@ typedef struct {
 
    vqarray_t *partition_data; // Array of ebp_partition_data_t
 
+   arena_t *arena;   // arena of the PMT this was parsed from; NULL for heap copies
+
 } ebp_descriptor_t;
 
 #define EBP_DESCRIPTOR 0xE9
 
 int ebp_descriptor_free(descriptor_t *desc);
-descriptor_t* ebp_descriptor_read(descriptor_t *desc, bs_t *b);
+descriptor_t* ebp_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena);
 int ebp_descriptor_print(const descriptor_t *desc, int level, char *str, size_t str_len);
 void ebp_descriptor_print_stdout(const ebp_descriptor_t *ebp_desc);
 ebp_descriptor_t* ebp_descriptor_copy(const ebp_descriptor_t *ebp_desc);
 
+// Keep a descriptor alive past the PMT it was parsed from: takes a reference to the
+// PMT arena (or deep-copies a heap descriptor).  Drop it with ebp_descriptor_release.
+ebp_descriptor_t* ebp_descriptor_retain(ebp_descriptor_t *ebp_desc);
+void ebp_descriptor_release(ebp_descriptor_t *ebp_desc);
+
 int does_fragment_mark_boundary (const ebp_descriptor_t *ebp_desc);
 int does_segment_mark_boundary (const ebp_descriptor_t *ebp_desc);
 
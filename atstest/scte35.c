@@ -27,6 +27,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "scte35.h"
+#include "crc32m.h"
 #include "log.h"
 #include "ATSTestReport.h"
 
@@ -191,7 +192,6 @@ int scte35_splice_info_section_read(scte35_splice_info_section *sis, uint8_t *bu
    else
    {
       b = bs_new(buf, buf_len);
-      sleep (1);
    }
             
    sis->table_id = bs_read_u8(b); 
@@ -228,6 +228,22 @@ int scte35_splice_info_section_read(scte35_splice_info_section *sis, uint8_t *bu
       return 0;
    }
 
+   // verify CRC_32 before parsing anything from the section body: running the CRC
+   // over the whole section including CRC_32 must yield zero
+   if (sis->section_length < 4 ||
+       crc_update(crc_init(), b->start, sis->section_length + 3) != 0)
+   {
+      crc_t calcCRC = crc_finalize(crc_update(crc_init(), b->start, 
+         sis->section_length >= 4 ? sis->section_length - 1 : 0));
+      LOG_ERROR_ARGS ("scte35_splice_info_section_read: FAIL: CRC_32 mismatch (calculated 0x%08X, section_length = %d)", 
+         calcCRC, sis->section_length);
+      reportAddErrorLogArgs ("scte35_splice_info_section_read: FAIL: CRC_32 mismatch (calculated 0x%08X, section_length = %d)", 
+         calcCRC, sis->section_length);
+      resetPSITableBuffer(scte35TableBuffer);
+      bs_free (b);
+      return -1;
+   }
+
    sis->protocol_version = bs_read_u(b, 8); 
    sis->encrypted_packet = bs_read_u(b, 1); 
    sis->encryption_algorithm = bs_read_u(b, 6); 
@@ -74,7 +74,55 @@ static uint64_t bs_read_ull(bs_t *b, int n);
 
 // impl
 
-// FIXME optimize for performance
+// Multi-bit reads load up to 64 bits at once from b->p and then advance p/bits_left.
+// No bits are cached in bs_t between calls, so code which moves b->p directly stays valid.
+
+static inline uint64_t _bs_load_be64(const uint8_t *p, const uint8_t *end) 
+{ 
+   uint64_t v = 0; 
+   if (end - p >= 8) 
+   {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+      memcpy(&v, p, 8); 
+      return __builtin_bswap64(v); 
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+      memcpy(&v, p, 8); 
+      return v; 
+#endif
+   }
+   
+   // near the end of the buffer: bits past the end read as zero
+   for (int i = 0; i < 8; i++) 
+   {
+      v <<= 8; 
+      if (p + i < end) v |= p[i];
+   }
+   return v;
+}
+
+static inline void _bs_advance(bs_t *b, int n) 
+{ 
+   int pos = (8 - b->bits_left) + n; 
+   b->p += (pos >> 3); 
+   b->bits_left = 8 - (pos & 0x07); 
+   if (b->p >= b->end) 
+   {
+      // never step past the end, just like reading one bit at a time
+      b->p = b->end; 
+      b->bits_left = 8;
+   }
+}
+
+static inline int _bs_clz32(uint32_t v) 
+{ 
+#if defined(__GNUC__)
+   return v ? __builtin_clz(v) : 32; 
+#else
+   int n = 0; 
+   while (n < 32 && !(v & 0x80000000)) { v <<= 1; n++; } 
+   return n;
+#endif
+}
 
 static inline bs_t* bs_init(bs_t *b, uint8_t *buf, size_t size) 
 { 
@@ -169,15 +217,7 @@ static inline void bs_write_u1(bs_t *b, uint32_t v)
 
 static inline uint32_t bs_read_u(bs_t *b, int n) 
 { 
-   if (!b || bs_eof(b)) return 0; 
-   
-   uint32_t result = 0; 
-   while (n--) 
-   {
-      result <<= 1; 
-      result |= bs_read_u1(b);
-   }
-   return result;
+   return (uint32_t)bs_read_ull(b, n);
 }
 
 static inline void bs_write_u(bs_t *b, int n, uint32_t v) 
@@ -229,6 +269,17 @@ static inline uint32_t bs_read_ue(bs_t *b)
    if (!b) return 0; 
    
    int i = 0; 
+   if (b->end - b->p >= 8) 
+   {
+      // count the leading zeros in one go; the slow path below handles 32+ zeros and the buffer tail
+      uint32_t next = (uint32_t)((_bs_load_be64(b->p, b->end) << (8 - b->bits_left)) >> 32); 
+      if (next != 0) 
+      {
+         i = _bs_clz32(next); 
+         _bs_advance(b, i + 1); 
+         return (uint32_t)bs_read_ull(b, i) + (1 << i) - 1;
+      }
+   }
    while ((bs_read_u1(b) == 0) && (i < 32) && !bs_eof(b)) i++; 
    
    int32_t result = bs_read_u(b, i); 
@@ -326,17 +377,26 @@ static inline void bs_skip_u1(bs_t *b)
 
 static inline void bs_skip_u(bs_t *b, int n) 
 { 
-   if (!b || bs_eof(b)) return; 
+   if (!b || bs_eof(b) || n < 1) return; 
    
-   while (n--) bs_skip_u1(b);
+   _bs_advance(b, n);
 }
 
 static inline uint64_t bs_read_ull(bs_t *b, int n) 
 { 
    if (!b || bs_eof(b) || n < 1) return 0; 
    
-   uint64_t r = 0; 
-   while (n--) r |= ((uint64_t)bs_read_u1(b) << n); 
+   // a 64-bit load covers at least 57 bits from any bit offset
+   if (n > 56) 
+   {
+      uint64_t hi = bs_read_ull(b, n - 32); 
+      return (hi << 32) | bs_read_ull(b, 32);
+   }
+   
+   uint64_t r = _bs_load_be64(b->p, b->end); 
+   if (b->bits_left != 8) r <<= (8 - b->bits_left); 
+   r >>= (64 - n); 
+   _bs_advance(b, n); 
    return r;
 }
 
@@ -349,18 +409,9 @@ static inline void bs_write_ull(bs_t *b, int n, uint64_t v)
 
 static inline uint64_t bs_read_uN(bs_t *b, int n) 
 { 
-    if (!b || bs_eof(b)) return 0; 
-
-    uint64_t r = 0; 
-    int i;
-    if ( n > 4 )
-        for (i = 1; i <= n; i++)
-            r += ((uint64_t)bs_read_u8(b)) << ((n - i) << 3); 
-    else
-        for (i = 1; i <= n; i++)
-            r += bs_read_u8(b) << ((n - i) << 3); 
+    if (!b || bs_eof(b) || n < 1) return 0; 
 
-    return r;
+    return bs_read_ull(b, n << 3);
 }
 
 static inline void bs_write_uN(bs_t *b, int n, uint64_t v) 
@@ -138,51 +138,154 @@ int find_nal_unit(uint8_t* buf, int size, int* nal_start, int* nal_end)
 }
 */
 
-int find_nal_unit(uint8_t* buf, int size, int* nal_start, int* nal_end)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#endif
+
+/**
+ Find the next 00 00 01 start code prefix at or after pos.
+ The scalar version looks at every third byte: unless it is 00 or 01, no start code can begin at
+ it or at either of the two bytes before it.
+ @return  the offset of the first 00 of the prefix, or -1 if there is none
+ */
+static int next_start_code_c(const uint8_t* buf, int size, int pos)
 {
-    int i;
-    // find start
-    *nal_start = 0;
-    *nal_end = 0;
+    while (pos + 3 <= size)
+    {
+        if (buf[pos+2] > 1) { pos += 3; continue; }
+        if (buf[pos+2] == 1 && buf[pos+1] == 0 && buf[pos] == 0) { return pos; }
+        pos++;
+    }
+    return -1;
+}
 
-    i = 0;
-//    while (   //( next_bits( 24 ) != 0x000001 && next_bits( 32 ) != 0x00000001 )
-//        (buf[i] != 0 || buf[i+1] != 0 || buf[i+2] != 0x01) &&
-//        (buf[i] != 0 || buf[i+1] != 0 || buf[i+2] != 0 || buf[i+3] != 0x01)
-//        )
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
 
-    while (buf[i] != 0x0 || buf[i+1] != 0x0 || (buf[i+2] != 0x1 && (buf[i+2] != 0x0 || buf[i+3] != 0x1))) {
-        i++; // skip leading zero
-        if (i+4 >= size)
-        	return 0; // did not find nal start
+// each vector step compares buf[i], buf[i+1] and buf[i+2] for 00 00 01 at 16 (32) positions at once
+
+__attribute__((target("sse2")))
+static int next_start_code_sse2(const uint8_t* buf, int size, int pos)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+
+    for ( ; pos + 18 <= size; pos += 16)
+    {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(buf + pos));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(buf + pos + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(buf + pos + 2));
+        __m128i m = _mm_and_si128(_mm_cmpeq_epi8(b2, one),
+                                  _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+        if (mask) { return pos + __builtin_ctz(mask); }
     }
+    return next_start_code_c(buf, size, pos);
+}
 
-    if  (buf[i] != 0 || buf[i+1] != 0 || buf[i+2] != 0x01) // ( next_bits( 24 ) != 0x000001 )
-        i++;
+__attribute__((target("avx2")))
+static int next_start_code_avx2(const uint8_t* buf, int size, int pos)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
 
-    if  (buf[i] != 0 || buf[i+1] != 0 || buf[i+2] != 0x01) {
-    	fprintf(stderr, "ERROR: should never happen\n");
-    	return 0;
+    for ( ; pos + 34 <= size; pos += 32)
+    {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(buf + pos));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(buf + pos + 1));
+        __m256i b2 = _mm256_loadu_si256((const __m256i*)(buf + pos + 2));
+        __m256i m = _mm256_and_si256(_mm256_cmpeq_epi8(b2, one),
+                                     _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+        if (mask) { return pos + __builtin_ctz(mask); }
     }
-    i+= 3;
-    *nal_start = i;
-    
-//    while (   //( next_bits( 24 ) != 0x000000 && next_bits( 24 ) != 0x000001 )
-//        (buf[i] != 0 || buf[i+1] != 0 || buf[i+2] != 0) &&
-//        (buf[i] != 0 || buf[i+1] != 0 || buf[i+2] != 0x01)
-//        )
-    while (buf[i] != 0 || buf[i+1] != 0 || (buf[i+2] != 0 && buf[i+2] != 1)) {
-        i++; // FIXME the next line fails when reading a nal that ends exactly at the end of the data
-        if (i+3 >= size) {
-        	*nal_end = size;
-        	return -1;
-        } // did not find nal end, stream ended first
+    return next_start_code_c(buf, size, pos);
+}
+#endif
+
+/**
+ Find the next 00 00 01 start code prefix at or after pos, with the fastest scanner the CPU supports.
+ @return  the offset of the first 00 of the prefix, or -1 if there is none
+ */
+static int next_start_code(const uint8_t* buf, int size, int pos)
+{
+    static int (*impl)(const uint8_t*, int, int) = NULL;
+    if (impl == NULL)
+    {
+        int (*selected)(const uint8_t*, int, int) = next_start_code_c;
+#ifdef HAVE_X86_SIMD
+        if (__builtin_cpu_supports("avx2")) { selected = next_start_code_avx2; }
+        else if (__builtin_cpu_supports("sse2")) { selected = next_start_code_sse2; }
+#endif
+        impl = selected;
+    }
+    return impl(buf, size, pos);
+}
+
+/**
+ Same as the stock find_nal_unit above, on top of next_start_code.
+ */
+int find_nal_unit(uint8_t* buf, int size, int* nal_start, int* nal_end)
+{
+    *nal_start = 0;
+    *nal_end = 0;
+
+    // a 4-byte start code is found by its last three bytes
+    int sc = next_start_code(buf, size, 0);
+    if (sc < 0) { return 0; } // did not find nal start
+    *nal_start = sc + 3;
+
+    // the nal ends at the next 00 00 00 or 00 00 01, i.e. at the next start code less any zero bytes before it
+    sc = next_start_code(buf, size, *nal_start);
+    if (sc < 0)
+    {
+        *nal_end = size;
+        return -1; // did not find nal end, stream ended first
     }
+    int i = sc;
+    while (i > *nal_start && buf[i-1] == 0x00) { i--; }
 
     *nal_end = i;
     return (*nal_end - *nal_start);
 }
 
+/**
+ Find all NAL units in a byte buffer containing H264 bitstream data in Annex B format, in one pass.
+ Unlike find_nal_unit, the last NAL unit in the buffer is returned as well and ends at the end of the
+ buffer; every other NAL unit ends at the next start code, less any trailing zero bytes (so 4-byte
+ start codes and trailing_zero_8bits are not part of the NAL unit).
+ Uses AVX2 or SSE2 when the CPU supports them.
+ @param[in]   buf        the buffer
+ @param[in]   size       the size of the buffer
+ @param[out]  nal_start  array of max_nals, receives the offset of the first byte of each nal (its header)
+ @param[out]  nal_end    array of max_nals, receives the end offset of each nal
+ @param[in]   max_nals   the size of the arrays; the scan stops once they are full, and can be resumed
+                         at nal_end[max_nals-1]
+ @return                 the number of nals found
+ */
+int find_nal_units(const uint8_t* buf, int size, int* nal_start, int* nal_end, int max_nals)
+{
+    int n = 0;
+    int sc = next_start_code(buf, size, 0);
+    while (sc >= 0 && n < max_nals)
+    {
+        int start = sc + 3;
+        int end = size;
+        sc = next_start_code(buf, size, start);
+        if (sc >= 0)
+        {
+            end = sc;
+            while (end > start && buf[end-1] == 0x00) { end--; }
+        }
+
+        nal_start[n] = start;
+        nal_end[n] = end;
+        n++;
+    }
+
+    return n;
+}
+
 /**
    Convert RBSP data to NAL data (Annex B format).
    The size of nal_buf must be 4/3 * the size of the rbsp_buf (rounded up) to guarantee the output will fit.
@@ -378,6 +378,7 @@ h264_stream_t* h264_new();
 void h264_free(h264_stream_t* h);
 
 int find_nal_unit(uint8_t* buf, int size, int* nal_start, int* nal_end);
+int find_nal_units(const uint8_t* buf, int size, int* nal_start, int* nal_end, int max_nals);
 
 int rbsp_to_nal(const uint8_t* rbsp_buf, const int* rbsp_size, uint8_t* nal_buf, int* nal_size);
 int nal_to_rbsp(const uint8_t* nal_buf, int* nal_size, uint8_t* rbsp_buf, int* rbsp_size);
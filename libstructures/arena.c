@@ -0,0 +1,204 @@
+/* 
+ * libstructures - a library for generic data structures in C
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// all allocations are aligned to this, which is enough for any scalar type
+#define ARENA_ALIGN 16
+
+struct arena_block_s
+{
+    arena_block_t* next;
+    size_t size;
+    size_t used;
+    // payload follows, aligned to ARENA_ALIGN
+};
+
+struct arena_cleanup_s
+{
+    arena_cleanup_entry_t* next;
+    arena_cleanup_t func;
+    void* arg;
+};
+
+#define ARENA_ROUND_UP(n) ( ((n) + (ARENA_ALIGN - 1)) & ~((size_t)ARENA_ALIGN - 1) )
+#define ARENA_BLOCK_HEADER_SIZE ARENA_ROUND_UP(sizeof(arena_block_t))
+
+static arena_block_t* _arena_block_new(size_t size)
+{
+    arena_block_t* b = (arena_block_t*)malloc(ARENA_BLOCK_HEADER_SIZE + size);
+    if (b == NULL) return NULL;
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+/**
+   Create a new arena with a single reference.
+   @param block_size size of the blocks allocations are carved from (0 to use the default)
+   @return the new arena, or NULL if out of memory
+ */
+arena_t* arena_new(size_t block_size)
+{
+    arena_t* a = (arena_t*)malloc(sizeof(arena_t));
+    if (a == NULL) return NULL;
+    if (block_size == 0) block_size = ARENA_DEFAULT_BLOCK_SIZE;
+    a->block_size = ARENA_ROUND_UP(block_size);
+    a->blocks = NULL;
+    a->cleanups = NULL;
+    a->bytes_allocated = 0;
+    a->refcount = 1;
+    return a;
+}
+
+/**
+   Take an additional reference to the arena.
+   @param a the arena (may be NULL)
+   @return the arena
+ */
+arena_t* arena_ref(arena_t* a)
+{
+    if (a != NULL) __atomic_add_fetch(&a->refcount, 1, __ATOMIC_RELAXED);
+    return a;
+}
+
+/**
+   Drop a reference to the arena.  When the last reference is dropped the
+   cleanups run in reverse order of registration and all memory handed out
+   by the arena is released.
+   @param a the arena (may be NULL)
+ */
+void arena_free(arena_t* a)
+{
+    if (a == NULL) return;
+    if (__atomic_sub_fetch(&a->refcount, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    // cleanup entries live in the arena, so run them all before releasing blocks
+    for (arena_cleanup_entry_t* c = a->cleanups; c != NULL; c = c->next)
+    {
+        c->func(c->arg);
+    }
+
+    arena_block_t* b = a->blocks;
+    while (b != NULL)
+    {
+        arena_block_t* next = b->next;
+        free(b);
+        b = next;
+    }
+    free(a);
+}
+
+/**
+   Allocate memory from the arena.  The memory is not initialized and is
+   released only when the arena is freed.
+   @param a the arena
+   @param size number of bytes
+   @return pointer aligned for any scalar type, or NULL if out of memory
+ */
+void* arena_alloc(arena_t* a, size_t size)
+{
+    size = ARENA_ROUND_UP(size == 0 ? 1 : size);
+
+    arena_block_t* b = a->blocks;
+    if (b == NULL || b->size - b->used < size)
+    {
+        if (size > a->block_size / 4)
+        {
+            // large allocation: give it a block of its own behind the current one,
+            // so the space left in the current block is not wasted
+            arena_block_t* big = _arena_block_new(size);
+            if (big == NULL) return NULL;
+            big->used = size;
+            if (b == NULL) 
+            {
+                a->blocks = big;
+            }
+            else
+            {
+                big->next = b->next;
+                b->next = big;
+            }
+            a->bytes_allocated += size;
+            return (uint8_t*)big + ARENA_BLOCK_HEADER_SIZE;
+        }
+
+        b = _arena_block_new(a->block_size);
+        if (b == NULL) return NULL;
+        b->next = a->blocks;
+        a->blocks = b;
+    }
+
+    void* p = (uint8_t*)b + ARENA_BLOCK_HEADER_SIZE + b->used;
+    b->used += size;
+    a->bytes_allocated += size;
+    return p;
+}
+
+/**
+   Allocate zero-initialized memory from the arena.
+   @param a the arena
+   @param nmemb number of elements
+   @param size size of each element
+   @return pointer, or NULL if out of memory
+ */
+void* arena_calloc(arena_t* a, size_t nmemb, size_t size)
+{
+    if (size != 0 && nmemb > SIZE_MAX / size) return NULL;
+    void* p = arena_alloc(a, nmemb * size);
+    if (p != NULL) memset(p, 0, nmemb * size);
+    return p;
+}
+
+/**
+   Copy a string into the arena.
+   @param a the arena
+   @param s the string
+   @return the copy, or NULL if out of memory
+ */
+char* arena_strdup(arena_t* a, const char* s)
+{
+    size_t len = strlen(s) + 1;
+    char* p = (char*)arena_alloc(a, len);
+    if (p != NULL) memcpy(p, s, len);
+    return p;
+}
+
+/**
+   Register a function to be called with arg when the arena is released.
+   Cleanups run in reverse order of registration.
+   @param a the arena
+   @param func the cleanup function
+   @param arg argument passed to func
+   @return 1 on success, 0 if out of memory
+ */
+int arena_add_cleanup(arena_t* a, arena_cleanup_t func, void* arg)
+{
+    arena_cleanup_entry_t* c = (arena_cleanup_entry_t*)arena_alloc(a, sizeof(arena_cleanup_entry_t));
+    if (c == NULL) return 0;
+    c->func = func;
+    c->arg = arg;
+    c->next = a->cleanups;
+    a->cleanups = c;
+    return 1;
+}
@@ -0,0 +1,68 @@
+/* 
+ * libstructures - a library for generic data structures in C
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ARENA_INCLUDE
+#define ARENA_INCLUDE
+
+#include <stddef.h>
+
+/**
+   Region allocator.  Many small allocations are carved out of large blocks
+   and released all at once by arena_free; individual allocations are never
+   freed.  Objects that must release outside resources when the arena goes
+   away (e.g. heap buffers of a growable array) register a cleanup.
+
+   The arena is reference counted so that pointers into it can outlive the
+   owner that created it: every arena_ref must be matched by an arena_free,
+   and the memory is released when the last reference is dropped.  Reference
+   counting is atomic, so references may be dropped from any thread;
+   allocation itself is not thread-safe.
+ */
+
+typedef void (*arena_cleanup_t)(void*);
+
+typedef struct arena_block_s arena_block_t;
+typedef struct arena_cleanup_s arena_cleanup_entry_t;
+
+typedef struct
+{
+    arena_block_t* blocks;
+    arena_cleanup_entry_t* cleanups;
+    size_t block_size;
+    size_t bytes_allocated;
+    int refcount;
+} arena_t;
+
+#define ARENA_DEFAULT_BLOCK_SIZE 4096
+
+arena_t* arena_new(size_t block_size);
+arena_t* arena_ref(arena_t* a);
+void arena_free(arena_t* a);
+
+void* arena_alloc(arena_t* a, size_t size);
+void* arena_calloc(arena_t* a, size_t nmemb, size_t size);
+char* arena_strdup(arena_t* a, const char* s);
+int arena_add_cleanup(arena_t* a, arena_cleanup_t func, void* arg);
+
+/**
+   Returns the number of bytes handed out by the arena so far.
+   @param a the arena
+ */
+static inline size_t arena_bytes_allocated(const arena_t* a) { return a->bytes_allocated; }
+
+#endif
@@ -0,0 +1,153 @@
+/* 
+ * libstructures - a library for generic data structures in C
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "arena.h"
+#include "vqarray.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "test_macros.h"
+
+int verbose = 0;
+
+static int cleanup_order[4];
+static int num_cleanups = 0;
+
+void record_cleanup(void* arg)
+{
+    cleanup_order[num_cleanups++] = *(int*)arg;
+}
+
+START_TEST (test_alloc)
+{
+    arena_t* a = arena_new(256);
+    uint8_t* prev = NULL;
+    for (int i = 1; i < 200; i++)
+    {
+        uint8_t* p = (uint8_t*)arena_alloc(a, i);
+        fail_unless( p != NULL, "allocation failed" );
+        fail_unless( ((uintptr_t)p & 15) == 0, "allocation not aligned" );
+        fail_unless( p != prev, "allocation reused" );
+        memset(p, i, i);
+        prev = p;
+    }
+
+    // large allocations get a block of their own
+    uint8_t* big = (uint8_t*)arena_alloc(a, 10000);
+    fail_unless( big != NULL, "large allocation failed" );
+    memset(big, 0xff, 10000);
+
+    int* z = (int*)arena_calloc(a, 100, sizeof(int));
+    for (int i = 0; i < 100; i++)
+    {
+        fail_unless( z[i] == 0, "calloc not zeroed" );
+    }
+
+    char* s = arena_strdup(a, "arena");
+    fail_unless( strcmp(s, "arena") == 0, "strdup mismatch" );
+
+    if (verbose) { printf("bytes allocated: %zu\n", arena_bytes_allocated(a)); }
+    fail_unless( arena_bytes_allocated(a) >= 10000 + 100 * sizeof(int), "bytes allocated too small" );
+
+    arena_free(a);
+}
+END_TEST
+
+START_TEST (test_cleanup)
+{
+    static int ids[3] = { 1, 2, 3 };
+    num_cleanups = 0;
+
+    arena_t* a = arena_new(0);
+    for (int i = 0; i < 3; i++)
+    {
+        arena_add_cleanup(a, record_cleanup, &ids[i]);
+    }
+
+    arena_ref(a);
+    arena_free(a);
+    fail_unless( num_cleanups == 0, "cleanup ran while referenced" );
+
+    arena_free(a);
+    fail_unless( num_cleanups == 3, "cleanups not run" );
+    fail_unless( cleanup_order[0] == 3 && cleanup_order[1] == 2 && cleanup_order[2] == 1, "cleanups not run in reverse order" );
+}
+END_TEST
+
+START_TEST (test_vqarray_in_arena)
+{
+    arena_t* a = arena_new(0);
+    vqarray_t* v = vqarray_new_in(a);
+    for (intptr_t i = 0; i < 1000; i++)
+    {
+        vqarray_add(v, (void*)i);
+    }
+    fail_unless( vqarray_length(v) == 1000, "wrong length" );
+    fail_unless( (intptr_t)vqarray_get(v, 999) == 999, "wrong element" );
+    arena_free(a);
+}
+END_TEST
+
+void* unref_thread(void* arg)
+{
+    arena_t* a = (arena_t*)arg;
+    for (int i = 0; i < 10000; i++)
+    {
+        arena_free(arena_ref(a));
+    }
+    arena_free(a);
+    return NULL;
+}
+
+START_TEST (test_refcount_threads)
+{
+    static int id = 0;
+    num_cleanups = 0;
+
+    arena_t* a = arena_new(0);
+    arena_add_cleanup(a, record_cleanup, &id);
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_create(&threads[i], NULL, unref_thread, arena_ref(a));
+    }
+    arena_free(a);
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    fail_unless( num_cleanups == 1, "arena not released exactly once" );
+}
+END_TEST
+
+int main(int argc, char** argv)
+{
+    int _testnum = 1;
+
+    ok( test_alloc() ,            "alloc" );
+    ok( test_cleanup() ,          "cleanup and refcount" );
+    ok( test_vqarray_in_arena() , "vqarray in arena" );
+    ok( test_refcount_threads() , "refcount across threads" );
+
+    return 0;
+}
@@ -61,6 +61,26 @@ vqarray_t* vqarray_init(vqarray_t* v, int length )
     return v;
 }
 
+/**
+   Create new array owned by an arena.  The array is initially empty.
+   The array itself lives in the arena and its buffer is released when the arena
+   is freed; it must not be passed to vqarray_free.  The elements are not deallocated.
+   @param a the arena
+   @return  the new array
+ */
+vqarray_t* vqarray_new_in(arena_t* a)
+{
+    vqarray_t* v = (vqarray_t*)arena_alloc(a, sizeof(vqarray_t));
+    if (v == NULL) return NULL;
+    vqarray_init(v, -1);
+    if (!arena_add_cleanup(a, (arena_cleanup_t)vqarray_free_buf, v))
+    {
+        vqarray_free_buf(v);
+        return NULL;
+    }
+    return v;
+}
+
 /**
    Free array.  The array must not be used after this.
    @param v the array
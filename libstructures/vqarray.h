@@ -25,6 +25,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "arena.h"
+
 #ifndef _max
 #define _max(a, b) ( (a) > (b) ? (a) : (b) )
 #endif
@@ -50,6 +52,7 @@ typedef void (*vqarray_functor2_t)(void*, void*);
 
 vqarray_t* vqarray_new();
 vqarray_t* vqarray_init(vqarray_t* v, int length );
+vqarray_t* vqarray_new_in(arena_t* a);
 void vqarray_free_buf(vqarray_t* v);
 void vqarray_free(vqarray_t* v);
 
@@ -19,6 +19,7 @@
 #include <time.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include <inttypes.h>
 #include <tpes.h>
@@ -33,6 +34,12 @@ static varray_t* g_listBPInfos;
 static varray_t* g_listErrorMsgs;
 static varray_t* g_listInfoMsgs;
 
+// the lists above are appended to by all ingest and analysis threads
+static pthread_mutex_t g_reportMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static ingest_stats_t* g_ingestStats = NULL;
+static int g_numIngestStats = 0;
+
 int reportGet2DArrayIndex (int fileIndex, int streamIndex, int numStreams)
 {
    return fileIndex * numStreams + streamIndex;
@@ -109,21 +116,34 @@ void reportAddPTS (int64_t PTS, uint8_t partitionId, uint8_t ingestId, uint8_t s
    bpInfo->streamId = streamId;
    bpInfo->PID = PID;
 
+   pthread_mutex_lock(&g_reportMutex);
    varray_add(g_listBPInfos, bpInfo);
+   pthread_mutex_unlock(&g_reportMutex);
+}
+
+void reportSetIngestStats (int numIngests, ingest_stats_t *ingestStats)
+{
+   // caller keeps ownership of ingestStats
+   g_numIngestStats = numIngests;
+   g_ingestStats = ingestStats;
 }
 
 void reportAddInfoLog (char *infoMsg)
 {
    char *temp = (char *) malloc (strlen(infoMsg) + 1);
    strcpy(temp, infoMsg);
+   pthread_mutex_lock(&g_reportMutex);
    varray_add(g_listInfoMsgs, temp);
+   pthread_mutex_unlock(&g_reportMutex);
 }
 
 void reportAddErrorLog (char *errorMsg)
 {
    char *temp = (char *) malloc (strlen(errorMsg) + 1);
    strcpy(temp, errorMsg);
+   pthread_mutex_lock(&g_reportMutex);
    varray_add(g_listErrorMsgs, temp);
+   pthread_mutex_unlock(&g_reportMutex);
 }
 
 char *reportPrint(int numIngests, int numStreams, ebp_stream_info_t **streamInfoArray, char **ingestNames, int *filePassFails,
@@ -157,6 +177,7 @@ char *reportPrint(int numIngests, int numStreams, ebp_stream_info_t **streamInfo
    fprintf (myFile, "EBP Conformance Test Report\n");
 
    reportPrintStreamInfo(myFile, numIngests, numStreams, streamInfoArray, ingestNames, programStreamInfo);
+   reportPrintIngestStats(myFile, ingestNames);
 
    fprintf (myFile, "\nERROR Msgs:\n");
    for (int i=0; i<varray_length(g_listErrorMsgs); i++)
@@ -250,7 +271,9 @@ void reportAddInfoLogArgs (const char *fmt, ...)
    vsprintf (temp, fmt, args);
    va_end (args);
 
+   pthread_mutex_lock(&g_reportMutex);
    varray_add(g_listInfoMsgs, temp);
+   pthread_mutex_unlock(&g_reportMutex);
 }
 
 void reportAddErrorLogArgs (const char *fmt, ...)
@@ -263,7 +286,29 @@ void reportAddErrorLogArgs (const char *fmt, ...)
    vsprintf (temp, fmt, args);
    va_end (args);
 
+   pthread_mutex_lock(&g_reportMutex);
    varray_add(g_listErrorMsgs, temp);
+   pthread_mutex_unlock(&g_reportMutex);
+}
+
+void reportPrintIngestStats(FILE *reportFile, char **ingestNames)
+{
+   if (g_ingestStats == NULL)
+   {
+      return;
+   }
+
+   fprintf (reportFile, "\nIngest Buffer Status:\n");
+   for (int i=0; i<g_numIngestStats; i++)
+   {
+      ingest_stats_t *stats = &g_ingestStats[i];
+      fprintf (reportFile, "   Input %s: overflow policy %s, ReceivedBytes = %"PRIu64", Dropped = %"PRIu64" bytes (%"PRIu64" packets), "
+         "Overflows = %u, High Watermark = %d/%d bytes\n", 
+         ingestNames[i], stats->overflowPolicy, stats->receivedBytes, stats->droppedBytes, stats->droppedBytes / TS_SIZE,
+         stats->overflowEvents, stats->highWatermark, stats->bufferSz);
+      fprintf (reportFile, "      Packet size = %d, Lost sync = %"PRIu64" times, Skipped = %"PRIu64" bytes\n", 
+         stats->packetSize, stats->lostSyncEvents, stats->syncSkippedBytes);
+   }
 }
 
 void reportPrintBoundaryInfoArray(FILE *reportFile, ebp_boundary_info_t *boundaryInfoArray)
@@ -309,6 +354,9 @@ void reportPrintStreamInfo(FILE *reportFile, int numIngests, int numStreams, ebp
          }
 
          fprintf (reportFile, "      PID %d (%s)\n", streamInfo->PID, (streamInfo->isVideo?"VIDEO":"AUDIO"));
+         fprintf (reportFile, "         Packets: %"PRIu64", CC errors: %"PRIu64", Lost: %"PRIu64", Duplicates: %"PRIu64", Discontinuities: %"PRIu64"\n",
+            streamInfo->ccStats.num_packets, streamInfo->ccStats.num_cc_errors, streamInfo->ccStats.num_lost_packets,
+            streamInfo->ccStats.num_duplicates, streamInfo->ccStats.num_discontinuities);
 
          reportPrintBoundaryInfoArray(reportFile, streamInfo->ebpBoundaryInfo);
          
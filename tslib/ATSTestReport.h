@@ -34,8 +34,23 @@ typedef struct
 
 } bp_info_t;
 
+// ingest buffer overflow accounting, filled in by the app before printing a report
+typedef struct
+{
+   const char *overflowPolicy;
+   uint64_t receivedBytes;
+   uint64_t droppedBytes;        // dropped by the overflow policy, newest and oldest
+   unsigned int overflowEvents;  // number of times the buffer filled up
+   int highWatermark;            // most bytes ever buffered
+   int bufferSz;
+   int packetSize;               // framing of the received packets (188, 192 or 204), 0 if not known yet
+   uint64_t lostSyncEvents;
+   uint64_t syncSkippedBytes;    // bytes that were not part of any packet (e.g. RTP headers, corruption)
+} ingest_stats_t;
+
 
 void reportAddPTS (int64_t PTS, uint8_t partitionId, uint8_t ingestId, uint8_t streamId, uint32_t PID);
+void reportSetIngestStats (int numIngests, ingest_stats_t *ingestStats);
 
 void reportAddErrorLog (char *errorMsg);
 void reportAddErrorLogArgs (const char *fmt, ...);
@@ -49,6 +64,7 @@ char *reportPrint(int numIngests, int numStreams, ebp_stream_info_t **streamInfo
                   int *filePassFails, program_stream_info_t *programStreamInfo);
 
 void reportPrintBoundaryInfoArray(FILE *reportFile, ebp_boundary_info_t *boundaryInfoArray);
+void reportPrintIngestStats(FILE *reportFile, char **ingestNames);
 void reportPrintStreamInfo(FILE *reportFile, int numIngests, int numStreams, ebp_stream_info_t **streamInfoArray, 
                            char **ingestNames, program_stream_info_t *programStreamInfo);
 void reportPrintEBPDescriptor(FILE *reportFile, const ebp_descriptor_t *ebp_desc);
@@ -0,0 +1,228 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for the bs.h bit reader.
+ *
+ * Replays the field layouts of a TS header (with PCR), a PES header (with
+ * PTS/DTS) and an AVC slice header against the current bs.h and against a
+ * bit-at-a-time reference reader (the pre-optimization implementation), checks
+ * that both decode identical values and reports the time per header.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bs.h"
+
+#define BENCH_BUF_SIZE   (TS_BENCH_PACKETS * 188)
+#define TS_BENCH_PACKETS 4096
+
+// reference reader: one bit at a time, as bs.h used to do it
+
+static inline uint32_t ref_read_u1(bs_t *b)
+{
+   if (bs_eof(b)) return 0;
+
+   uint32_t result = ((b->p)[0] >> --(b->bits_left)) & 0x01;
+   if (!b->bits_left)
+   {
+      b->p++;
+      b->bits_left = 8;
+   }
+   return result;
+}
+
+static inline uint64_t ref_read_ull(bs_t *b, int n)
+{
+   if (bs_eof(b) || n < 1) return 0;
+
+   uint64_t r = 0;
+   while (n--) r |= ((uint64_t)ref_read_u1(b) << n);
+   return r;
+}
+
+static inline uint32_t ref_read_ue(bs_t *b)
+{
+   int i = 0;
+   while ((ref_read_u1(b) == 0) && (i < 32) && !bs_eof(b)) i++;
+
+   int32_t result = (int32_t)ref_read_ull(b, i);
+   result += (1 << i) - 1;
+   return result;
+}
+
+static inline int32_t ref_read_se(bs_t *b)
+{
+   int32_t result = ref_read_ue(b);
+   if (result & 1) result = (result + 1) >> 1;
+   else result = -(result >> 1);
+   return result;
+}
+
+// each workload is instantiated for both readers
+
+#define DEFINE_WORKLOADS(NAME, READ_U, READ_ULL, READ_UE, READ_SE) \
+static uint64_t ts_header_##NAME(bs_t *b) \
+{ \
+   uint64_t sum = 0; \
+   sum += READ_U(b, 8);   /* sync_byte */ \
+   sum += READ_U(b, 1);   /* transport_error_indicator */ \
+   sum += READ_U(b, 1);   /* payload_unit_start_indicator */ \
+   sum += READ_U(b, 1);   /* transport_priority */ \
+   sum += READ_U(b, 13);  /* PID */ \
+   sum += READ_U(b, 2);   /* transport_scrambling_control */ \
+   sum += READ_U(b, 2);   /* adaptation_field_control */ \
+   sum += READ_U(b, 4);   /* continuity_counter */ \
+   sum += READ_U(b, 8);   /* adaptation_field_length */ \
+   for (int i = 0; i < 8; i++) sum += READ_U(b, 1); /* AF flags */ \
+   sum += READ_ULL(b, 33); /* program_clock_reference_base */ \
+   sum += READ_U(b, 6);   /* reserved */ \
+   sum += READ_U(b, 9);   /* program_clock_reference_extension */ \
+   return sum; \
+} \
+static uint64_t pes_header_##NAME(bs_t *b) \
+{ \
+   uint64_t sum = 0; \
+   sum += READ_U(b, 24);  /* packet_start_code_prefix */ \
+   sum += READ_U(b, 8);   /* stream_id */ \
+   sum += READ_U(b, 16);  /* PES_packet_length */ \
+   sum += READ_U(b, 2);   /* '10' */ \
+   sum += READ_U(b, 2);   /* PES_scrambling_control */ \
+   for (int i = 0; i < 12; i++) sum += READ_U(b, 1); /* flags */ \
+   sum += READ_U(b, 8);   /* PES_header_data_length */ \
+   for (int i = 0; i < 2; i++) /* PTS, DTS */ \
+   { \
+      sum += READ_U(b, 4); \
+      uint64_t ts = READ_ULL(b, 3) << 30; (void)READ_U(b, 1); \
+      ts |= READ_ULL(b, 15) << 15; (void)READ_U(b, 1); \
+      ts |= READ_ULL(b, 15); (void)READ_U(b, 1); \
+      sum += ts; \
+   } \
+   return sum; \
+} \
+static uint64_t slice_header_##NAME(bs_t *b) \
+{ \
+   uint64_t sum = 0; \
+   sum += READ_U(b, 1);   /* forbidden_zero_bit */ \
+   sum += READ_U(b, 2);   /* nal_ref_idc */ \
+   sum += READ_U(b, 5);   /* nal_unit_type */ \
+   sum += READ_UE(b);     /* first_mb_in_slice */ \
+   sum += READ_UE(b);     /* slice_type */ \
+   sum += READ_UE(b);     /* pic_parameter_set_id */ \
+   sum += READ_U(b, 8);   /* frame_num */ \
+   sum += READ_U(b, 1);   /* field_pic_flag */ \
+   sum += READ_UE(b);     /* idr_pic_id */ \
+   sum += READ_U(b, 8);   /* pic_order_cnt_lsb */ \
+   sum += READ_SE(b);     /* delta_pic_order_cnt_bottom */ \
+   sum += READ_U(b, 1);   /* num_ref_idx_active_override_flag */ \
+   sum += READ_U(b, 1);   /* ref_pic_list_modification_flag */ \
+   sum += READ_U(b, 1);   /* adaptive_ref_pic_marking_mode_flag */ \
+   sum += READ_UE(b);     /* cabac_init_idc */ \
+   sum += READ_SE(b);     /* slice_qp_delta */ \
+   sum += READ_UE(b);     /* disable_deblocking_filter_idc */ \
+   sum += READ_SE(b);     /* slice_alpha_c0_offset_div2 */ \
+   sum += READ_SE(b);     /* slice_beta_offset_div2 */ \
+   return sum; \
+}
+
+#define BS_READ_U(b, n)    bs_read_u(b, n)
+#define REF_READ_U(b, n)   ((uint32_t)ref_read_ull(b, n))
+
+DEFINE_WORKLOADS(bs,  BS_READ_U,  bs_read_ull,  bs_read_ue,  bs_read_se)
+DEFINE_WORKLOADS(ref, REF_READ_U, ref_read_ull, ref_read_ue, ref_read_se)
+
+typedef uint64_t (*workload_t)(bs_t *);
+
+static double now_ns()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// parses one header at every 188-byte offset (shifted by a few bits to exercise unaligned reads)
+static double run(workload_t w, uint8_t *buf, int iterations, uint64_t *checksum)
+{
+   uint64_t sum = 0;
+   double start = now_ns();
+   for (int it = 0; it < iterations; it++)
+   {
+      for (int i = 0; i < TS_BENCH_PACKETS; i++)
+      {
+         bs_t b;
+         bs_init(&b, buf + i * 188, 188);
+         b.bits_left = 8 - (i & 0x03);
+         sum += w(&b);
+         sum += bs_pos(&b);
+      }
+   }
+   double elapsed = now_ns() - start;
+   *checksum = sum;
+   return elapsed / ((double)iterations * TS_BENCH_PACKETS);
+}
+
+int main(int argc, char *argv[])
+{
+   int iterations = (argc > 1) ? atoi(argv[1]) : 200;
+   if (iterations < 1) iterations = 1;
+
+   uint8_t *buf = malloc(BENCH_BUF_SIZE);
+   srand(0x47);
+   for (int i = 0; i < BENCH_BUF_SIZE; i++) buf[i] = rand() & 0xFF;
+
+   struct
+   {
+      const char *name;
+      workload_t bs;
+      workload_t ref;
+   } workloads[] = {
+      { "TS header + PCR",    ts_header_bs,    ts_header_ref },
+      { "PES header + PTS/DTS", pes_header_bs, pes_header_ref },
+      { "AVC slice header",   slice_header_bs, slice_header_ref },
+   };
+
+   int status = EXIT_SUCCESS;
+   printf("%-22s %12s %12s %8s\n", "workload", "bit (ns)", "word (ns)", "speedup");
+   for (int i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+   {
+      uint64_t sum_ref = 0, sum_bs = 0;
+      double t_ref = run(workloads[i].ref, buf, iterations, &sum_ref);
+      double t_bs = run(workloads[i].bs, buf, iterations, &sum_bs);
+
+      printf("%-22s %12.2f %12.2f %7.2fx%s\n", workloads[i].name, t_ref, t_bs, t_ref / t_bs,
+             (sum_ref == sum_bs) ? "" : "  MISMATCH");
+      if (sum_ref != sum_bs) status = EXIT_FAILURE;
+   }
+
+   free(buf);
+   return status;
+}
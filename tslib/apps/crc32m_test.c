@@ -0,0 +1,166 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Bit-exactness test for the slice-by-8 CRC-32/MPEG-2 kernel in crc32m.c.
+ *
+ * Compares crc_update() against a bit-at-a-time reference and against the
+ * original byte-wise table lookup for every length up to a few PSI sections,
+ * at every alignment and when split across several calls.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "crc32m.h"
+#include "test_macros.h"
+
+#define CRC32M_POLY     0x04c11db7
+#define MAX_TEST_LEN    4096
+
+static crc_t byte_table[256];
+static uint8_t test_buf[MAX_TEST_LEN + 8];
+
+static crc_t crc_update_bitwise(crc_t crc, const unsigned char *data, size_t data_len)
+{
+   while (data_len--)
+   {
+      crc ^= (crc_t)(*data++) << 24;
+      for (int i = 0; i < 8; i++)
+      {
+         crc = (crc & 0x80000000) ? (crc << 1) ^ CRC32M_POLY : (crc << 1);
+      }
+   }
+   return crc;
+}
+
+static void init_byte_table(void)
+{
+   for (int i = 0; i < 256; i++)
+   {
+      uint8_t b = i;
+      byte_table[i] = crc_update_bitwise(0, &b, 1);
+   }
+}
+
+// the pre slice-by-8 implementation
+static crc_t crc_update_bytewise(crc_t crc, const unsigned char *data, size_t data_len)
+{
+   while (data_len--)
+   {
+      crc = byte_table[((crc >> 24) ^ *data++) & 0xff] ^ (crc << 8);
+   }
+   return crc;
+}
+
+START_TEST (test_check_value)
+{
+   const char *check = "123456789";
+   crc_t crc = crc_finalize(crc_update(crc_init(), (const unsigned char *)check, strlen(check)));
+   fail_unless2(crc == 0x0376e6e7, "wrong check value", "0x%08x", crc);
+}
+END_TEST
+
+START_TEST (test_all_lengths)
+{
+   for (size_t offset = 0; offset < 8; offset++)
+   {
+      for (size_t len = 0; len <= MAX_TEST_LEN; len++)
+      {
+         const unsigned char *data = test_buf + offset;
+         crc_t expected = crc_update_bytewise(crc_init(), data, len);
+         crc_t crc = crc_update(crc_init(), data, len);
+         if (crc != expected || crc != crc_update_bitwise(crc_init(), data, len))
+         {
+            fail_unless2(0, "mismatch", "offset=%zu len=%zu 0x%08x != 0x%08x", offset, len, crc, expected);
+            return rc;
+         }
+      }
+   }
+}
+END_TEST
+
+START_TEST (test_split_updates)
+{
+   for (size_t len = 0; len <= 1024; len++)
+   {
+      crc_t expected = crc_update(crc_init(), test_buf, len);
+      for (size_t split = 0; split <= len; split += 7)
+      {
+         crc_t crc = crc_update(crc_init(), test_buf, split);
+         crc = crc_update(crc, test_buf + split, len - split);
+         if (crc != expected)
+         {
+            fail_unless2(0, "mismatch", "len=%zu split=%zu", len, split);
+            return rc;
+         }
+      }
+   }
+}
+END_TEST
+
+START_TEST (test_section_residue)
+{
+   // running the CRC over a section including its CRC_32 field yields zero
+   for (size_t len = 0; len <= 1021; len++)
+   {
+      uint8_t section[1024 + 4];
+      memcpy(section, test_buf, len);
+      crc_t crc = crc_finalize(crc_update(crc_init(), section, len));
+      section[len] = crc >> 24;
+      section[len + 1] = crc >> 16;
+      section[len + 2] = crc >> 8;
+      section[len + 3] = crc;
+      if (crc_update(crc_init(), section, len + 4) != 0)
+      {
+         fail_unless2(0, "non-zero residue", "len=%zu", len);
+         return rc;
+      }
+   }
+}
+END_TEST
+
+int main(int argc, char** argv)
+{
+   int _testnum = 1;
+   uint32_t seed = 0x12345678;
+
+   init_byte_table();
+   for (size_t i = 0; i < sizeof(test_buf); i++)
+   {
+      seed = seed * 1103515245 + 12345;
+      test_buf[i] = seed >> 16;
+   }
+
+   ok( test_check_value() ,     "check value");
+   ok( test_all_lengths() ,     "all lengths and alignments");
+   ok( test_split_updates() ,   "split updates");
+   ok( test_section_residue() , "section residue");
+
+   return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for the H.264 start code scanner.
+ *
+ * Splits an Annex B buffer into NAL units with find_nal_units() (one pass)
+ * and with the find_nal_unit() loop used by h264_analyze, checks that both
+ * find the same NAL units and reports the scan rate.  Both use the same start
+ * code scanner (SIMD where available), so the difference is the cost of
+ * scanning one NAL unit per call.  The buffer is read from a file if one is given -- use a run of
+ * real 1080p I-frames -- otherwise it is synthesized: 1080p-sized I-frames of
+ * random slice data with emulation prevention applied, which is as close to
+ * incompressible CABAC output as it gets.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "h264_stream.h"
+
+#define SYNTH_FRAMES          8
+#define SYNTH_SLICES          8        // slices per frame
+#define SYNTH_SLICE_SIZE      (32 * 1024)
+#define MAX_NALS              (64 * 1024)
+
+static double now_ns()
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int put_nal(uint8_t *buf, int pos, uint8_t header, int payload_size, int long_start_code)
+{
+   if (long_start_code) buf[pos++] = 0x00;
+   buf[pos++] = 0x00;
+   buf[pos++] = 0x00;
+   buf[pos++] = 0x01;
+   buf[pos++] = header;
+
+   int zeros = 0;
+   for (int i = 0; i < payload_size; i++)
+   {
+      uint8_t byte = rand() & 0xFF;
+      if (zeros >= 2 && byte <= 0x03)
+      {
+         buf[pos++] = 0x03;   // emulation_prevention_three_byte
+         zeros = 0;
+      }
+      buf[pos++] = byte;
+      zeros = (byte == 0) ? zeros + 1 : 0;
+   }
+   buf[pos++] = 0x80;   // rbsp_stop_one_bit
+   return pos;
+}
+
+static uint8_t *synthesize(int *size)
+{
+   // worst case every third byte is an emulation prevention byte
+   int capacity = SYNTH_FRAMES * (SYNTH_SLICES * (SYNTH_SLICE_SIZE * 3 / 2 + 16) + 1024);
+   uint8_t *buf = malloc(capacity);
+   int pos = 0;
+
+   srand(0x47);
+   for (int f = 0; f < SYNTH_FRAMES; f++)
+   {
+      pos = put_nal(buf, pos, 0x09, 1, 1);     // access unit delimiter
+      pos = put_nal(buf, pos, 0x67, 24, 1);    // SPS
+      pos = put_nal(buf, pos, 0x68, 4, 1);     // PPS
+      pos = put_nal(buf, pos, 0x06, 16, 0);    // SEI
+      for (int s = 0; s < SYNTH_SLICES; s++)
+      {
+         pos = put_nal(buf, pos, 0x65, SYNTH_SLICE_SIZE, 0);
+      }
+   }
+
+   *size = pos;
+   return buf;
+}
+
+static uint8_t *read_file(const char *path, int *size)
+{
+   FILE *f = fopen(path, "rb");
+   if (f == NULL) return NULL;
+
+   fseek(f, 0, SEEK_END);
+   long len = ftell(f);
+   fseek(f, 0, SEEK_SET);
+
+   uint8_t *buf = malloc(len > 0 ? len : 1);
+   if (len <= 0 || fread(buf, 1, len, f) != (size_t)len)
+   {
+      free(buf);
+      fclose(f);
+      return NULL;
+   }
+   fclose(f);
+
+   *size = (int)len;
+   return buf;
+}
+
+// the h264_analyze loop: each call returns the next NAL unit, the last one is not returned
+static int scan_find_nal_unit(uint8_t *buf, int size, int *nal_start, int *nal_end)
+{
+   int n = 0;
+   int off = 0;
+   int start, end;
+   while (n < MAX_NALS && find_nal_unit(buf + off, size - off, &start, &end) > 0)
+   {
+      nal_start[n] = off + start;
+      nal_end[n] = off + end;
+      n++;
+      off += end;
+   }
+   return n;
+}
+
+int main(int argc, char *argv[])
+{
+   int iterations = (argc > 1) ? atoi(argv[1]) : 20;
+   if (iterations < 1) iterations = 1;
+
+   int size = 0;
+   uint8_t *buf = (argc > 2) ? read_file(argv[2], &size) : synthesize(&size);
+   if (buf == NULL)
+   {
+      fprintf(stderr, "could not read %s\n", argv[2]);
+      return EXIT_FAILURE;
+   }
+
+   int *ref_start = malloc(MAX_NALS * sizeof(int));
+   int *ref_end = malloc(MAX_NALS * sizeof(int));
+   int *nal_start = malloc(MAX_NALS * sizeof(int));
+   int *nal_end = malloc(MAX_NALS * sizeof(int));
+   int n_ref = 0, n = 0;
+
+   double start = now_ns();
+   for (int it = 0; it < iterations; it++) n_ref = scan_find_nal_unit(buf, size, ref_start, ref_end);
+   double t_ref = (now_ns() - start) / iterations;
+
+   start = now_ns();
+   for (int it = 0; it < iterations; it++) n = find_nal_units(buf, size, nal_start, nal_end, MAX_NALS);
+   double t_new = (now_ns() - start) / iterations;
+
+   // find_nal_unit does not return the last NAL unit in the buffer
+   int match = (n == n_ref + 1 || (n == MAX_NALS && n_ref == MAX_NALS));
+   for (int i = 0; match && i < n_ref; i++)
+   {
+      match = (nal_start[i] == ref_start[i] && nal_end[i] == ref_end[i]);
+   }
+
+   printf("%d bytes, %d NAL units%s\n", size, n, (argc > 2) ? "" : " (synthetic 1080p I-frames)");
+   printf("%-18s %12s %10s\n", "scanner", "ms/buffer", "MB/s");
+   printf("%-18s %12.3f %10.1f\n", "find_nal_unit", t_ref / 1e6, size / (t_ref / 1e3));
+   printf("%-18s %12.3f %10.1f %7.2fx%s\n", "find_nal_units", t_new / 1e6, size / (t_new / 1e3),
+          t_ref / t_new, match ? "" : "  MISMATCH");
+
+   free(ref_start);
+   free(ref_end);
+   free(nal_start);
+   free(nal_end);
+   free(buf);
+   return match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
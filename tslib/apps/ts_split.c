@@ -42,6 +42,7 @@
 #include "log.h"
 #include "pes.h"
 #include "tpes.h"
+#include "ts_source.h"
 #include "vqarray.h"
 
 
@@ -79,7 +80,7 @@ int pes_processor(pes_packet_t *pes, elementary_stream_info_t *esi, vqarray_t* t
    //pes_print(pes, NULL, 0);
 #endif 
 
-   if ( fout != NULL ) 
+   if ( fout != NULL && pes_flatten(pes) ) 
    {
       fwrite(pes->payload, pes->payload_len, 1, fout); 
    }
@@ -136,7 +137,7 @@ int pmt_processor_split(mpeg2ts_program_t *m2p, void *arg)
             demux_handler->arg_destructor = (arg_destructor_t)pes_demux_free;   
             
             // hook PID processor to PID  
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, NULL); 
+            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, NULL, 0); 
             
          }         
       }
@@ -200,10 +201,9 @@ int main(int argc, char *argv[])
       return 1;
    }
    
-   FILE *infile = NULL; 
-   if ((infile = fopen(fname, "rb")) == NULL) 
+   ts_source_t *source = NULL; 
+   if ((source = ts_source_new_file(fname)) == NULL) 
    {
-      LOG_ERROR_ARGS("Cannot open file %s - %s", fname, strerror(errno)); 
       return 1;
    }
    
@@ -216,22 +216,26 @@ int main(int argc, char *argv[])
    
    m2s->pat_processor = pat_processor_split; 
    
-   int num_packets = 4096;  
-   uint8_t *ts_buf = malloc(TS_SIZE * 4096); 
+   int num_packets = 0;  
+   uint8_t *packets[TS_SOURCE_MAX_PACKETS]; 
+   ts_pool_t *ts_pool = ts_pool_new(TS_POOL_DEFAULT_SLAB_SIZE); 
    
-   while ((num_packets = fread(ts_buf, TS_SIZE, 4096, infile)) > 0) 
+   while ((num_packets = ts_source_acquire(source, packets, TS_SOURCE_MAX_PACKETS)) > 0) 
    {
       for (int i = 0; i < num_packets; i++) 
       {
-         ts_packet_t *ts = ts_new(); 
-         ts_read(ts, ts_buf + i * TS_SIZE, TS_SIZE); 
+         ts_packet_t *ts = ts_pool_get(ts_pool); 
+         ts_read_inplace(ts, packets[i], TS_SIZE); 
          mpeg2ts_stream_read_ts_packet(m2s, ts);
       }
+      ts_source_release(source, num_packets); 
    }
    
+   // frees queued packets, so must precede the pool
    mpeg2ts_stream_free(m2s); 
+   ts_pool_free(ts_pool); 
    
-   fclose(infile); 
+   ts_source_free(source); 
    
    return tslib_errno;
 }
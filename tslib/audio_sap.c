@@ -0,0 +1,173 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "audio_sap.h"
+
+
+/**
+ * AC-3 syncframe size in 16-bit words by frmsizecod and fscod (48, 44.1, 32 kHz), A/52 Table 5.18
+ */
+static const uint16_t g_ac3_frame_words[38][3] =
+{
+   {   64,   69,   96 },   //  32 kbps
+   {   64,   70,   96 },   //  32 kbps
+   {   80,   87,  120 },   //  40 kbps
+   {   80,   88,  120 },   //  40 kbps
+   {   96,  104,  144 },   //  48 kbps
+   {   96,  105,  144 },   //  48 kbps
+   {  112,  121,  168 },   //  56 kbps
+   {  112,  122,  168 },   //  56 kbps
+   {  128,  139,  192 },   //  64 kbps
+   {  128,  140,  192 },   //  64 kbps
+   {  160,  174,  240 },   //  80 kbps
+   {  160,  175,  240 },   //  80 kbps
+   {  192,  208,  288 },   //  96 kbps
+   {  192,  209,  288 },   //  96 kbps
+   {  224,  243,  336 },   // 112 kbps
+   {  224,  244,  336 },   // 112 kbps
+   {  256,  278,  384 },   // 128 kbps
+   {  256,  279,  384 },   // 128 kbps
+   {  320,  348,  480 },   // 160 kbps
+   {  320,  349,  480 },   // 160 kbps
+   {  384,  417,  576 },   // 192 kbps
+   {  384,  418,  576 },   // 192 kbps
+   {  448,  487,  672 },   // 224 kbps
+   {  448,  488,  672 },   // 224 kbps
+   {  512,  557,  768 },   // 256 kbps
+   {  512,  558,  768 },   // 256 kbps
+   {  640,  696,  960 },   // 320 kbps
+   {  640,  697,  960 },   // 320 kbps
+   {  768,  835, 1152 },   // 384 kbps
+   {  768,  836, 1152 },   // 384 kbps
+   {  896,  975, 1344 },   // 448 kbps
+   {  896,  976, 1344 },   // 448 kbps
+   { 1024, 1114, 1536 },   // 512 kbps
+   { 1024, 1115, 1536 },   // 512 kbps
+   { 1152, 1253, 1728 },   // 576 kbps
+   { 1152, 1254, 1728 },   // 576 kbps
+   { 1280, 1393, 1920 },   // 640 kbps
+   { 1280, 1394, 1920 },   // 640 kbps
+};
+
+// each frame_size function returns the size of the frame whose header starts at buf, or 0 if the
+// header is not valid for the format; the sync word has already been matched
+
+static int adts_frame_size(const uint8_t *buf)
+{
+   // protection_absent is the last bit of the second byte; aac_frame_length(13) includes the header
+   int header_size = (buf[1] & 0x01) ? 7 : 9;
+   int frame_size = ((buf[3] & 0x03) << 11) | (buf[4] << 3) | (buf[5] >> 5);
+   return (frame_size >= header_size) ? frame_size : 0;
+}
+
+static int loas_frame_size(const uint8_t *buf)
+{
+   // syncword(11), audioMuxLengthBytes(13)
+   int mux_length = ((buf[1] & 0x1F) << 8) | buf[2];
+   return (mux_length > 0) ? 3 + mux_length : 0;
+}
+
+static int ac3_frame_size(const uint8_t *buf)
+{
+   // syncword(16), crc1(16), fscod(2), frmsizecod(6), bsid(5)
+   int fscod = buf[4] >> 6;
+   int frmsizecod = buf[4] & 0x3F;
+   int bsid = buf[5] >> 3;
+   if (bsid > 10 || fscod == 3 || frmsizecod >= 38) return 0;
+   return 2 * g_ac3_frame_words[frmsizecod][fscod];
+}
+
+static int eac3_frame_size(const uint8_t *buf)
+{
+   // syncword(16), strmtyp(2), substreamid(3), frmsiz(11), fscod(2), ..., bsid(5)
+   int strmtyp = buf[2] >> 6;
+   int frmsiz = ((buf[2] & 0x07) << 8) | buf[3];
+   int bsid = buf[5] >> 3;
+   if (bsid < 11 || bsid > 16 || strmtyp == 3) return 0;
+   return 2 * (frmsiz + 1);
+}
+
+typedef struct
+{
+   uint32_t format;
+   uint16_t sync_mask;          // applied to the first two bytes, big-endian
+   uint16_t sync_value;
+   int header_size;             // bytes the frame_size function reads
+   int (*frame_size)(const uint8_t *buf);
+} audio_sync_format_t;
+
+static const audio_sync_format_t g_audio_sync_formats[] =
+{
+   { AUDIO_SYNC_ADTS, 0xFFF6, 0xFFF0, 7, adts_frame_size },   // syncword 0xFFF, layer 00
+   { AUDIO_SYNC_LOAS, 0xFFE0, 0x56E0, 3, loas_frame_size },   // syncword 0x2B7
+   { AUDIO_SYNC_AC3,  0xFFFF, 0x0B77, 6, ac3_frame_size },
+   { AUDIO_SYNC_EAC3, 0xFFFF, 0x0B77, 6, eac3_frame_size },
+};
+
+static int audio_sync_frame_size(const audio_sync_format_t *f, const uint8_t *buf, size_t len)
+{
+   if (len < (size_t)f->header_size) return 0;
+   if ((((buf[0] << 8) | buf[1]) & f->sync_mask) != f->sync_value) return 0;
+   return f->frame_size(buf);
+}
+
+int audio_sap_classify(uint32_t formats, const uint8_t *buf, size_t len, audio_sap_info_t *info)
+{
+   audio_sap_info_t local_info;
+   if (info == NULL) info = &local_info;
+
+   info->sap_type = SAP_TYPE_NONE;
+   info->format = 0;
+   info->frame_size = 0;
+   info->frames_checked = 0;
+
+   if (buf == NULL) return SAP_TYPE_NONE;
+
+   for (int i = 0; i < sizeof(g_audio_sync_formats) / sizeof(g_audio_sync_formats[0]); i++)
+   {
+      const audio_sync_format_t *f = &g_audio_sync_formats[i];
+      if (!(formats & f->format)) continue;
+
+      int frame_size = audio_sync_frame_size(f, buf, len);
+      if (frame_size == 0) continue;
+
+      info->format = f->format;
+      info->frame_size = frame_size;
+      info->frames_checked = 1;
+
+      // the frame may run past the end of the PES packet, or leave too little for another header
+      if (len >= (size_t)frame_size + f->header_size)
+      {
+         if (audio_sync_frame_size(f, buf + frame_size, len - frame_size) == 0) continue;
+         info->frames_checked = 2;
+      }
+
+      info->sap_type = 1;
+      return info->sap_type;
+   }
+
+   return SAP_TYPE_NONE;
+}
@@ -0,0 +1,77 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TSLIB_AUDIO_SAP_H_
+#define _TSLIB_AUDIO_SAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "video_sap.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Audio frame sync formats, combined into a mask of the formats a stream type may carry
+ */
+#define AUDIO_SYNC_ADTS     0x01   /// ISO/IEC 13818-7 ADTS (MPEG-2 AAC)
+#define AUDIO_SYNC_LOAS     0x02   /// ISO/IEC 14496-3 LOAS AudioSyncStream carrying LATM (MPEG-4 AAC)
+#define AUDIO_SYNC_AC3      0x04   /// ATSC A/52 AC-3 syncframe, bsid <= 10
+#define AUDIO_SYNC_EAC3     0x08   /// ATSC A/52 Annex E E-AC-3 syncframe, bsid 11..16
+
+/**
+ * Details of what the audio SAP classifier found at the start of a PES payload.
+ */
+typedef struct
+{
+   int sap_type;            /// 1, or SAP_TYPE_NONE
+   uint32_t format;         /// AUDIO_SYNC_* of the first frame, 0 if no format matched
+   int frame_size;          /// of the first frame in bytes, 0 if no format matched
+   int frames_checked;      /// number of consecutive valid frames found (0..2)
+} audio_sap_info_t;
+
+/**
+ * Checks that an audio PES payload starts with a frame of one of the given formats: the sync
+ * word and the frame length coded in the header must be valid, and if the payload is long
+ * enough to hold the header of a second frame, a valid header of the same format must follow
+ * exactly one frame length later.  Every audio frame is independently decodable, so a payload
+ * that starts with a frame is SAP type 1.  Only the frame headers are read; nothing is
+ * allocated.
+ *
+ * @param formats mask of AUDIO_SYNC_* formats to try
+ * @param info optional, receives the details
+ * @return 1, or SAP_TYPE_NONE
+ */
+int audio_sap_classify(uint32_t formats, const uint8_t *buf, size_t len, audio_sap_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _TSLIB_AUDIO_SAP_H_
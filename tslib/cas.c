@@ -75,6 +75,7 @@ int ca_system_process_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_in
          if (ep != NULL) 
          {
             if (ep->PID == ts->header.PID) ts_free(ep->ecm); 
+            ts_detach(ts); 
             ep->ecm = ts; 
             return 1;
          }            
@@ -31,26 +31,41 @@
 #include "descriptors.h"
 #include "log.h"
 
-#include <hashtable.h>
-#include <hashtable_str.h>
-
 #include "ATSTestReport.h"
 
 
-DEFINE_HASHTABLE_INSERT(descriptor_table_insert, uint32_t, descriptor_table_entry_t);
-DEFINE_HASHTABLE_SEARCH(descriptor_table_search, uint32_t, descriptor_table_entry_t);
-DEFINE_HASHTABLE_REMOVE(descriptor_table_remove, uint32_t, descriptor_table_entry_t);
+#define DESCRIPTOR_TABLE_SIZE 256
+
+// indexed by tag; defined with the known descriptors at the end of this file
+static descriptor_table_entry_t g_descriptor_table[DESCRIPTOR_TABLE_SIZE];
+static int g_descriptor_table_frozen = 0;
+
+int register_descriptor(const descriptor_table_entry_t *desc)
+{
+   if (desc == NULL || desc->tag >= DESCRIPTOR_TABLE_SIZE) return 0;
+   if (g_descriptor_table_frozen)
+   {
+      LOG_ERROR_ARGS("register_descriptor: descriptor registry is frozen, cannot register tag 0x%x", desc->tag);
+      return 0;
+   }
+
+   g_descriptor_table[desc->tag] = *desc;
+   return 1;
+}
 
-static hashtable_t *g_descriptor_table = NULL;
+void freeze_descriptors()
+{
+   g_descriptor_table_frozen = 1;
+}
 
-int register_descriptor(descriptor_table_entry_t *desc)
+const descriptor_table_entry_t* lookup_descriptor(uint32_t tag)
 {
-   descriptor_table_remove(g_descriptor_table, &desc->tag);
-   return descriptor_table_insert(g_descriptor_table, &desc->tag, desc);
+   if (tag >= DESCRIPTOR_TABLE_SIZE || g_descriptor_table[tag].read_descriptor == NULL) return NULL;
+   return &g_descriptor_table[tag];
 }
 
 // "factory methods"
-int read_descriptor_loop(vqarray_t *desc_list, bs_t *b, int length) 
+int read_descriptor_loop(vqarray_t *desc_list, bs_t *b, int length, arena_t *arena) 
 { 
    LOG_DEBUG_ARGS ("read_descriptor_loop: length = %d", length);
    int desc_start = bs_pos(b); 
@@ -58,8 +73,7 @@ int read_descriptor_loop(vqarray_t *desc_list, bs_t *b, int length)
    while (length > bs_pos(b) - desc_start) 
    {
       LOG_DEBUG_ARGS ("read_descriptor_loop: START bs_pos(b)= %d", bs_pos(b));
-      descriptor_t *desc = descriptor_new(); 
-      desc = descriptor_read(desc, b); 
+      descriptor_t *desc = descriptor_read(b, arena); 
       vqarray_add(desc_list, desc);
       LOG_DEBUG_ARGS ("read_descriptor_loop: END bs_pos(b)= %d", bs_pos(b));
    }
@@ -84,62 +98,32 @@ int print_descriptor_loop(vqarray_t *desc_list, int level, char *str, size_t str
    return bytes;
 }
 
-descriptor_t* descriptor_new() 
-{ 
-   descriptor_t *desc = malloc(sizeof(descriptor_t)); 
-   return desc;
-}
-
-void descriptor_free(descriptor_t *desc) 
+descriptor_t* descriptor_read(bs_t *b, arena_t *arena) 
 { 
-   if (desc == NULL) return;
-   descriptor_table_entry_t *dte =
-         descriptor_table_search(g_descriptor_table, &desc->tag);
-   if (dte == NULL) return;
+   if (b == NULL || arena == NULL) return NULL;
 
-   dte->free_descriptor(desc);
-}
-
-descriptor_t* descriptor_read(descriptor_t *desc, bs_t *b) 
-{ 
-   descriptor_t *retVal = NULL;
-
-   desc->tag = bs_read_u8(b);
-   desc->length = bs_read_u8(b);
+   descriptor_t desc;
+   desc.tag = bs_read_u8(b);
+   desc.length = bs_read_u8(b);
 
-   LOG_DEBUG_ARGS ("descriptor_read: tag = %d, length = %d", desc->tag, desc->length);
-//   printf ("descriptor_read: tag = %d, length = %d\n", desc->tag, desc->length);
-/*   for (int i=0; i<desc->length; i++)
-   {
-      printf ("0x%x ", b->p[i]);
-   }
-   printf ("\n");
-   */
+   LOG_DEBUG_ARGS ("descriptor_read: tag = %d, length = %d", desc.tag, desc.length);
 
-   if (desc == NULL || b == NULL) return NULL;
-   descriptor_table_entry_t *dte =
-         descriptor_table_search(g_descriptor_table, &desc->tag);
-   
-   if (dte != NULL)
+   const descriptor_table_entry_t *dte = lookup_descriptor(desc.tag);
+   if (dte == NULL)
    {
-      retVal = dte->read_descriptor(desc, b);
-   }
-   else
-   {
-      LOG_DEBUG_ARGS ("skipping descriptor: tag = %d, length = %d", desc->tag, desc->length);
-//      printf ("skipping descriptor: %d\n", desc->length);
-      bs_skip_bytes(b, desc->length);
+      LOG_DEBUG_ARGS ("skipping descriptor: tag = %d, length = %d", desc.tag, desc.length);
+      bs_skip_bytes(b, desc.length);
+      return NULL;
    }
 
-   return retVal;
+   return dte->read_descriptor(&desc, b, arena);
 }
 
 int descriptor_print(const descriptor_t *desc, int level, char *str, size_t str_len) 
 { 
    if (desc == NULL || str == NULL || str_len < 2 || tslib_loglevel < TSLIB_LOG_LEVEL_INFO) return 0; 
    int bytes = 0; 
-   descriptor_table_entry_t *dte =
-         descriptor_table_search(g_descriptor_table, (uint32_t*)&desc->tag);
+   const descriptor_table_entry_t *dte = lookup_descriptor(desc->tag);
 
    if (dte != NULL)
    {
@@ -154,35 +138,7 @@ int descriptor_print(const descriptor_t *desc, int level, char *str, size_t str_
    return bytes;
 }
 
-descriptor_t* language_descriptor_new(descriptor_t *desc) 
-{ 
-   language_descriptor_t *ld = NULL; 
-   if (desc == NULL) 
-   {
-      ld = (language_descriptor_t *)calloc(1, sizeof(language_descriptor_t)); 
-      ld->descriptor.tag = ISO_639_LANGUAGE_DESCRIPTOR;
-   } 
-   else 
-   {
-      ld = realloc(desc, sizeof(language_descriptor_t)); 
-      ld->languages = NULL; 
-      ld->num_languages = 0;
-   }
-   return (descriptor_t *)ld;
-}
-
-int language_descriptor_free(descriptor_t *desc)
-{ 
-   if (desc == NULL) return 0;
-   if (desc->tag != ISO_639_LANGUAGE_DESCRIPTOR) return 0;
-
-   language_descriptor_t *ld = (language_descriptor_t *)desc;
-   if (ld->languages != NULL) free(ld->languages);
-   free(ld);
-   return 1;
-}
-
-descriptor_t* language_descriptor_read(descriptor_t *desc, bs_t *b) 
+descriptor_t* language_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena) 
 { 
    if ((desc == NULL) || (b == NULL)) 
    {
@@ -199,7 +155,7 @@ descriptor_t* language_descriptor_read(descriptor_t *desc, bs_t *b)
       return NULL;
    }
    
-   language_descriptor_t *ld = (language_descriptor_t *)calloc(1, sizeof(language_descriptor_t)); 
+   language_descriptor_t *ld = (language_descriptor_t *)arena_calloc(arena, 1, sizeof(language_descriptor_t)); 
    
    ld->descriptor.tag = desc->tag; 
    ld->descriptor.length = desc->length; 
@@ -208,7 +164,7 @@ descriptor_t* language_descriptor_read(descriptor_t *desc, bs_t *b)
    
    if (ld->num_languages > 0) 
    {
-      ld->languages = malloc(ld->num_languages * sizeof(language_descriptor_t)); 
+      ld->languages = (iso639_lang_t *)arena_calloc(arena, ld->num_languages, sizeof(iso639_lang_t)); 
       for (int i = 0; i < ld->num_languages; i++) 
       {
          ld->languages[i].ISO_639_language_code[0] = bs_read_u8(b); 
@@ -225,7 +181,6 @@ descriptor_t* language_descriptor_read(descriptor_t *desc, bs_t *b)
       ld->languages[i].ISO_639_language_code[1], ld->languages[i].ISO_639_language_code[2],
       ld->languages[i].audio_type);
    */
-   free(desc); 
    return (descriptor_t *)ld;
 }
 
@@ -253,46 +208,7 @@ int language_descriptor_print(const descriptor_t *desc, int level, char *str, si
 }
 
 
-descriptor_t* component_name_descriptor_new(descriptor_t *desc) 
-{ 
-   component_name_descriptor_t *cnd = NULL; 
-   if (desc == NULL) 
-   {
-      cnd = (component_name_descriptor_t *)calloc(1, sizeof(component_name_descriptor_t)); 
-      cnd->descriptor.tag = COMPONENT_NAME_DESCRIPTOR;
-   } 
-   else 
-   {
-      cnd = realloc(desc, sizeof(component_name_descriptor_t)); 
-      cnd->num_names = 0;
-      cnd->names = NULL; 
-      cnd->languages = NULL; 
-   }
-
-   return (descriptor_t *)cnd;
-}
-
-int component_name_descriptor_free(descriptor_t *desc)
-{ 
-   if (desc == NULL) return 0;
-   if (desc->tag != COMPONENT_NAME_DESCRIPTOR) return 0;
-
-   component_name_descriptor_t *cnd = (component_name_descriptor_t *)desc;
-
-   for (int i=0; i<cnd->num_names; i++)
-   {
-      if (cnd->names[i] != NULL) free (cnd->names[i]);
-   }
-
-   if (cnd->names != NULL) free(cnd->names);
-   if (cnd->languages != NULL) free(cnd->languages);
-
-   free(cnd);
-   
-   return 1;
-}
-
-descriptor_t* component_name_descriptor_read(descriptor_t *desc, bs_t *b) 
+descriptor_t* component_name_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena) 
 { 
    if ((desc == NULL) || (b == NULL)) 
    {
@@ -309,15 +225,15 @@ descriptor_t* component_name_descriptor_read(descriptor_t *desc, bs_t *b)
       return NULL;
    }
    
-   component_name_descriptor_t *cnd = (component_name_descriptor_t *)calloc(1, sizeof(component_name_descriptor_t)); 
+   component_name_descriptor_t *cnd = (component_name_descriptor_t *)arena_calloc(arena, 1, sizeof(component_name_descriptor_t)); 
    
    cnd->descriptor.tag = desc->tag; 
    cnd->descriptor.length = desc->length; 
       
    cnd->num_names = bs_read_u8(b); 
 
-   cnd->languages = (iso639_lang_t*) calloc (cnd->num_names, sizeof(iso639_lang_t));
-   cnd->names = (char **)calloc (cnd->num_names, sizeof(char *));
+   cnd->languages = (iso639_lang_t*) arena_calloc (arena, cnd->num_names, sizeof(iso639_lang_t));
+   cnd->names = (char **)arena_calloc (arena, cnd->num_names, sizeof(char *));
 
    for (int i=0; i<cnd->num_names; i++)
    {
@@ -328,14 +244,19 @@ descriptor_t* component_name_descriptor_read(descriptor_t *desc, bs_t *b)
 
       int totalNumBytes = 0;
       uint8_t num_segments = bs_read_u8(b); 
+      cnd->names[i] = arena_calloc (arena, 1, 1);
       for (int j=0; j< num_segments; j++) 
       {
          uint8_t compression_type = bs_read_u8(b); 
          uint8_t mode = bs_read_u8(b); 
          uint8_t number_bytes = bs_read_u8(b); 
             
-         cnd->names[i] = (char *)realloc (cnd->names[i], totalNumBytes + number_bytes);
-         bs_read_bytes(b, (uint8_t*)(cnd->names[i] + totalNumBytes), number_bytes); 
+         // names are kept NUL-terminated; the arena cannot grow in place, so copy on each segment
+         char *name = (char *)arena_alloc (arena, totalNumBytes + number_bytes + 1);
+         memcpy (name, cnd->names[i], totalNumBytes);
+         bs_read_bytes(b, (uint8_t*)(name + totalNumBytes), number_bytes); 
+         name[totalNumBytes + number_bytes] = 0;
+         cnd->names[i] = name;
 
          totalNumBytes += number_bytes;
 
@@ -370,7 +291,6 @@ descriptor_t* component_name_descriptor_read(descriptor_t *desc, bs_t *b)
    }
    */
 
-   free(desc); 
    return (descriptor_t *)cnd;
 }
 
@@ -391,39 +311,18 @@ int component_name_descriptor_print(const descriptor_t *desc, int level, char *s
 }
 
 
-descriptor_t* ca_descriptor_new(descriptor_t *desc)
-{
-   ca_descriptor_t *cad = NULL;
-   cad = (ca_descriptor_t *)calloc(1, sizeof(ca_descriptor_t));
-   cad->descriptor.tag = CA_DESCRIPTOR;
-   if (desc != NULL) cad->descriptor.length = desc->length;
-   free(desc);
-   return (descriptor_t *)cad;
-}
-
-int ca_descriptor_free(descriptor_t *desc)
-{
-   if (desc == NULL) return 0;
-   if (desc->tag != CA_DESCRIPTOR) return 0;
-
-   ca_descriptor_t *cad = (ca_descriptor_t *)desc;
-   if (cad->private_data_bytes != NULL) free(cad->private_data_bytes);
-
-   free(cad);
-   return 1;
-}
-
-descriptor_t* ca_descriptor_read(descriptor_t *desc, bs_t *b)
+descriptor_t* ca_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena)
 {
    if ((desc == NULL) || (b == NULL)) return NULL;
 
-   ca_descriptor_t *cad = (ca_descriptor_t *)ca_descriptor_new(desc);
+   ca_descriptor_t *cad = (ca_descriptor_t *)arena_calloc(arena, 1, sizeof(ca_descriptor_t));
+   cad->descriptor = *desc;
 
    cad->CA_system_ID = bs_read_u16(b);
    bs_skip_u(b, 3);
    cad->CA_PID = bs_read_u(b, 13);
    cad->_private_data_bytes_buf_len = cad->descriptor.length - 4; // we just read 4 bytes
-   cad->private_data_bytes = malloc(cad->_private_data_bytes_buf_len);
+   cad->private_data_bytes = arena_alloc(arena, cad->_private_data_bytes_buf_len);
    bs_read_bytes(b, cad->private_data_bytes, cad->_private_data_bytes_buf_len);
 
    return (descriptor_t *)cad;
@@ -446,35 +345,12 @@ int ca_descriptor_print(const descriptor_t *desc, int level, char *str, size_t s
    return bytes;
 }
 
-descriptor_t* max_bitrate_descriptor_new(descriptor_t *desc)
-{
-   max_bitrate_descriptor_t *maxbr = NULL;
-   maxbr = (max_bitrate_descriptor_t *)calloc(1, sizeof(max_bitrate_descriptor_t));
-   maxbr->descriptor.tag = MAXIMUM_BITRATE_DESCRIPTOR;
-   if (desc != NULL)
-   {
-      maxbr->descriptor.length = desc->length;
-      free(desc);
-   }
-   return (descriptor_t *)maxbr;
-}
-
-int max_bitrate_descriptor_free(descriptor_t *desc)
-{
-   if (desc == NULL) return 0;
-   if (desc->tag != MAXIMUM_BITRATE_DESCRIPTOR) return 0;
-
-   max_bitrate_descriptor_t *maxbr = (max_bitrate_descriptor_t *)desc;
-   free(maxbr);
-   return 1;
-}
-
-descriptor_t* max_bitrate_descriptor_read(descriptor_t *desc, bs_t *b)
+descriptor_t* max_bitrate_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena)
 {
    if ((desc == NULL) || (b == NULL)) return NULL;
 
-   max_bitrate_descriptor_t *maxbr =
-         (max_bitrate_descriptor_t *)max_bitrate_descriptor_new(desc);
+   max_bitrate_descriptor_t *maxbr = (max_bitrate_descriptor_t *)arena_calloc(arena, 1, sizeof(max_bitrate_descriptor_t));
+   maxbr->descriptor = *desc;
 
 
    bs_skip_u(b, 2);
@@ -528,33 +404,7 @@ if language_flag == 1
   language	(3*8)
 */
 
-descriptor_t* ac3_descriptor_new(descriptor_t *desc) 
-{ 
-   ac3_descriptor_t *ld = NULL; 
-   if (desc == NULL) 
-   {
-      ld = (ac3_descriptor_t *)calloc(1, sizeof(ac3_descriptor_t)); 
-      ld->descriptor.tag = AC3_DESCRIPTOR;
-   } 
-   else 
-   {
-      ld = realloc(desc, sizeof(ac3_descriptor_t)); 
-   }
-   return (descriptor_t *)ld;
-}
-
-int ac3_descriptor_free(descriptor_t *desc)
-{ 
-   if (desc == NULL) return 0;
-   if (desc->tag != AC3_DESCRIPTOR) return 0;
-
-   ac3_descriptor_t *ld = (ac3_descriptor_t *)desc;
-
-   free(ld);
-   return 1;
-}
-
-descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b) 
+descriptor_t* ac3_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena) 
 { 
    if ((desc == NULL) || (b == NULL)) 
    {
@@ -571,7 +421,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
       return NULL;
    }
    
-   ac3_descriptor_t *ac3d = (ac3_descriptor_t *)calloc(1, sizeof(ac3_descriptor_t)); 
+   ac3_descriptor_t *ac3d = (ac3_descriptor_t *)arena_calloc(arena, 1, sizeof(ac3_descriptor_t)); 
    
    ac3d->descriptor.tag = desc->tag; 
    ac3d->descriptor.length = desc->length; 
@@ -591,8 +441,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
    if (remainingBytes == 0)
    {
       LOG_INFO ("AC3 (1) exiting");
-      free(desc); 
-      return (descriptor_t *)ac3d;
+         return (descriptor_t *)ac3d;
    }
    else if (remainingBytes < 0)
    {
@@ -604,8 +453,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
    if (remainingBytes == 0)
    {
       LOG_INFO ("AC3 (2) exiting");
-      free(desc); 
-      return (descriptor_t *)ac3d;
+         return (descriptor_t *)ac3d;
    }
    else if (remainingBytes < 0)
    {
@@ -619,8 +467,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
       if (remainingBytes == 0)
       {
          LOG_INFO ("AC3 (3) exiting");
-         free(desc); 
-         return (descriptor_t *)ac3d;
+               return (descriptor_t *)ac3d;
       }
       else if (remainingBytes < 0)
       {
@@ -642,8 +489,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
    if (remainingBytes == 0)
    {
       LOG_INFO ("AC3 (4) exiting");
-      free(desc); 
-      return (descriptor_t *)ac3d;
+         return (descriptor_t *)ac3d;
    }
    else if (remainingBytes < 0)
    {
@@ -663,8 +509,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
    if (remainingBytes == 0)
    {
       LOG_INFO ("AC3 (5) exiting");
-      free(desc); 
-      return (descriptor_t *)ac3d;
+         return (descriptor_t *)ac3d;
    }
    else if (remainingBytes < 0)
    {
@@ -679,8 +524,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
    if (remainingBytes == 0)
    {
       LOG_INFO ("AC3 (6) exiting");
-      free(desc); 
-      return (descriptor_t *)ac3d;
+         return (descriptor_t *)ac3d;
    }
    else if (remainingBytes < 0)
    {
@@ -697,8 +541,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
       if (remainingBytes == 0)
       {
          LOG_INFO ("AC3 (7) exiting");
-         free(desc); 
-         return (descriptor_t *)ac3d;
+               return (descriptor_t *)ac3d;
       }
    }
    else if (remainingBytes < 0)
@@ -716,8 +559,7 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
       if (remainingBytes == 0)
       {
          LOG_INFO ("AC3 (8) exiting");
-         free(desc); 
-         return (descriptor_t *)ac3d;
+               return (descriptor_t *)ac3d;
       }
       else if (remainingBytes < 0)
       {
@@ -728,7 +570,6 @@ descriptor_t* ac3_descriptor_read(descriptor_t *desc, bs_t *b)
    LOG_INFO_ARGS ("AC3 complete:  remaining bytes = %d", remainingBytes);
    bs_skip_bytes (b, remainingBytes);
 
-   free(desc); 
    return (descriptor_t *)ac3d;
 }
 
@@ -759,57 +600,19 @@ int ac3_descriptor_print(const descriptor_t *desc, int level, char *str, size_t
 }
 
 
-void init_descriptors()
+static descriptor_table_entry_t g_descriptor_table[DESCRIPTOR_TABLE_SIZE] = 
 {
-   if (g_descriptor_table != NULL)
-      return;
-
-   g_descriptor_table =
-         hashtable_new(hashtable_hashfn_uint32, hashtable_eqfn_uint32);
-
-   // Register our known descriptors
-   descriptor_table_entry_t *d;
-
-   // ISO 639 language
-   d = calloc(1, sizeof(descriptor_table_entry_t));
-   d->tag = ISO_639_LANGUAGE_DESCRIPTOR;
-   d->free_descriptor = language_descriptor_free;
-   d->print_descriptor = language_descriptor_print;
-   d->read_descriptor = language_descriptor_read;
-   register_descriptor(d);
-
-   // Component Name Descriptor
-   d = calloc(1, sizeof(descriptor_table_entry_t));
-   d->tag = COMPONENT_NAME_DESCRIPTOR;
-   d->free_descriptor = component_name_descriptor_free;
-   d->print_descriptor = component_name_descriptor_print;
-   d->read_descriptor = component_name_descriptor_read;
-   register_descriptor(d);
-
-   // Component Name Descriptor
-   d = calloc(1, sizeof(descriptor_table_entry_t));
-   d->tag = AC3_DESCRIPTOR;
-   d->free_descriptor = ac3_descriptor_free;
-   d->print_descriptor = ac3_descriptor_print;
-   d->read_descriptor = ac3_descriptor_read;
-   register_descriptor(d);
-
-   // CA descriptor
-   d = calloc(1, sizeof(descriptor_table_entry_t));
-   d->tag = CA_DESCRIPTOR;
-   d->free_descriptor = ca_descriptor_free;
-   d->print_descriptor = ca_descriptor_print;
-   d->read_descriptor = ca_descriptor_read;
-   register_descriptor(d);
-
-   // Max bitrate descriptor
-   d = calloc(1, sizeof(descriptor_table_entry_t));
-   d->tag = MAXIMUM_BITRATE_DESCRIPTOR;
-   d->free_descriptor = max_bitrate_descriptor_free;
-   d->print_descriptor = max_bitrate_descriptor_print;
-   d->read_descriptor = max_bitrate_descriptor_read;
-   register_descriptor(d);
-}
+   [CA_DESCRIPTOR] = 
+      { CA_DESCRIPTOR, ca_descriptor_read, ca_descriptor_print },
+   [ISO_639_LANGUAGE_DESCRIPTOR] = 
+      { ISO_639_LANGUAGE_DESCRIPTOR, language_descriptor_read, language_descriptor_print },
+   [MAXIMUM_BITRATE_DESCRIPTOR] = 
+      { MAXIMUM_BITRATE_DESCRIPTOR, max_bitrate_descriptor_read, max_bitrate_descriptor_print },
+   [AC3_DESCRIPTOR] = 
+      { AC3_DESCRIPTOR, ac3_descriptor_read, ac3_descriptor_print },
+   [COMPONENT_NAME_DESCRIPTOR] = 
+      { COMPONENT_NAME_DESCRIPTOR, component_name_descriptor_read, component_name_descriptor_print },
+};
 
 /*
  2, video_stream_descriptor
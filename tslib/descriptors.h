@@ -36,6 +36,7 @@
 #include "bs.h"
 #include "common.h"
 #include "vqarray.h"
+#include "arena.h"
 #include "log.h"
 
 typedef enum {
@@ -101,33 +102,41 @@ typedef struct {
    uint32_t length;
 } descriptor_t;
 
-typedef descriptor_t* (*descriptor_reader_t)(descriptor_t*, bs_t *);
+// Readers get the descriptor header (tag and length already read from b) and
+// allocate the parsed descriptor, and anything it points to, from the arena of
+// the section being parsed.  Descriptors are released with that arena.
+typedef descriptor_t* (*descriptor_reader_t)(const descriptor_t*, bs_t *, arena_t *);
 typedef int (*descriptor_printer_t)(const descriptor_t *, int, char *, size_t);
-typedef int (*descriptor_destructor_t)(descriptor_t*);
 
 typedef struct {
 	uint32_t tag;
    descriptor_reader_t read_descriptor;
    descriptor_printer_t print_descriptor;
-   descriptor_destructor_t free_descriptor;
 } descriptor_table_entry_t; 
 
-// Must be called to initialize known descriptors and the descriptor
-// registration system
-void init_descriptors();
+// The descriptor registry is a flat table indexed by descriptor tag.  Known
+// descriptors are registered statically; applications register their own
+// (e.g. the EBP descriptor) once at startup and then call freeze_descriptors()
+// before starting any thread that parses PSI.  After that the registry is
+// read-only, so lookups need no locking.
 
-// Register a new descriptor to be parsed by the system
-int register_descriptor(descriptor_table_entry_t *desc);
+// Register a new descriptor to be parsed by the system.  The entry is copied.
+// Returns 0 if the tag is out of range or the registry is already frozen.
+int register_descriptor(const descriptor_table_entry_t *desc);
+
+// Make the registry immutable; later register_descriptor calls fail
+void freeze_descriptors();
+
+// Returns the registered entry for tag, or NULL if there is none
+const descriptor_table_entry_t* lookup_descriptor(uint32_t tag);
 
 // "factory methods"
-int read_descriptor_loop(vqarray_t *desc_list, bs_t *b, int length);
+int read_descriptor_loop(vqarray_t *desc_list, bs_t *b, int length, arena_t *arena);
 int write_descriptor_loop(vqarray_t *desc_list, bs_t *b);
 int print_descriptor_loop(vqarray_t *desc_list, int level, char *str, size_t str_len);
 
 
-descriptor_t* descriptor_new();
-void descriptor_free(descriptor_t* desc);
-descriptor_t* descriptor_read(descriptor_t* desc, bs_t* b);
+descriptor_t* descriptor_read(bs_t* b, arena_t *arena);
 int descriptor_print(const descriptor_t* desc, int level, char* str, size_t str_len);
 
 typedef struct {
@@ -141,9 +150,7 @@ typedef struct {
 	int num_languages;
 } language_descriptor_t;
 
-//descriptor_t* language_descriptor_new(descriptor_t* desc);
-//int language_descriptor_free(descriptor_t* desc);
-//descriptor_t* language_descriptor_read(descriptor_t* desc, bs_t* b);
+//descriptor_t* language_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena);
 //int language_descriptor_print(const descriptor_t* desc, int level, char* str, size_t str_len);
 
 typedef struct {
@@ -186,9 +193,7 @@ typedef struct {
    size_t _private_data_bytes_buf_len;
 } ca_descriptor_t;
 
-//descriptor_t* ca_descriptor_new(descriptor_t *desc);
-//int ca_descriptor_free(descriptor_t *desc);
-//descriptor_t* ca_descriptor_read(descriptor_t *desc, bs_t *b);
+//descriptor_t* ca_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena);
 //int ca_descriptor_print(const descriptor_t *desc, int level, char *str, size_t str_len);
 
 
@@ -197,9 +202,7 @@ typedef struct {
    uint32_t max_bitrate;
 } max_bitrate_descriptor_t;
 
-//descriptor_t* max_bitrate_descriptor_new(descriptor_t *desc);
-//int max_bitrate_descriptor_free(descriptor_t *desc);
-//descriptor_t* max_bitrate_descriptor_read(descriptor_t *desc, bs_t *b);
+//descriptor_t* max_bitrate_descriptor_read(const descriptor_t *desc, bs_t *b, arena_t *arena);
 //int max_bitrate_descriptor_print(const descriptor_t *desc, int level, char *str, size_t str_len);
 
 
@@ -76,7 +76,7 @@ mpeg2ts_program_t* mpeg2ts_program_new(int program_number, int PID)
    m2p->pcr_info.pcr_rate = 0.0; 
    
    m2p->pmt_processor = NULL;
-   m2p->scte128_enabled = 1;
+   m2p->scte128_enabled = 0;
 
    return m2p;
 }
@@ -128,14 +128,21 @@ int mpeg2ts_program_replace_pid_processor(mpeg2ts_program_t *m2p, pid_info_t *pi
    }
    else
    {
+      piNew->scte128_enabled |= piOld->scte128_enabled;
+      piNew->continuity_counter = piOld->continuity_counter;
+      piNew->cc_valid = piOld->cc_valid;
+      piNew->cc_duplicate = piOld->cc_duplicate;
+      piNew->cc_stats = piOld->cc_stats;
       pid_info_free(piOld);
       vqarray_set(m2p->pids, i, piNew);
    }
 
+   mpeg2ts_stream_invalidate_pid_map(m2p->m2s);
    return 0;
 }
 
-int mpeg2ts_program_register_pid_processor(mpeg2ts_program_t *m2p, uint32_t PID, demux_pid_handler_t *handler, demux_pid_handler_t *validator) 
+int mpeg2ts_program_register_pid_processor(mpeg2ts_program_t *m2p, uint32_t PID, demux_pid_handler_t *handler, demux_pid_handler_t *validator,
+                                           int scte128_enabled) 
 { 
    if (m2p == NULL || m2p->pmt == NULL || handler == NULL)
        return 0;
@@ -161,6 +168,7 @@ int mpeg2ts_program_register_pid_processor(mpeg2ts_program_t *m2p, uint32_t PID,
    pid->es_info = esi; 
    pid->demux_handler = handler; 
    if ( validator != NULL ) pid->demux_validator = validator;
+   pid->scte128_enabled = (scte128_enabled != 0);
 
    mpeg2ts_program_replace_pid_processor(m2p, pid);
    
@@ -188,6 +196,7 @@ int mpeg2ts_program_unregister_pid_processor(mpeg2ts_program_t *m2p, uint32_t PI
    pid_info_free(pi); 
    vqarray_remove(m2p->pids, i); 
    
+   mpeg2ts_stream_invalidate_pid_map(m2p->m2s);
    return 0;
 }
 
@@ -232,10 +241,65 @@ mpeg2ts_stream_t* mpeg2ts_stream_new()
 { 
    mpeg2ts_stream_t *m2s = calloc(1, sizeof(mpeg2ts_stream_t)); 
    m2s->programs = vqarray_new(); 
-   init_descriptors();
    return m2s;
 }
 
+void mpeg2ts_stream_invalidate_pid_map(mpeg2ts_stream_t *m2s) 
+{ 
+   if (m2s == NULL) return; 
+   m2s->pid_map_dirty = 1;
+}
+
+static void mpeg2ts_stream_add_pid_owner(mpeg2ts_stream_t *m2s, pid_map_entry_t *entry, uint32_t PID) 
+{ 
+   entry->next = NULL; 
+
+   // append, so that the chain follows PAT order
+   pid_map_entry_t **tail = &(m2s->pid_map[PID & (MPEG2TS_NUM_PIDS - 1)]); 
+   while (*tail != NULL) tail = &((*tail)->next); 
+   *tail = entry;
+}
+
+static void mpeg2ts_stream_rebuild_pid_map(mpeg2ts_stream_t *m2s) 
+{ 
+   memset(m2s->pid_map, 0, sizeof(m2s->pid_map)); 
+   free(m2s->pid_map_entries); 
+   m2s->pid_map_entries = NULL; 
+   m2s->pid_map_dirty = 0; 
+
+   int num_entries = 0; 
+   for (int i = 0; i < vqarray_length(m2s->programs); i++) 
+   {
+      mpeg2ts_program_t *m2p = vqarray_get(m2s->programs, i); 
+      if (m2p == NULL) continue; 
+      num_entries += 1 + vqarray_length(m2p->pids);
+   }
+   if (num_entries == 0) return; 
+
+   m2s->pid_map_entries = calloc(num_entries, sizeof(pid_map_entry_t)); 
+   pid_map_entry_t *entry = m2s->pid_map_entries; 
+
+   for (int i = 0; i < vqarray_length(m2s->programs); i++) 
+   {
+      mpeg2ts_program_t *m2p = vqarray_get(m2s->programs, i); 
+      if (m2p == NULL) continue; 
+
+      entry->m2p = m2p; 
+      entry->pi = NULL; 
+      mpeg2ts_stream_add_pid_owner(m2s, entry++, m2p->PID); 
+
+      for (int j = 0; j < vqarray_length(m2p->pids); j++) 
+      {
+         pid_info_t *pi = vqarray_get(m2p->pids, j); 
+         if (pi == NULL || pi->es_info == NULL) continue; 
+
+         entry->m2p = m2p; 
+         entry->pi = pi; 
+         mpeg2ts_stream_add_pid_owner(m2s, entry++, pi->es_info->elementary_PID);
+      }
+   }
+}
+
 void mpeg2ts_stream_free(mpeg2ts_stream_t *m2s) 
 { 
    if (m2s == NULL) return; 
@@ -244,6 +308,7 @@ void mpeg2ts_stream_free(mpeg2ts_stream_t *m2s)
       vqarray_foreach(m2s->programs, (vqarray_functor_t)mpeg2ts_program_free); 
       vqarray_free(m2s->programs);
    }
+   free(m2s->pid_map_entries); 
    if (m2s->pat != NULL) 
    {
       program_association_section_free(m2s->pat);
@@ -259,6 +324,15 @@ int mpeg2ts_stream_read_cat(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
 { 
    int ret = 0; 
    
+   size_t section_len = 0; 
+   const uint8_t *section = psi_single_packet_section(ts->payload.bytes, ts->payload.len, 
+      ts->header.payload_unit_start_indicator, &(m2s->catBuffer), &section_len); 
+   if (section != NULL && psi_section_cache_match(&(m2s->catCache), section, section_len)) 
+   {
+      ts_free(ts);    
+      return 0; 
+   }
+
    conditional_access_section_t *new_cas = conditional_access_section_new(); 
    
    if (new_cas == NULL) 
@@ -276,6 +350,8 @@ int mpeg2ts_stream_read_cat(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
       return 0; 
    }
    
+   if (section != NULL) psi_section_cache_store(&(m2s->catCache), section, section_len); 
+
    // we know that we have a complete new cat
    int new_cat_version = (m2s->cat == NULL); 
    
@@ -320,6 +396,15 @@ int mpeg2ts_stream_read_pat(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
 { 
    int ret = 0; 
    
+   size_t section_len = 0; 
+   const uint8_t *section = psi_single_packet_section(ts->payload.bytes, ts->payload.len, 
+      ts->header.payload_unit_start_indicator, &(m2s->patBuffer), &section_len); 
+   if (section != NULL && psi_section_cache_match(&(m2s->patCache), section, section_len)) 
+   {
+      ts_free(ts);    
+      return 0; 
+   }
+
    program_association_section_t *new_pas = program_association_section_new(); 
    
    if (new_pas == NULL) 
@@ -336,6 +421,8 @@ int mpeg2ts_stream_read_pat(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
       return 0; 
    }
    
+   if (section != NULL) psi_section_cache_store(&(m2s->patCache), section, section_len); 
+
    // we know that we have a complete new PAT
    int new_pat_version = (m2s->pat == NULL); 
    
@@ -354,13 +441,37 @@ int mpeg2ts_stream_read_pat(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
       if (m2s->pat != NULL) program_association_section_free(m2s->pat); 
       
       m2s->pat = new_pas; 
+
+      // keep programs which are still in the PAT, drop the rest
+      vqarray_t *old_programs = m2s->programs; 
+      m2s->programs = vqarray_new(); 
       for (int i = 0; i < m2s->pat->_num_programs; i++) 
       {
-         mpeg2ts_program_t *prog = mpeg2ts_program_new(
-            m2s->pat->programs[i].program_number, 
-            m2s->pat->programs[i].program_map_PID); 
+         mpeg2ts_program_t *prog = NULL; 
+         for (int j = 0; j < vqarray_length(old_programs); j++) 
+         {
+            mpeg2ts_program_t *tmp = vqarray_get(old_programs, j); 
+            if (tmp != NULL
+                && tmp->program_number == m2s->pat->programs[i].program_number
+                && tmp->PID == m2s->pat->programs[i].program_map_PID) 
+            {
+               prog = tmp; 
+               vqarray_set(old_programs, j, NULL); 
+               break;
+            }
+         }
+         if (prog == NULL) 
+         {
+            prog = mpeg2ts_program_new(
+               m2s->pat->programs[i].program_number, 
+               m2s->pat->programs[i].program_map_PID); 
+            prog->m2s = m2s;
+         }
          vqarray_add(m2s->programs, (void *)prog);
       }
+      vqarray_foreach(old_programs, (vqarray_functor_t)mpeg2ts_program_free); 
+      vqarray_free(old_programs); 
+      mpeg2ts_stream_invalidate_pid_map(m2s); 
       
       if (m2s->pat_processor != NULL) m2s->pat_processor(m2s, m2s->arg); 
    }
@@ -375,9 +486,18 @@ int mpeg2ts_stream_read_pat(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
 
 int mpeg2ts_program_read_pmt(mpeg2ts_program_t *m2p, ts_packet_t *ts) 
 { 
-   LOG_INFO ("mpeg2ts_program_read_pmt");
    int ret = 0; 
    
+   size_t section_len = 0; 
+   const uint8_t *section = psi_single_packet_section(ts->payload.bytes, ts->payload.len, 
+      ts->header.payload_unit_start_indicator, &(m2p->pmtBuffer), &section_len); 
+   if (section != NULL && psi_section_cache_match(&(m2p->pmtCache), section, section_len)) 
+   {
+      ts_free(ts);    
+      return ret;
+   }
+
+   LOG_INFO ("mpeg2ts_program_read_pmt");
    program_map_section_t *new_pms = program_map_section_new(); 
    
    if (new_pms == NULL)  
@@ -397,6 +517,8 @@ int mpeg2ts_program_read_pmt(mpeg2ts_program_t *m2p, ts_packet_t *ts)
       return ret;
    }
    
+   if (section != NULL) psi_section_cache_store(&(m2p->pmtCache), section, section_len); 
+
 // we know that we have a complete new PAT
    int new_pmt_version = (m2p->pmt == NULL); 
    
@@ -411,20 +533,39 @@ int mpeg2ts_program_read_pmt(mpeg2ts_program_t *m2p, ts_packet_t *ts)
    
    if (new_pmt_version) 
    {
-      if (m2p->pmt != NULL) program_map_section_free(m2p->pmt); 
-      
-      m2p->pmt = new_pms; 
+      // PIDs still listed in the new PMT keep their state and handlers, the rest are dropped
+      vqarray_t *old_pids = m2p->pids; 
+      m2p->pids = vqarray_new(); 
       
-      for (int es_idx = 0; es_idx < vqarray_length(m2p->pmt->es_info); es_idx++) 
+      for (int es_idx = 0; es_idx < vqarray_length(new_pms->es_info); es_idx++) 
       {
-         elementary_stream_info_t *es = vqarray_get(m2p->pmt->es_info, es_idx); 
+         elementary_stream_info_t *es = vqarray_get(new_pms->es_info, es_idx); 
          if (es == NULL) continue; 
-         pid_info_t *pi = pid_info_new(); 
+
+         pid_info_t *pi = NULL; 
+         for (int i = 0; i < vqarray_length(old_pids); i++) 
+         {
+            pid_info_t *tmp = vqarray_get(old_pids, i); 
+            if (tmp != NULL && tmp->es_info != NULL && tmp->es_info->elementary_PID == es->elementary_PID) 
+            {
+               pi = tmp; 
+               vqarray_set(old_pids, i, NULL); 
+               break;
+            }
+         }
+         if (pi == NULL) pi = pid_info_new(); 
          pi->es_info = es; 
          
          vqarray_add(m2p->pids, pi); 
          pi = NULL;
       }
+      vqarray_foreach(old_pids, (vqarray_functor_t)pid_info_free); 
+      vqarray_free(old_pids); 
+
+      // es_info of the old PIDs pointed into the old PMT, so free it only now
+      if (m2p->pmt != NULL) program_map_section_free(m2p->pmt); 
+      m2p->pmt = new_pms; 
+      mpeg2ts_stream_invalidate_pid_map(m2p->m2s); 
       
       if (m2p->pmt_processor != NULL) m2p->pmt_processor(m2p, m2p->arg); 
    }
@@ -471,6 +612,246 @@ void mpeg2ts_program_enable_scte128(mpeg2ts_program_t *m2p)
    m2p->scte128_enabled = 1;
 }
 
+int mpeg2ts_program_enable_scte128_pid(mpeg2ts_program_t *m2p, uint32_t PID)
+{
+   if (m2p == NULL) return 0;
+
+   for (int i = 0; i < vqarray_length(m2p->pids); i++)
+   {
+      pid_info_t *pi = vqarray_get(m2p->pids, i);
+      if (pi != NULL && pi->es_info != NULL && pi->es_info->elementary_PID == PID)
+      {
+         pi->scte128_enabled = 1;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/**
+ * Checks the continuity counter of a packet against the previous one on its PID.
+ * 
+ * @return 0 if the packet is a duplicate and should be dropped, 1 otherwise
+ */
+static int pid_info_check_continuity(pid_info_t *pi, ts_packet_t *ts) 
+{ 
+   int cc = ts->header.continuity_counter; 
+   int has_payload = ts->header.adaptation_field_control & TS_PAYLOAD; 
+   int discontinuity = (ts->header.adaptation_field_control & TS_ADAPTATION_FIELD) && 
+      ts->adaptation_field.discontinuity_indicator; 
+
+   pi->cc_stats.num_packets++; 
+
+   if (discontinuity) 
+   {
+      pi->cc_stats.num_discontinuities++; 
+   }
+
+   if (!pi->cc_valid || discontinuity) 
+   {
+      pi->continuity_counter = cc; 
+      pi->cc_valid = 1; 
+      pi->cc_duplicate = 0; 
+      return 1;
+   }
+
+   if (!has_payload) 
+   {
+      // CC does not increment on packets without payload
+      if (cc != pi->continuity_counter) 
+      {
+         pi->cc_stats.num_cc_errors++; 
+         LOG_WARN_ARGS("PID 0x%04X: CC error on packet without payload: expected %d, got %d", 
+            ts->header.PID, pi->continuity_counter, cc); 
+         pi->continuity_counter = cc; 
+      }
+      return 1;
+   }
+
+   if (cc == pi->continuity_counter) 
+   {
+      // a packet may be sent twice in a row, but not more
+      if (!pi->cc_duplicate) 
+      {
+         pi->cc_duplicate = 1; 
+         pi->cc_stats.num_duplicates++; 
+         return 0;
+      }
+      pi->cc_stats.num_cc_errors++; 
+      LOG_WARN_ARGS("PID 0x%04X: CC error: packet with CC %d repeated more than once", ts->header.PID, cc); 
+      return 1;
+   }
+
+   int expected_cc = (pi->continuity_counter + 1) & 0x0F; 
+   if (cc != expected_cc) 
+   {
+      int num_lost = (cc - expected_cc) & 0x0F; 
+      pi->cc_stats.num_cc_errors++; 
+      pi->cc_stats.num_lost_packets += num_lost; 
+      LOG_WARN_ARGS("PID 0x%04X: CC error: expected %d, got %d (%d packets lost)", 
+         ts->header.PID, expected_cc, cc, num_lost); 
+   }
+
+   pi->continuity_counter = cc; 
+   pi->cc_duplicate = 0; 
+   return 1;
+}
+
+/**
+ * Updates the program's clock state with a PCR read from packet number packet_index of the multiplex.
+ */
+static void mpeg2ts_program_read_pcr(mpeg2ts_program_t *m2p, ts_packet_t *ts, uint64_t packet_index) 
+{ 
+   int64_t raw_pcr = ts_read_pcr(ts); 
+   if (raw_pcr >= PCR_MODULUS) return; 
+
+   int discontinuity = ts->adaptation_field.discontinuity_indicator; 
+   int64_t pcr = raw_pcr; 
+   int64_t interval = 0; 
+
+   if (m2p->pcr_info.pcr[1] != INT64_MAX) 
+   {
+      int64_t last_raw_pcr = m2p->pcr_info.pcr[1] - m2p->pcr_info.num_rollovers * PCR_MODULUS; 
+      if (last_raw_pcr - raw_pcr > PCR_MODULUS / 2) 
+      {
+         m2p->pcr_info.num_rollovers++; 
+      }
+      pcr = raw_pcr + m2p->pcr_info.num_rollovers * PCR_MODULUS; 
+      interval = pcr - m2p->pcr_info.pcr[1]; 
+
+      if (interval == 0 && !discontinuity) 
+      {
+         return; // e.g. a duplicate packet
+      }
+   }
+
+   if (m2p->pcr_info.pcr[1] == INT64_MAX || discontinuity || interval < 0 || interval > PCR_DISCONTINUITY_THRESH) 
+   {
+      if (m2p->pcr_info.pcr[1] != INT64_MAX) 
+      {
+         m2p->pcr_info.num_discontinuities++; 
+         if (!discontinuity) 
+         {
+            LOG_WARN_ARGS("Program %d: undeclared PCR discontinuity on PID 0x%04X: jump of %"PRId64" ticks", 
+               m2p->program_number, ts->header.PID, interval); 
+         }
+      }
+
+      // start a new timeline; the last known mux rate keeps being used for interpolation
+      m2p->pcr_info.first_pcr = pcr; 
+      m2p->pcr_info.first_arrival_time = ts->arrival_time; 
+      m2p->pcr_info.drift = 0; 
+      m2p->pcr_info.pcr[0] = INT64_MAX; 
+      m2p->pcr_info.pcr[1] = pcr; 
+      m2p->pcr_info.pcr_packet[1] = packet_index; 
+      return;
+   }
+
+   uint64_t num_packets = packet_index - m2p->pcr_info.pcr_packet[1]; 
+
+   if (m2p->pcr_info.last_interval_packets > 0) 
+   {
+      int64_t predicted_pcr = m2p->pcr_info.pcr[1] + 
+         (int64_t)(num_packets * m2p->pcr_info.last_interval / m2p->pcr_info.last_interval_packets); 
+      int64_t jitter = pcr - predicted_pcr; 
+      m2p->pcr_info.last_jitter = jitter; 
+      if (llabs(jitter) > m2p->pcr_info.max_jitter) 
+      {
+         m2p->pcr_info.max_jitter = llabs(jitter);
+      }
+   }
+
+   if (interval > PCR_MAX_INTERVAL) 
+   {
+      m2p->pcr_info.num_interval_errors++; 
+      LOG_WARN_ARGS("Program %d: PCR interval of %"PRId64" ms on PID 0x%04X exceeds %"PRId64" ms", 
+         m2p->program_number, (int64_t)(interval * 1000 / PCR_FREQUENCY), ts->header.PID, (int64_t)(PCR_MAX_INTERVAL * 1000 / PCR_FREQUENCY)); 
+   }
+   if (interval > m2p->pcr_info.max_interval) 
+   {
+      m2p->pcr_info.max_interval = interval;
+   }
+
+   m2p->pcr_info.last_interval = interval; 
+   m2p->pcr_info.last_interval_packets = num_packets; 
+   m2p->pcr_info.pcr_rate = (double)(num_packets * TS_SIZE) / interval; 
+
+   m2p->pcr_info.pcr[0] = m2p->pcr_info.pcr[1]; 
+   m2p->pcr_info.pcr_packet[0] = m2p->pcr_info.pcr_packet[1]; 
+   m2p->pcr_info.pcr[1] = pcr; 
+   m2p->pcr_info.pcr_packet[1] = packet_index; 
+
+   if (ts->arrival_time != 0 && m2p->pcr_info.first_arrival_time != 0) 
+   {
+      int64_t pcr_elapsed = (pcr - m2p->pcr_info.first_pcr) * 1000 / 27; 
+      int64_t arrival_elapsed = (int64_t)(ts->arrival_time - m2p->pcr_info.first_arrival_time); 
+      m2p->pcr_info.drift = pcr_elapsed - arrival_elapsed;
+   }
+}
+
+/**
+ * @return the PCR of packet number packet_index of the multiplex, extrapolated from the last PCR
+ *         at the last known mux rate, or UINT64_MAX if the mux rate is not known yet
+ */
+static uint64_t mpeg2ts_program_interpolate_pcr(mpeg2ts_program_t *m2p, uint64_t packet_index) 
+{ 
+   if (m2p->pcr_info.last_interval_packets == 0 || m2p->pcr_info.pcr[1] == INT64_MAX) return UINT64_MAX; 
+
+   uint64_t num_packets = packet_index - m2p->pcr_info.pcr_packet[1]; 
+   int64_t pcr = m2p->pcr_info.pcr[1] + 
+      (int64_t)(num_packets * m2p->pcr_info.last_interval / m2p->pcr_info.last_interval_packets); 
+   return pcr % PCR_MODULUS;
+}
+
+static void mpeg2ts_stream_read_pcr(mpeg2ts_stream_t *m2s, ts_packet_t *ts, uint64_t packet_index) 
+{ 
+   for (int i = 0; i < vqarray_length(m2s->programs); i++) 
+   {
+      mpeg2ts_program_t *m2p = vqarray_get(m2s->programs, i); 
+      if (m2p != NULL && m2p->pmt != NULL && m2p->pmt->PCR_PID == ts->header.PID) 
+      {
+         mpeg2ts_program_read_pcr(m2p, ts, packet_index);
+      }
+   }
+}
+
+static int mpeg2ts_program_process_ts_packet(mpeg2ts_program_t *m2p, pid_info_t *pi, ts_packet_t *ts) 
+{ 
+   if (!pid_info_check_continuity(pi, ts)) 
+   {
+      ts_free(ts); 
+      return 0;
+   }
+
+   ts->pcr_int = mpeg2ts_program_interpolate_pcr(m2p, m2p->m2s->num_packets - 1); 
+
+   // parsed on demand, see ts_get_scte128_private_data
+   if (m2p->scte128_enabled || pi->scte128_enabled) 
+   {
+      ts->flags |= TS_FLAG_SCTE128;
+   }
+
+   pi->num_packets++;
+
+   if ((pi->demux_validator != NULL) && (pi->demux_validator->process_ts_packet != NULL)) 
+   {
+      // TODO: check return value and do something intelligent 
+      if (pi->demux_validator->process_ts_packet(ts, pi->es_info, pi->demux_validator->arg) == 0)
+      {
+         return 0;
+      }
+   }
+   
+   if ((pi->demux_handler != NULL) && (pi->demux_handler->process_ts_packet != NULL)) 
+   {
+      return pi->demux_handler->process_ts_packet(ts, pi->es_info, pi->demux_handler->arg);             
+   }
+
+   // known PID, but nobody is interested in it
+   ts_free(ts); 
+   return 0;
+}
+
 int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t *m2s, ts_packet_t *ts) 
 {    
    if (m2s == NULL ) 
@@ -482,6 +863,13 @@ int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
       return 0;
    }
    
+   // every packet advances the interpolated clock, including PSI and null packets
+   uint64_t packet_index = m2s->num_packets++; 
+   if ((ts->header.adaptation_field_control & TS_ADAPTATION_FIELD) && ts->adaptation_field.PCR_flag) 
+   {
+      mpeg2ts_stream_read_pcr(m2s, ts, packet_index);
+   }
+
    if (ts->header.PID == PAT_PID)
        return mpeg2ts_stream_read_pat(m2s, ts); 
    if (ts->header.PID == CAT_PID)
@@ -501,56 +889,68 @@ int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t *m2s, ts_packet_t *ts)
       return 0;    
    }
       
-   pid_info_t *pi = NULL; 
-   for (int i = 0; i < vqarray_length(m2s->programs) && (pi == NULL); i++) 
+   if (m2s->pid_map_dirty) 
    {
-      mpeg2ts_program_t* m2p = vqarray_get(m2s->programs, i);
-      
-      if (m2p == NULL)
-      {
-          continue;
-      }
-      
-      if (m2p->PID == ts->header.PID)
-      {
-          return mpeg2ts_program_read_pmt(m2p, ts);  // got a PMT
-      }
+      mpeg2ts_stream_rebuild_pid_map(m2s);
+   }
+
+   pid_map_entry_t *owner = m2s->pid_map[ts->header.PID]; 
+   if (owner == NULL) 
+   {
+      // if we are here, we have no clue what this PID is
+      LOG_WARN_ARGS("Unknown PID 0x%02X", ts->header.PID); 
+      ts_free(ts);         
+      return 0;
+   }
 
-      if (m2p->scte128_enabled) 
+   for (pid_map_entry_t *e = owner; e != NULL; e = e->next) 
+   {
+      if (e->pi == NULL) 
       {
-         ts_parse_scte128_af_private(&ts->adaptation_field);
+         return mpeg2ts_program_read_pmt(e->m2p, ts);  // got a PMT
       }
-     
-      // pi == NULL => this PID does not belong to this program
-      pi = mpeg2ts_program_get_pid_info(m2p, ts->header.PID); 
-      
-      if (pi != NULL) 
+   }
+
+   // a PID shared by several programs is delivered to each of them; every
+   // owner but the last one gets its own copy, since handlers own the packet
+   int ret = 0; 
+   for (pid_map_entry_t *e = owner; e != NULL; e = e->next) 
+   {
+      ts_packet_t *ts_owner = ts; 
+      if (e->next != NULL) 
       {
-         // check for discontinuity
-         pi->num_packets++;
-         
-         // FIXME: this can misfire if we have an MPTS and same PID is "owned" by more than one program
-         // this is an *extremely unlikely* case       
-         if ((pi->demux_validator != NULL) && (pi->demux_validator->process_ts_packet != NULL)) 
+         if (ts->bytes == NULL) 
          {
-            // TODO: check return value and do something intelligent 
-            if (pi->demux_validator->process_ts_packet(ts, pi->es_info, pi->demux_validator->arg) == 0)
-            {
-               return 0;
-            }
-         }
-         
-         if ((pi->demux_handler != NULL) && (pi->demux_handler->process_ts_packet != NULL)) 
-         {
-            return pi->demux_handler->process_ts_packet(ts, pi->es_info, pi->demux_handler->arg);             
+            // not read with ts_read/ts_read_inplace, so there is nothing to copy from
+            LOG_ERROR_ARGS("PID 0x%02X is shared by several programs, but the packet has no raw bytes -- delivering it to the last program only", 
+                           ts->header.PID); 
+            continue;
          }
+         ts_owner = ts_pool_get(ts->pool); 
+         ts_read(ts_owner, ts->bytes, TS_SIZE); 
+         ts_owner->arrival_time = ts->arrival_time; 
       }
+      ret = mpeg2ts_program_process_ts_packet(e->m2p, e->pi, ts_owner);
    }
-   
-   
-   // if we are here, we have no clue what this PID is
-   LOG_WARN_ARGS("Unknown PID 0x%02X", ts->header.PID); 
-   ts_free(ts);         
-   return 0;
+   return ret;
 }
 
+int mpeg2ts_stream_get_cc_stats(mpeg2ts_stream_t *m2s, uint32_t PID, pid_cc_stats_t *stats) 
+{ 
+   if (m2s == NULL || stats == NULL || PID >= MPEG2TS_NUM_PIDS) return 0; 
+
+   if (m2s->pid_map_dirty) 
+   {
+      mpeg2ts_stream_rebuild_pid_map(m2s);
+   }
+
+   for (pid_map_entry_t *e = m2s->pid_map[PID]; e != NULL; e = e->next) 
+   {
+      if (e->pi != NULL) 
+      {
+         *stats = e->pi->cc_stats; 
+         return 1;
+      }
+   }
+   return 0;
+}
@@ -46,8 +46,13 @@ extern "C"
 {
 #endif
 
+#define MPEG2TS_NUM_PIDS 0x2000
+#define PCR_MAX_INTERVAL         (PCR_FREQUENCY / 10)  /// ISO/IEC 13818-1 2.7.2: at most 100 ms between PCRs
+#define PCR_DISCONTINUITY_THRESH (PCR_FREQUENCY)       /// an undeclared PCR jump larger than this restarts the timeline
+
 struct _mpeg2ts_stream_; 
 struct _mpeg2ts_program_; 
+struct _pid_map_entry_; 
 
 typedef int (*ts_pid_processor_t)(ts_packet_t *, elementary_stream_info_t *, void *); 
 typedef int (*pat_processor_t)(struct _mpeg2ts_stream_ *, void *); 
@@ -60,30 +65,43 @@ struct _mpeg2ts_program_
 {
    uint32_t PID;            /// PMT PID
    uint32_t program_number; 
+   struct _mpeg2ts_stream_ *m2s; /// multiplex this program belongs to
    
    vqarray_t *pids; /// list of PIDs belonging to this program 
                     /// each element is of type pid_info_t
    
    struct 
    {
-      int64_t first_pcr; 
-      int32_t num_rollovers; 
-      int64_t pcr[2]; 
-      int32_t packets_from_last_pcr;
-      double pcr_rate;
-
-   } pcr_info; /// information on STC clock state
+      int64_t first_pcr;               /// first PCR of the current timeline, INT64_MAX until one was seen
+      int32_t num_rollovers;           /// PCR wraparounds since first_pcr
+      int64_t pcr[2];                  /// previous and last PCR, unwrapped (27 MHz)
+      uint64_t pcr_packet[2];          /// multiplex packet index of pcr[0] and pcr[1]
+      double pcr_rate;                 /// mux rate in bytes per 27 MHz tick, 0.0 until two PCRs were seen
+
+      int64_t last_interval;           /// ticks between the last two PCRs of the current timeline
+      uint64_t last_interval_packets;  /// multiplex packets between the last two PCRs, 0 until two were seen
+      int64_t max_interval;            /// largest PCR interval seen
+      uint64_t num_interval_errors;    /// intervals above PCR_MAX_INTERVAL
+      int64_t last_jitter;             /// last PCR minus the PCR interpolated for its packet
+      int64_t max_jitter;              /// largest absolute jitter seen
+      uint64_t num_discontinuities;    /// PCR timeline restarts (discontinuity_indicator or jumps)
+
+      uint64_t first_arrival_time;     /// arrival time of first_pcr in ns, 0 if unknown
+      int64_t drift;                   /// PCR elapsed minus arrival time elapsed since first_pcr, in ns
+
+   } pcr_info; /// information on STC clock state, maintained incrementally by the demuxer
    
    program_map_section_t *pmt;      /// parsed PMT
    pmt_processor_t pmt_processor;   /// callback called after PMT was processed
    void *arg;                       /// argument for PMT callback
    arg_destructor_t arg_destructor; /// destructor for the callback argument
 
-   uint32_t scte128_enabled;        /// Determines if SCTE128 private data is available
-                                    /// and should be parsed
+   uint32_t scte128_enabled;        /// SCTE-128 private data is expected on all PIDs
+                                    /// of this program (see also pid_info_t)
 
    // used for decoding pmt split among multiple TS packets
    psi_table_buffer_t pmtBuffer;
+   psi_section_cache_t pmtCache;    /// last PMT section, repeats are not parsed again
 }; 
 
 struct _mpeg2ts_stream_ 
@@ -97,11 +115,20 @@ struct _mpeg2ts_stream_
    void *arg;                          /// argument for PAT/CAT callbacks
    arg_destructor_t arg_destructor;    /// destructor for the callback argument
 
+   struct _pid_map_entry_ *pid_map[MPEG2TS_NUM_PIDS]; /// PID -> owner(s), direct-mapped
+   struct _pid_map_entry_ *pid_map_entries;           /// backing storage for pid_map
+   int pid_map_dirty;                                 /// PAT, PMT or PID processors changed since last rebuild
+
+   uint64_t num_packets;                              /// packets read so far, used to interpolate PCRs
+
    // used for decoding pmt split among multiple TS packets
    psi_table_buffer_t patBuffer;
 
    // used for decoding pmt split among multiple TS packets
    psi_table_buffer_t catBuffer;
+
+   psi_section_cache_t patCache;    /// last PAT section, repeats are not parsed again
+   psi_section_cache_t catCache;    /// last CAT section, repeats are not parsed again
 }; 
 
 typedef struct _mpeg2ts_stream_  mpeg2ts_stream_t; 
@@ -120,6 +147,19 @@ typedef struct
    // TODO impl
 } mux_pid_handler_t; 
 
+/**
+ * Continuity counter statistics of a single PID, maintained by the demuxer
+ * for every packet (see ISO/IEC 13818-1 2.4.3.3)
+ */
+typedef struct 
+{
+   uint64_t num_packets;          /// packets checked
+   uint64_t num_lost_packets;     /// packets missing according to CC gaps
+   uint64_t num_cc_errors;        /// CC errors not covered by a discontinuity_indicator
+   uint64_t num_duplicates;       /// duplicate packets, dropped by the demuxer
+   uint64_t num_discontinuities;  /// packets with discontinuity_indicator set
+} pid_cc_stats_t; 
+
 typedef struct 
 {
    demux_pid_handler_t *demux_handler;   /// demux handler
@@ -127,9 +167,24 @@ typedef struct
    // TODO: mux_pid_handler_t*
    elementary_stream_info_t *es_info;  /// ES-level information (type, descriptors)
    int continuity_counter;             /// running continuity counter
+   int cc_valid;                       /// continuity_counter holds the CC of a previous packet
+   int cc_duplicate;                   /// previous packet was a duplicate
+   pid_cc_stats_t cc_stats;            /// continuity counter statistics
    uint64_t num_packets;
+   uint32_t scte128_enabled;           /// SCTE-128 private data is expected on this PID
 } pid_info_t; 
 
+/**
+ * One owner of a PID.  A PID owned by more than one program (MPTS with
+ * shared PCR or PMT PIDs) gets a chain of entries, in PAT order.
+ */
+typedef struct _pid_map_entry_
+{
+   struct _mpeg2ts_program_ *m2p;   /// owning program
+   pid_info_t *pi;                  /// NULL if this is the program's PMT PID
+   struct _pid_map_entry_ *next;    /// next owner of the same PID, if any
+} pid_map_entry_t; 
+
 /**
  * Initialize mpeg2ts_stream_t object
  * 
@@ -162,6 +217,17 @@ void mpeg2ts_stream_free(mpeg2ts_stream_t *m2s);
  */
 int mpeg2ts_stream_read_ts_packet(mpeg2ts_stream_t *m2s, ts_packet_t *ts); 
 
+/**
+ * Get the continuity counter statistics of a PID
+ * 
+ * @param m2s MPEG-2 TS multiplex
+ * @param PID elementary PID
+ * @param stats filled in with the statistics of the first program owning the PID
+ * 
+ * @return 1 if the PID is known, 0 otherwise
+ */
+int mpeg2ts_stream_get_cc_stats(mpeg2ts_stream_t *m2s, uint32_t PID, pid_cc_stats_t *stats); 
+
 /**
  * Initialize new program object
  * 
@@ -193,10 +259,15 @@ void mpeg2ts_program_free(mpeg2ts_program_t *m2p);
  * @param validator optional callback for each TS packet from 
  *        this PID. The validator callback may not alter the
  *        state of the packet or own the memory.
+ * @param scte128_enabled nonzero if SCTE-128 private data is
+ *        expected on this PID (see
+ *        mpeg2ts_program_enable_scte128_pid); a PID that was
+ *        already enabled stays enabled
  * 
  * @return zero if registration succeeded. 
  */
-int mpeg2ts_program_register_pid_processor(mpeg2ts_program_t *m2p, uint32_t PID, demux_pid_handler_t *handler,demux_pid_handler_t *validator); 
+int mpeg2ts_program_register_pid_processor(mpeg2ts_program_t *m2p, uint32_t PID, demux_pid_handler_t *handler,demux_pid_handler_t *validator,
+                                           int scte128_enabled); 
 
 /**
  * Unregister a PID processor callback for a given PID
@@ -217,6 +288,27 @@ int mpeg2ts_program_unregister_pid_processor(mpeg2ts_program_t *m2p, uint32_t PI
  */
 void mpeg2ts_program_enable_scte128(mpeg2ts_program_t *m2p);
 
+/**
+ * Indicates that SCTE-128 private data is carried in the TS packet adaptation field
+ * of a single PID.  Packets from such PIDs are marked with TS_FLAG_SCTE128 and
+ * their private data is parsed on demand by ts_get_scte128_private_data.
+ * 
+ * @param m2p program to which the PID belongs
+ * @param PID PID carrying SCTE-128 private data
+ * 
+ * @return 1 if the PID was found in the program, 0 otherwise
+ */
+int mpeg2ts_program_enable_scte128_pid(mpeg2ts_program_t *m2p, uint32_t PID);
+
+/**
+ * Mark the PID dispatch table as stale; it is rebuilt before the next
+ * packet is dispatched.  Called whenever the program list or a program's
+ * PID list changes.
+ * 
+ * @param m2s MPEG-2 TS multiplex
+ */
+void mpeg2ts_stream_invalidate_pid_map(mpeg2ts_stream_t *m2s); 
+
 //int mpeg2ts_program_read_ts_packet(mpeg2ts_program_t *m2p, ts_packet_t *ts);
 int mpeg2ts_stream_reset(mpeg2ts_stream_t *m2s);
 
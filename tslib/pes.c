@@ -102,6 +102,8 @@ int pes_read_vec(pes_packet_t *pes, const buf_t *vec, int buf_count)
 
    pes->payload = pes->buf + header_bytes; 
    pes->payload_len =  pes->buf_len - header_bytes; 
+   pes->header_len = header_bytes; 
+   pes->pes_len = pes->buf_len; 
    
    if ((pes->header.PES_packet_length > 0) && (pes->header.PES_packet_length + 6 > pes->buf_len)) 
    {
@@ -115,6 +117,109 @@ int pes_read_vec(pes_packet_t *pes, const buf_t *vec, int buf_count)
    return bs_pos(&b);
 }
 
+// copies up to len bytes from the start of a buffer list, returns the number of bytes copied
+static size_t pes_gather(uint8_t *dst, size_t len, const buf_t *vec, int buf_count) 
+{ 
+   size_t copied = 0; 
+   for (int i = 0; i < buf_count && copied < len; i++) 
+   {
+      if (vec[i].bytes == NULL || vec[i].len == 0) continue; 
+      size_t n = (vec[i].len < len - copied) ? vec[i].len : len - copied; 
+      memcpy(dst + copied, vec[i].bytes, n); 
+      copied += n;
+   }
+   return copied;
+}
+
+int pes_read_vec_partial(pes_packet_t *pes, const buf_t *vec, int buf_count, size_t min_payload_len) 
+{ 
+   if (pes == NULL) return 0; 
+   if (vec == NULL || buf_count == 0) return 0; 
+   if (pes->buf != NULL) 
+   {
+      free(pes->buf); 
+      pes->buf = NULL; 
+      pes->buf_len = 0;
+   }
+   
+   int i; 
+   
+   pes->vec = vec; 
+   pes->vec_count = buf_count; 
+   pes->header_len = 0; 
+   for (pes->pes_len = 0, i = 0; i < buf_count; i++) pes->pes_len += vec[i].len; 
+   
+   // the header size is known from its first 9 bytes
+   size_t header_len = 0; 
+   if (vec[0].bytes != NULL && vec[0].len >= 9) 
+   {
+      header_len = HAS_PES_HEADER(vec[0].bytes[3]) ? 9 + vec[0].bytes[8] : 6;
+   }
+   
+   // bytes needed contiguous: header + requested payload
+   size_t needed = (header_len > 0) ? header_len : 9 + 0xFF; 
+   if (needed >= pes->pes_len || min_payload_len >= pes->pes_len - needed) needed = pes->pes_len; 
+   else needed += min_payload_len; 
+   
+   uint8_t *base = NULL; 
+   size_t base_len = 0; 
+   if (header_len > 0 && vec[0].len >= needed) 
+   {
+      // the common case: read in place from the first TS packet
+      base = vec[0].bytes; 
+      base_len = vec[0].len;
+   }
+   else 
+   {
+      pes->buf = malloc(needed); 
+      pes->buf_len = pes_gather(pes->buf, needed, vec, buf_count); 
+      base = pes->buf; 
+      base_len = pes->buf_len;
+   }
+   
+   bs_t b; 
+   bs_init(&b, base, base_len); 
+   int header_bytes = pes_read_header(&pes->header, &b); 
+
+   // PES header broken -- bail out.
+   if ( header_bytes < 3 ) 
+   {
+      return 0;
+   }
+
+   pes->header_len = header_bytes; 
+   pes->payload = base + header_bytes; 
+   pes->payload_len = base_len - header_bytes; 
+   
+   if ((pes->header.PES_packet_length > 0) && (pes->header.PES_packet_length + 6 > pes->pes_len)) 
+   {
+      pes->status = PES_ERROR_NOT_ENOUGH_DATA; 
+      LOG_ERROR_ARGS("PES packet header promises %u bytes, only %ld found in buffer", 
+                     pes->header.PES_packet_length + 6, pes->pes_len); 
+      reportAddErrorLogArgs("PES packet header promises %u bytes, only %ld found in buffer", 
+                     pes->header.PES_packet_length + 6, pes->pes_len); 
+   }
+   
+   return bs_pos(&b);
+}
+
+int pes_flatten(pes_packet_t *pes) 
+{ 
+   if (pes == NULL) return 0; 
+   if (pes->buf != NULL && pes->buf_len >= pes->pes_len) return 1; // already flat
+   if (pes->vec == NULL || pes->header_len == 0) return 0; 
+   
+   uint8_t *buf = malloc(pes->pes_len); 
+   size_t buf_len = pes_gather(buf, pes->pes_len, pes->vec, pes->vec_count); 
+   
+   if (pes->buf != NULL) free(pes->buf); 
+   pes->buf = buf; 
+   pes->buf_len = buf_len; 
+   pes->payload = buf + pes->header_len; 
+   pes->payload_len = buf_len - pes->header_len; 
+   return 1;
+}
+
 int pes_read_buf(pes_packet_t* pes, const uint8_t* buf, size_t len) 
 { 
    
@@ -144,6 +249,8 @@ int pes_read_buf(pes_packet_t* pes, const uint8_t* buf, size_t len)
    
    pes->payload = pes->buf + header_bytes; 
    pes->payload_len =  pes->buf_len - header_bytes; 
+   pes->header_len = header_bytes; 
+   pes->pes_len = pes->buf_len; 
    
    if ((pes->header.PES_packet_length > 0) && (pes->header.PES_packet_length + 6 > pes->buf_len)) 
    {
@@ -99,6 +99,8 @@ extern "C"
 #define PES_ERROR_NOT_ENOUGH_DATA  -1
 #define PES_ERROR_WRONG_START_CODE -2
 
+#define PES_PAYLOAD_ALL SIZE_MAX   /// min_payload_len asking for the complete payload
+
 typedef struct {
    uint32_t stream_id; 
    uint32_t PES_packet_length; 
@@ -148,10 +150,15 @@ typedef struct {
 
 typedef struct {
    pes_header_t header;  /// parsed PES header
-   uint8_t *payload;     /// reference to a location within the buf. thou shalt not free it!
-   uint8_t *buf;         /// buffer containing actual bytes (including headers)
-   size_t payload_len;   /// length of the payload
+   uint8_t *payload;     /// reference to a location within the buf (or within vec[0]). thou shalt not free it!
+   uint8_t *buf;         /// buffer containing actual bytes (including headers), NULL if read in place
+   size_t payload_len;   /// length of the contiguous payload at payload (see pes_flatten)
    size_t buf_len;       /// length of the buffer (which includes payload)
+   size_t header_len;    /// length of the PES header
+   size_t pes_len;       /// length of the complete PES packet, may exceed header_len + payload_len
+   const buf_t *vec;     /// complete PES packet, if read with pes_read_vec_partial. 
+                         /// references the TS packets -- only valid inside the PES processor callback
+   int vec_count;        /// number of buffers in vec
    void *opaque;         /// opaque pointer that should always be passed through
    uint32_t PID;
    int status;
@@ -191,6 +198,32 @@ int pes_read_buf(pes_packet_t *pes, const uint8_t *buf, size_t len);
  */
 int pes_read_vec(pes_packet_t *pes, const buf_t *vec, int buf_count); 
 
+/**
+ * Non-flattening version of pes_read_vec. 
+ * The header is parsed in place, and payload/payload_len cover at least 
+ * min_payload_len bytes of the payload (or all of it, if it is shorter). 
+ * These point into vec[0] when it is long enough, otherwise into a copy of 
+ * the first bytes of the packet in pes->buf. The rest of the packet is only 
+ * referenced via pes->vec, which must outlive the PES packet or be flattened. 
+ * 
+ * @param pes PES packet to construct / parse
+ * @param vec list of buffers containing parts of a PES packet
+ * @param buf_count number of buffers
+ * @param min_payload_len payload bytes needed contiguous, PES_PAYLOAD_ALL for all
+ * 
+ * @return PES header length, 0 on error
+ */
+int pes_read_vec_partial(pes_packet_t *pes, const buf_t *vec, int buf_count, size_t min_payload_len); 
+
+/**
+ * Make the complete PES packet available in pes->buf, and its complete payload 
+ * at pes->payload / pes->payload_len. 
+ * Processors that need the whole payload call this before looking at it. 
+ * 
+ * @return 1 on success, 0 if the packet is partial and its buffers are unknown
+ */
+int pes_flatten(pes_packet_t *pes); 
+
 
 int pes_write_header(pes_header_t *ph, bs_t *b); 
 int pes_write(pes_packet_t *pes, uint8_t *buf, size_t len); 
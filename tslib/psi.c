@@ -297,7 +297,7 @@ int program_association_section_read(program_association_section_t *pas, uint8_t
    
    // check CRC
    crc_t pas_crc = crc_init(); 
-   pas_crc = crc_update(pas_crc, buf, bs_pos(b) - 4); 
+   pas_crc = crc_update(pas_crc, b->start, bs_pos(b) - 4); 
    pas_crc = crc_finalize(pas_crc); 
    if (pas_crc != pas->CRC_32) 
    {
@@ -347,26 +347,14 @@ int program_association_section_print(const program_association_section_t *pas,
    return bytes;
 }
 
-elementary_stream_info_t* es_info_new() 
+elementary_stream_info_t* es_info_new(arena_t *arena) 
 { 
-   elementary_stream_info_t *es = calloc(1, sizeof(elementary_stream_info_t)); 
-   es->descriptors = vqarray_new(); 
+   elementary_stream_info_t *es = arena_calloc(arena, 1, sizeof(elementary_stream_info_t)); 
+   es->descriptors = vqarray_new_in(arena); 
    return es;
 }
 
-void es_info_free(elementary_stream_info_t *es) 
-{ 
-   if (es == NULL) return; 
-   
-   if (es->descriptors != NULL) 
-   {
-      vqarray_foreach(es->descriptors, (vqarray_functor_t)descriptor_free); 
-      vqarray_free(es->descriptors);
-   }
-   free(es);
-}
-
-int es_info_read(elementary_stream_info_t *es, bs_t *b) 
+int es_info_read(elementary_stream_info_t *es, bs_t *b, arena_t *arena) 
 { 
    int es_info_start = bs_pos(b); 
    es->stream_type = bs_read_u8(b); 
@@ -381,7 +369,7 @@ int es_info_read(elementary_stream_info_t *es, bs_t *b)
    LOG_DEBUG_ARGS ("es_info_read: PID = %d, streamType = 0x%x, ES_info_length = %d.  Calling read_descriptor_loop", 
       es->elementary_PID, es->stream_type, es->ES_info_length);
    
-   read_descriptor_loop(es->descriptors, b, es->ES_info_length); 
+   read_descriptor_loop(es->descriptors, b, es->ES_info_length, arena); 
    if (es->ES_info_length > MAX_ES_INFO_LEN) 
    {
       LOG_ERROR_ARGS("ES info length is 0x%02X, larger than maximum allowed 0x%02X", 
@@ -427,29 +415,25 @@ int print_es_info_loop(vqarray_t *es_list, int level, char *str, size_t str_len)
 
 program_map_section_t* program_map_section_new() 
 { 
-   program_map_section_t *pms = calloc(1, sizeof(program_map_section_t)); 
-   pms->descriptors = vqarray_new(); 
-   pms->es_info = vqarray_new(); 
+   // the whole parsed PMT (ES info, descriptor lists, descriptors) lives in one arena
+   arena_t *arena = arena_new(PSI_ARENA_BLOCK_SIZE);
+   program_map_section_t *pms = arena_calloc(arena, 1, sizeof(program_map_section_t)); 
+   pms->arena = arena;
+   pms->descriptors = vqarray_new_in(arena); 
+   pms->es_info = vqarray_new_in(arena); 
+   return pms;
+}
+
+program_map_section_t* program_map_section_ref(program_map_section_t *pms) 
+{ 
+   if (pms != NULL) arena_ref(pms->arena);
    return pms;
 }
 
 void program_map_section_free(program_map_section_t *pms) 
 { 
    if (pms == NULL) return; 
-   
-   if (pms->descriptors != NULL) 
-   {
-      vqarray_foreach(pms->descriptors, (vqarray_functor_t)descriptor_free); 
-      vqarray_free(pms->descriptors);
-   }
-   
-   if (pms->es_info) 
-   {
-      vqarray_foreach(pms->es_info, (vqarray_functor_t)es_info_free); 
-      vqarray_free(pms->es_info);
-   }
-   
-   free(pms);
+   arena_free(pms->arena);
 }
 
 void resetPSITableBuffer(psi_table_buffer_t *psiTableBuffer)
@@ -463,6 +447,48 @@ void resetPSITableBuffer(psi_table_buffer_t *psiTableBuffer)
    }
 }
 
+const uint8_t* psi_single_packet_section(const uint8_t *buf, size_t buf_len, uint32_t payload_unit_start_indicator,
+                                         const psi_table_buffer_t *tableBuffer, size_t *section_len)
+{
+   if (!payload_unit_start_indicator || tableBuffer->buffer != NULL || buf == NULL || buf_len < 1) return NULL;
+
+   size_t offset = 1 + buf[0]; // pointer_field
+   if (offset + 3 > buf_len) return NULL;
+
+   const uint8_t *section = buf + offset;
+   size_t len = 3 + (((section[1] & 0x0F) << 8) | section[2]);
+   if (len < 3 + 4 || offset + len > buf_len) return NULL;
+
+   *section_len = len;
+   return section;
+}
+
+static uint32_t psi_section_crc_field(const uint8_t *section, size_t section_len)
+{
+   const uint8_t *p = section + section_len - 4;
+   return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int psi_section_cache_match(const psi_section_cache_t *cache, const uint8_t *section, size_t section_len)
+{
+   if (!cache->valid || cache->section_len != section_len) return 0;
+   if (cache->CRC_32 != psi_section_crc_field(section, section_len)) return 0;
+   return memcmp(cache->bytes, section, section_len) == 0;
+}
+
+void psi_section_cache_store(psi_section_cache_t *cache, const uint8_t *section, size_t section_len)
+{
+   if (section_len > sizeof(cache->bytes))
+   {
+      cache->valid = 0;
+      return;
+   }
+   memcpy(cache->bytes, section, section_len);
+   cache->section_len = section_len;
+   cache->CRC_32 = psi_section_crc_field(section, section_len);
+   cache->valid = 1;
+}
+
 int program_map_section_read(program_map_section_t *pms, uint8_t *buf, size_t buf_size, uint32_t payload_unit_start_indicator,
    psi_table_buffer_t *pmtBuffer) 
 { 
@@ -626,12 +652,12 @@ int program_map_section_read(program_map_section_t *pms, uint8_t *buf, size_t bu
       return 0;
    }
    
-   read_descriptor_loop(pms->descriptors, b, pms->program_info_length); 
+   read_descriptor_loop(pms->descriptors, b, pms->program_info_length, pms->arena); 
 
    while (!bs_eof(b) && pms->section_length - (bs_pos(b) - section_start) > 4) // account for CRC
    {
-      elementary_stream_info_t *es = es_info_new();
-      es_info_read(es, b); 
+      elementary_stream_info_t *es = es_info_new(pms->arena);
+      es_info_read(es, b, pms->arena); 
       vqarray_add(pms->es_info, es);
    }
    
@@ -697,21 +723,17 @@ int program_map_section_print(program_map_section_t *pms, char *str, size_t str_
 
 conditional_access_section_t* conditional_access_section_new() 
 { 
-   conditional_access_section_t *cas = (conditional_access_section_t *)calloc(1, sizeof(conditional_access_section_t)); 
-   cas->descriptors = vqarray_new();
+   arena_t *arena = arena_new(PSI_ARENA_BLOCK_SIZE);
+   conditional_access_section_t *cas = (conditional_access_section_t *)arena_calloc(arena, 1, sizeof(conditional_access_section_t)); 
+   cas->arena = arena;
+   cas->descriptors = vqarray_new_in(arena);
    return cas;
 }
 
 void conditional_access_section_free(conditional_access_section_t *cas)
 {
    if (cas == NULL) return;
-
-   if (cas->descriptors != NULL)
-   {
-      vqarray_foreach(cas->descriptors, (vqarray_functor_t)descriptor_free);
-      vqarray_free(cas->descriptors);
-   }
-   free(cas);
+   arena_free(cas->arena);
 }
 
 int conditional_access_section_read(conditional_access_section_t *cas, uint8_t *buf, size_t buf_len, uint32_t payload_unit_start_indicator,
@@ -844,7 +866,7 @@ int conditional_access_section_read(conditional_access_section_t *cas, uint8_t *
    if (cas->section_number != 0 || cas->last_section_number != 0) LOG_WARN("Multi-section CAT is not supported yet/n"); 
    
    // read bytes 6,7
-   read_descriptor_loop(cas->descriptors, b, cas->section_length - 5 - 4 ); 
+   read_descriptor_loop(cas->descriptors, b, cas->section_length - 5 - 4, cas->arena); 
 
    // explanation: section_length gives us the length from the end of section_length
    // we used 5 bytes for the mandatory section fields, and will use another 4 bytes for CRC
@@ -856,7 +878,7 @@ int conditional_access_section_read(conditional_access_section_t *cas, uint8_t *
    
    // check CRC
    crc_t cas_crc = crc_init(); 
-   cas_crc = crc_update(cas_crc, buf, bs_pos(b) - 4); 
+   cas_crc = crc_update(cas_crc, b->start, bs_pos(b) - 4); 
    cas_crc = crc_finalize(cas_crc); 
    if (cas_crc != cas->CRC_32) 
    {
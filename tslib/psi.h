@@ -37,6 +37,7 @@
 #include "bs.h"
 #include "common.h"
 #include "vqarray.h"
+#include "arena.h"
 
 typedef enum {
 	program_association_section = 0,
@@ -56,6 +57,9 @@ typedef enum {
 #define MAX_PROGRAM_INFO_LEN	        0x03FF
 #define MAX_ES_INFO_LEN			0x03FF
 
+// a parsed PMT with a handful of streams and descriptors fits in one block
+#define PSI_ARENA_BLOCK_SIZE           4096
+
 typedef struct
 {
    uint8_t *buffer;
@@ -63,6 +67,18 @@ typedef struct
    size_t bufferUsedSz;
 } psi_table_buffer_t;
 
+/**
+ * Last section accepted on a PID.  PAT/PMT are repeated every ~100 ms and rarely change, so a
+ * section identical to the cached one is dropped without being parsed.
+ */
+typedef struct
+{
+   int valid;
+   uint32_t CRC_32;                         /// CRC_32 of the cached section, compared first
+   size_t section_len;                      /// including the 3-byte section header
+   uint8_t bytes[MAX_SECTION_LEN + 3];
+} psi_section_cache_t;
+
 
 // PAT
 
@@ -105,6 +121,8 @@ typedef struct {
    vqarray_t *descriptors; 
  
    uint32_t CRC_32;
+
+   arena_t *arena;   // owns the section and everything parsed from it
 } conditional_access_section_t; 
 
 conditional_access_section_t* conditional_access_section_new();
@@ -136,9 +154,13 @@ typedef struct {
    vqarray_t *descriptors; 
    vqarray_t *es_info; 
    uint32_t CRC_32;
+
+   arena_t *arena;   // owns the section and everything parsed from it
 } program_map_section_t; 
 
 program_map_section_t* program_map_section_new(); 
+// Takes another reference to the section; each reference is dropped with program_map_section_free
+program_map_section_t* program_map_section_ref(program_map_section_t *pms); 
 void program_map_section_free(program_map_section_t *pms); 
 
 int program_map_section_read(program_map_section_t *pms, uint8_t *buf, size_t buf_size, uint32_t payload_unit_start_indicator,
@@ -148,6 +170,21 @@ int program_map_section_print(program_map_section_t *pms, char *str, size_t str_
 
 void resetPSITableBuffer(psi_table_buffer_t *psiTableBuffer);
 
+/**
+ * Locates a section carried entirely in one TS packet payload.
+ * 
+ * @return start of the section, or NULL if the payload does not start a section, the section
+ *         spans several packets, or the packet completes a section being assembled in tableBuffer
+ */
+const uint8_t* psi_single_packet_section(const uint8_t *buf, size_t buf_len, uint32_t payload_unit_start_indicator,
+                                         const psi_table_buffer_t *tableBuffer, size_t *section_len);
+
+/**
+ * @return 1 if section is byte-identical to the cached one
+ */
+int psi_section_cache_match(const psi_section_cache_t *cache, const uint8_t *section, size_t section_len);
+void psi_section_cache_store(psi_section_cache_t *cache, const uint8_t *section, size_t section_len);
+
 
 // stream types
 #define STREAM_TYPE_MPEG1_VIDEO             0x01
@@ -189,6 +226,7 @@ void resetPSITableBuffer(psi_table_buffer_t *psiTableBuffer);
 #define STREAM_TYPE_IPMP		              0x7F
 //FIXME: handle registration descriptor
 #define STREAM_TYPE_AC3_AUDIO               0x81 // ATSC A/52B, A3.1 AC3 Stream Type
+#define STREAM_TYPE_EAC3_AUDIO              0x87 // ATSC A/52B, G3.1 Enhanced AC-3 Stream Type
 #define STREAM_TYPE_SCTE35                  0x86 
 
 
@@ -197,14 +235,16 @@ void resetPSITableBuffer(psi_table_buffer_t *psiTableBuffer);
 #define IS_VIDEO_STREAM(x) ((x == STREAM_TYPE_MPEG1_VIDEO) || \
                             (x == STREAM_TYPE_MPEG2_VIDEO) || \
                             (x == STREAM_TYPE_MPEG4_VIDEO) || \
-                            (x == STREAM_TYPE_AVC))
+                            (x == STREAM_TYPE_AVC) || \
+                            (x == STREAM_TYPE_HEVC))
 
 #define IS_AUDIO_STREAM(x) ((x == STREAM_TYPE_MPEG1_AUDIO) || \
                             (x == STREAM_TYPE_MPEG2_AUDIO) || \
                             (x == STREAM_TYPE_MPEG2_AAC) || \
                             (x == STREAM_TYPE_MPEG4_AAC) || \
                             (x == STREAM_TYPE_MPEG4_AAC_RAW) || \
-                            (x == STREAM_TYPE_AC3_AUDIO))
+                            (x == STREAM_TYPE_AC3_AUDIO) || \
+                            (x == STREAM_TYPE_EAC3_AUDIO))
 
 #define PAT_PID			0
 #define CAT_PID			1
@@ -0,0 +1,79 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "pts_timeline.h"
+
+void pts_timeline_init(pts_timeline_t *tl)
+{
+   tl->last = 0;
+   tl->valid = 0;
+}
+
+void pts_timeline_seed(pts_timeline_t *tl, uint64_t reference)
+{
+   if (tl->valid) return;
+
+   tl->last = reference;
+   tl->valid = 1;
+}
+
+uint64_t pts_unwrap(uint64_t reference, uint64_t pts)
+{
+   pts &= PTS_MASK;
+
+   uint64_t unwrapped = (reference & ~PTS_MASK) | pts;
+   if (unwrapped + PTS_MODULUS / 2 < reference)
+   {
+      unwrapped += PTS_MODULUS;   // wrapped around since reference
+   }
+   else if (unwrapped > reference + PTS_MODULUS / 2 && unwrapped >= PTS_MODULUS)
+   {
+      unwrapped -= PTS_MODULUS;   // from before reference's last wraparound
+   }
+   return unwrapped;
+}
+
+uint64_t pts_timeline_unwrap(pts_timeline_t *tl, uint64_t pts)
+{
+   if (!tl->valid)
+   {
+      tl->last = pts & PTS_MASK;
+      if (tl->last < PTS_MODULUS / 2)
+      {
+         tl->last += PTS_MODULUS;
+      }
+      tl->valid = 1;
+      return tl->last;
+   }
+
+   uint64_t unwrapped = pts_unwrap(tl->last, pts);
+   if (unwrapped > tl->last)
+   {
+      tl->last = unwrapped;
+   }
+   return unwrapped;
+}
@@ -0,0 +1,80 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TSLIB_PTS_TIMELINE_H_
+#define _TSLIB_PTS_TIMELINE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define PTS_MODULUS  (1ULL << 33)        /// PTS and DTS wrap around every 2^33 ticks of 90 kHz (~26.5 hours)
+#define PTS_MASK     (PTS_MODULUS - 1)
+
+/**
+ * Extends 33-bit PTS/DTS values to a 64-bit timeline that keeps growing across wraparounds, so
+ * that unwrapped values can be compared and subtracted directly.  Each value is placed in the
+ * wrap period that puts it nearest to the latest value seen, which allows for PTS reordering
+ * (B-frames) and for interleaved streams of the same program sharing one timeline.
+ *
+ * A timeline starting in the lower half of the PTS range starts one wrap period up, so that
+ * values from shortly before the start (e.g. another stream still before the wraparound) remain
+ * representable.
+ */
+typedef struct
+{
+   uint64_t last;    /// latest unwrapped value
+   int valid;        /// last holds a value
+} pts_timeline_t;
+
+void pts_timeline_init(pts_timeline_t *tl);
+
+/**
+ * Anchors an empty timeline to an unwrapped reference value, e.g. the timeline of another
+ * stream that the new one needs to be comparable with.  Does nothing if tl is already valid.
+ */
+void pts_timeline_seed(pts_timeline_t *tl, uint64_t reference);
+
+/**
+ * @return pts (of which only the low 33 bits are used) on the unwrapped timeline.
+ *         The timeline advances if the value is later than the latest one seen.
+ */
+uint64_t pts_timeline_unwrap(pts_timeline_t *tl, uint64_t pts);
+
+/**
+ * @return the value with the low 33 bits of pts nearest to the unwrapped reference.
+ *         Values before the start of the timeline stay in the first wrap period.
+ */
+uint64_t pts_unwrap(uint64_t reference, uint64_t pts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _TSLIB_PTS_TIMELINE_H_
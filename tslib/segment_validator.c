@@ -2,7 +2,7 @@
 #include "segment_validator.h"
 
 #include "mpeg2ts_demux.h"
-#include "h264_stream.h"
+#include "video_sap.h"
 
 
 static dash_validator_t *g_p_dash_validator;
@@ -150,7 +150,7 @@ int pmt_processor(mpeg2ts_program_t *m2p, void *arg)
             demux_validator->arg_destructor = NULL; 
             
             // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator); 
+            mpeg2ts_program_register_pid_processor(m2p, pi->es_info->elementary_PID, demux_handler, demux_validator, 0); 
           
             pid_validator = calloc(1, sizeof(pid_validator_t)); 
             pid_validator->PID = PID; 
@@ -208,7 +208,7 @@ int copy_pmt_info(mpeg2ts_program_t *m2p, dash_validator_t *dash_validator_sourc
             demux_validator->arg_destructor = NULL; 
             
             // hook PID processor to PID
-            mpeg2ts_program_register_pid_processor(m2p, PID, demux_handler, demux_validator); 
+            mpeg2ts_program_register_pid_processor(m2p, PID, demux_handler, demux_validator, 0); 
           
             pid_validator_dest = calloc(1, sizeof(pid_validator_t)); 
             pid_validator_dest->PID = PID; 
@@ -267,8 +267,8 @@ int validate_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_info, void
       }
    }
    
+   // CC errors and declared discontinuities are counted by the demuxer (see pid_cc_stats_t)
    // TODO: check for discontinuities
-   //       -> CC errors, declared discontinuities
    //       -> PCR-PCR distances, with some arbitrary tolerance
    // we need to figure out what to do here -- we can let PES parsing fail and get a notice
    
@@ -302,6 +302,9 @@ int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi, vqarra
          return 0;
    }
    
+   // frame-level checks below walk the complete payload
+   pes_flatten(pes); 
+
    ts_packet_t *first_ts = vqarray_get(ts_queue, 0);   
    pid_validator_t *pid_validator = dash_validator_find_pid(first_ts->header.PID);
    
@@ -358,33 +361,23 @@ int validate_pes_packet(pes_packet_t *pes, elementary_stream_info_t *esi, vqarra
             {
 //                printf ("VIDEO ANALYSIS: START\n");
 
-                int nal_start, nal_end;
-                int returnCode;
-                uint8_t* buf = pes->payload;
-                int len = pes->payload_len;
-
-                // walk the nal units in the PES payload and check to see if they are type 1 or type 5 -- these determine 
-                // SAP type
-                int index = 0;
-                while ((len > index) && ((returnCode = find_nal_unit(buf + index, len - index, &nal_start, &nal_end)) !=  0))
+                // SAP type from the start codes (and, for AVC, the start of the first slice header)
+                int sap_type = SAP_TYPE_NONE;
+                if (esi->stream_type == STREAM_TYPE_HEVC)
+                {
+                    sap_type = hevc_sap_classify(NULL, pes->payload, pes->payload_len, 0, NULL);
+                }
+                else if (esi->stream_type == STREAM_TYPE_MPEG2_VIDEO)
+                {
+                    sap_type = mpeg2_sap_classify(pes->payload, pes->payload_len, NULL);
+                }
+                else
+                {
+                    sap_type = avc_sap_classify(NULL, pes->payload, pes->payload_len, 1, NULL);
+                }
+                if (sap_type != SAP_TYPE_NONE)
                 {
- //                   printf("nal_start = %d, nal_end = %d \n", nal_start, nal_end);
-                    h264_stream_t* h = h264_new();
-                    read_nal_unit(h, &buf[nal_start + index], nal_end - nal_start);
- //                   printf("h->nal->nal_unit_type: %d \n", h->nal->nal_unit_type);
-                    if (h->nal->nal_unit_type == 5)
-                    {
-                        pid_validator->SAP_type = 1;
-                        break;
-                    }
-                    else if (h->nal->nal_unit_type == 1)
-                    {
-                        pid_validator->SAP_type = 2;
-                        break;
-                    }
-
-                    h264_free(h);
-                    index += nal_end;
+                    pid_validator->SAP_type = sap_type;
                 }
 
   //              printf ("VIDEO ANALYSIS: END\n");
@@ -515,7 +508,7 @@ int doSegmentValidation(dash_validator_t *dash_validator, char *fname, dash_vali
          mpeg2ts_program_t *prog = mpeg2ts_program_new(
              200,  // can I just use dummy values here?
              201);
-         prog->pmt = dash_validator_init->initializaion_segment_pmt;
+         prog->pmt = program_map_section_ref(dash_validator_init->initializaion_segment_pmt);
 
        LOG_INFO_ARGS("Adding initialization PSI info...program = %x", (unsigned int)prog);
          vqarray_add(m2s->programs, (void *)prog);
@@ -579,7 +572,7 @@ int doSegmentValidation(dash_validator_t *dash_validator, char *fname, dash_vali
    {
       mpeg2ts_program_t* m2p = vqarray_get(m2s->programs, 0);  // should be only one program
       printf ("m2p = %x\n", (unsigned int)m2p);
-      g_p_dash_validator->initializaion_segment_pmt = m2p->pmt;
+      g_p_dash_validator->initializaion_segment_pmt = program_map_section_ref(m2p->pmt);
    }
    
    mpeg2ts_stream_free(m2s); 
@@ -66,6 +66,8 @@ int stc_put_ts_packet(stc_t *stc, ts_packet_t *ts)
 { 
    if (stc == NULL || ts == NULL) return 0; 
    
+   ts_detach(ts); // queued until the next PCR arrives
+   
    uint64_t real_pcr = ts_read_pcr(ts); 
    
    if (real_pcr < PCR_MAX) 
@@ -75,7 +77,7 @@ int stc_put_ts_packet(stc_t *stc, ts_packet_t *ts)
       SKIT_PRINT_UINT64(real_pcr/300);
       SKIT_PRINT_DOUBLE(stc->pcr_rate);
 
-      if (stc->prev_pcr < PCR_MAX) 
+      if (stc->prev_pcr >= PCR_MAX) 
       {
          // this is the first PCR we're seeing in this stream
          stc->prev_pcr = real_pcr; 
@@ -85,7 +87,7 @@ int stc_put_ts_packet(stc_t *stc, ts_packet_t *ts)
       else 
       {
          // adjust for mod42 operations
-         uint64_t adj_pcr = (real_pcr > stc->prev_pcr) ? real_pcr : real_pcr + PCR_MAX; 
+         uint64_t adj_pcr = (real_pcr > stc->prev_pcr) ? real_pcr : real_pcr + PCR_MODULUS; 
          
          stc->pcr_rate = ((double)stc->num_bytes) / (adj_pcr - stc->prev_pcr); 
          
@@ -93,12 +95,11 @@ int stc_put_ts_packet(stc_t *stc, ts_packet_t *ts)
          
          for (int i = 1; (qtsp = vqarray_shift(stc->ts_in)) != NULL; i++) 
          {
-            qtsp->pcr_int = stc->prev_pcr + (uint64_t)llrint(i * TS_SIZE * stc->pcr_rate); 
-            if (qtsp->pcr_int >= PCR_MAX) 
+            qtsp->pcr_int = stc->prev_pcr + (uint64_t)llrint(i * TS_SIZE / stc->pcr_rate); 
+            if (qtsp->pcr_int >= PCR_MODULUS) 
             {
-               qtsp->pcr_int -= PCR_MAX;
+               qtsp->pcr_int -= PCR_MODULUS;
             }
-            qtsp->pcr_int = real_pcr; // debug
             vqarray_add(stc->ts_out, qtsp);
          }
          
@@ -131,12 +132,12 @@ void stc_flush(stc_t *stc)
    
    for (int i = 1; (qtsp = vqarray_shift(stc->ts_in)) != NULL; i++) 
    {
-      if (isnormal(qtsp->pcr_int)) 
+      if (qtsp->pcr_int >= PCR_MAX && stc->pcr_rate > 0) 
       {
-         qtsp->pcr_int = stc->prev_pcr + (uint64_t)llrint(i * TS_SIZE * stc->pcr_rate); 
-         if (qtsp->pcr_int >= PCR_MAX) 
+         qtsp->pcr_int = stc->prev_pcr + (uint64_t)llrint(i * TS_SIZE / stc->pcr_rate); 
+         if (qtsp->pcr_int >= PCR_MODULUS) 
          {
-            qtsp->pcr_int -= PCR_MAX;
+            qtsp->pcr_int -= PCR_MODULUS;
          }
       }
       
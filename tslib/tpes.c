@@ -33,15 +33,17 @@
 #include "libts_common.h"
 #include "log.h"
 #include "vqarray.h"
+#include "pts_timeline.h"
 
 pes_demux_t* pes_demux_new(pes_processor_t pes_processor) 
 { 
    
-   pes_demux_t *pdm = malloc(sizeof(pes_demux_t)); 
+   pes_demux_t *pdm = calloc(1, sizeof(pes_demux_t)); 
    if (pdm != NULL) 
    {
       pdm->ts_queue = vqarray_new(); 
       pdm->process_pes_packet = pes_processor; 
+      pdm->min_payload_len = 0; 
    }
    return pdm;
 }
@@ -54,6 +56,7 @@ void pes_demux_free(pes_demux_t *pdm)
       vqarray_foreach(pdm->ts_queue, (vqarray_functor_t)ts_free); 
       vqarray_free(pdm->ts_queue);
    }
+   free(pdm->vec); 
    
    if (pdm->pes_arg != NULL && pdm->pes_arg_destructor != NULL) 
    {
@@ -98,7 +101,12 @@ int pes_demux_process_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_in
          else
          {
          
-            buf_t *vec = malloc(packets_in_queue * sizeof(buf_t)); // can be optimized...
+            if (packets_in_queue > pdm->vec_size) 
+            {
+               pdm->vec_size = packets_in_queue * 2; 
+               pdm->vec = realloc(pdm->vec, pdm->vec_size * sizeof(buf_t));
+            }
+            buf_t *vec = pdm->vec; 
          
             for (int i = 0; i < packets_in_queue; i++)
             {
@@ -114,8 +122,11 @@ int pes_demux_process_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_in
                   vec[i].bytes = NULL;
                }
             }
+
+            // the PES payload is not copied: it stays in the queued TS packets, 
+            // which are freed right after the processor returns
             pes_packet_t *pes = pes_new();
-            pes_read_vec(pes, vec, packets_in_queue);
+            pes_read_vec_partial(pes, vec, packets_in_queue, pdm->min_payload_len);
             
             if (pdm->process_pes_packet != NULL) 
             {
@@ -126,8 +137,6 @@ int pes_demux_process_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_in
             {
                pes_free(pes);
             }
-         
-            free(vec);        
          }
          
          
@@ -142,12 +151,15 @@ int pes_demux_process_ts_packet(ts_packet_t *ts, elementary_stream_info_t *es_in
    }
    if ( ts != NULL ) 
    {
+       // the packet outlives the ingest buffer it may have been read from
+       ts_detach(ts);
        vqarray_add(pdm->ts_queue, ts);
    }
    return 1;   
 }
 
 char* pts_dts_to_string(uint64_t pts_dts, char inout[13]) {
+   pts_dts &= PTS_MASK; // print unwrapped values as carried in the stream
    uint32_t msec = (uint32_t)((pts_dts / 90) % 1000);
    uint32_t sec = (uint32_t)((pts_dts / 90000) % 60);
    uint32_t min = (uint32_t)((pts_dts / (90000 * 60)) % 60);
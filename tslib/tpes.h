@@ -61,6 +61,10 @@ typedef struct
    pes_processor_t process_pes_packet; 
    void *pes_arg; 
    pes_arg_destructor_t pes_arg_destructor;
+   size_t min_payload_len;  /// PES payload bytes the processor needs contiguous (default 0: header only).
+                            /// processors needing more either raise this or call pes_flatten
+   buf_t *vec;              /// scatter-gather list of TS payloads, reused between PES packets
+   int vec_size;            /// allocated entries in vec
 } pes_demux_t; 
 
 
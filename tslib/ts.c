@@ -48,14 +48,133 @@ ts_packet_t* ts_new()
    return ts;
 }
 
+static void ts_free_scte128_private_data(ts_adaptation_field_t *af) 
+{ 
+   if (af->scte128_private_data == NULL) return; 
+   
+   ts_scte128_private_data_t *scte128 = NULL; 
+   while ((scte128 = vqarray_pop(af->scte128_private_data)) != NULL) 
+   {
+      free(scte128->private_data_bytes.bytes); 
+      free(scte128);
+   }
+   vqarray_free(af->scte128_private_data); 
+   af->scte128_private_data = NULL;
+}
+
+// release everything the packet owns, leaving it ready for reuse
+static void ts_release(ts_packet_t *ts) 
+{ 
+   if (!(ts->flags & TS_FLAG_INPLACE)) 
+   {
+      if (ts->payload.bytes != NULL) free(ts->payload.bytes); 
+      if (ts->adaptation_field.private_data_bytes.bytes != NULL) free(ts->adaptation_field.private_data_bytes.bytes); 
+   }
+   ts_free_scte128_private_data(&ts->adaptation_field);
+   
+   memset(&ts->header, 0, sizeof(ts_header_t)); 
+   memset(&ts->adaptation_field, 0, sizeof(ts_adaptation_field_t)); 
+   ts->payload.bytes = NULL; 
+   ts->payload.len = 0; 
+   ts->bytes = NULL; 
+   ts->opaque = NULL; 
+   ts->pcr_int = UINT64_MAX; 
+   ts->arrival_time = 0; 
+   ts->status = 0; 
+   ts->flags = 0;
+}
+
 void ts_free(ts_packet_t *ts) 
 { 
    if (ts == NULL) return; 
-   if (ts->payload.bytes != NULL) free(ts->payload.bytes); 
-   if (ts->adaptation_field.private_data_bytes.bytes != NULL) free(ts->adaptation_field.private_data_bytes.bytes); 
+   
+   ts_release(ts); 
+   
+   if (ts->pool != NULL) 
+   {
+      ts_pool_t *pool = ts->pool; 
+      pool->free_packets[pool->num_free++] = ts; 
+      return;
+   }
    free(ts);
 }
 
+ts_pool_t* ts_pool_new(size_t slab_size) 
+{ 
+   ts_pool_t *pool = calloc(1, sizeof(ts_pool_t)); 
+   pool->slab_size = (slab_size > 0) ? slab_size : TS_POOL_DEFAULT_SLAB_SIZE; 
+   pool->slabs = vqarray_new(); 
+   return pool;
+}
+
+void ts_pool_free(ts_pool_t *pool) 
+{ 
+   if (pool == NULL) return; 
+   
+   if (pool->num_free != pool->num_packets) 
+   {
+      LOG_WARN_ARGS("Freeing TS packet pool with %zu packets still in use", pool->num_packets - pool->num_free);
+   }
+   
+   vqarray_foreach(pool->slabs, free); 
+   vqarray_free(pool->slabs); 
+   free(pool->free_packets); 
+   free(pool);
+}
+
+static int ts_pool_grow(ts_pool_t *pool) 
+{ 
+   ts_packet_t *slab = calloc(pool->slab_size, sizeof(ts_packet_t)); 
+   ts_packet_t **free_packets = realloc(pool->free_packets, (pool->num_packets + pool->slab_size) * sizeof(ts_packet_t *)); 
+   if (slab == NULL || free_packets == NULL) 
+   {
+      free(slab); 
+      if (free_packets != NULL) pool->free_packets = free_packets; 
+      return 0;
+   }
+   pool->free_packets = free_packets; 
+   vqarray_add(pool->slabs, slab); 
+   
+   for (size_t i = 0; i < pool->slab_size; i++) 
+   {
+      slab[i].pool = pool; 
+      slab[i].pcr_int = UINT64_MAX; 
+      pool->free_packets[pool->num_free++] = &slab[i];
+   }
+   pool->num_packets += pool->slab_size; 
+   
+   return 1;
+}
+
+ts_packet_t* ts_pool_get(ts_pool_t *pool) 
+{ 
+   if (pool == NULL) return ts_new(); 
+   
+   if (pool->num_free == 0 && !ts_pool_grow(pool)) 
+   {
+      LOG_ERROR("Cannot grow TS packet pool"); 
+      return NULL;
+   }
+   return pool->free_packets[--pool->num_free];
+}
+
+void ts_detach(ts_packet_t *ts) 
+{ 
+   if (ts == NULL || !(ts->flags & TS_FLAG_INPLACE) || ts->bytes == NULL || ts->bytes == ts->storage) return; 
+   
+   memcpy(ts->storage, ts->bytes, TS_SIZE); 
+   
+   if (ts->payload.bytes != NULL) 
+   {
+      ts->payload.bytes = ts->storage + (ts->payload.bytes - ts->bytes);
+   }
+   if (ts->adaptation_field.private_data_bytes.bytes != NULL) 
+   {
+      ts->adaptation_field.private_data_bytes.bytes = ts->storage + (ts->adaptation_field.private_data_bytes.bytes - ts->bytes);
+   }
+   ts->bytes = ts->storage;
+}
+
 int ts_read_header(ts_header_t *tsh, bs_t *b) 
 { 
    if (tsh == NULL) return 0; 
@@ -86,7 +205,7 @@ int ts_read_header(ts_header_t *tsh, bs_t *b)
    return (bs_pos(b) - start_pos);
 }
 
-int ts_read_adaptation_field(ts_adaptation_field_t *af, bs_t *b) 
+static int ts_read_adaptation_field_internal(ts_adaptation_field_t *af, bs_t *b, int inplace) 
 { 
    af->adaptation_field_length = bs_read_u8(b); 
    int start_pos = bs_pos(b); 
@@ -128,8 +247,16 @@ int ts_read_adaptation_field(ts_adaptation_field_t *af, bs_t *b)
             if (af->transport_private_data_length > 0) 
             {
                af->private_data_bytes.len = af->transport_private_data_length; 
-               af->private_data_bytes.bytes = malloc(af->private_data_bytes.len); 
-               bs_read_bytes(b, af->private_data_bytes.bytes, af->transport_private_data_length);
+               if (inplace) 
+               {
+                  af->private_data_bytes.bytes = b->p; 
+                  af->private_data_bytes.len = bs_skip_bytes(b, af->transport_private_data_length);
+               }
+               else 
+               {
+                  af->private_data_bytes.bytes = malloc(af->private_data_bytes.len); 
+                  bs_read_bytes(b, af->private_data_bytes.bytes, af->transport_private_data_length);
+               }
             }
          }
          
@@ -173,6 +300,11 @@ int ts_read_adaptation_field(ts_adaptation_field_t *af, bs_t *b)
    return (1 + bs_pos(b) - start_pos);
 }
 
+int ts_read_adaptation_field(ts_adaptation_field_t *af, bs_t *b) 
+{ 
+   return ts_read_adaptation_field_internal(af, b, 0);
+}
+
 int ts_parse_scte128_af_private(ts_adaptation_field_t *af)
 {
    if (af == NULL || af->private_data_bytes.len == 0)
@@ -180,6 +312,7 @@ int ts_parse_scte128_af_private(ts_adaptation_field_t *af)
       return 0;
    }
 
+   ts_free_scte128_private_data(af);
    af->scte128_private_data = vqarray_new();
    bs_t b;
    bs_init(&b, af->private_data_bytes.bytes, af->private_data_bytes.len);
@@ -222,7 +355,23 @@ int ts_parse_scte128_af_private(ts_adaptation_field_t *af)
    return 1;
 }
 
-int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size) 
+vqarray_t* ts_get_scte128_private_data(ts_packet_t *ts)
+{
+   if (ts == NULL || !(ts->flags & TS_FLAG_SCTE128) || !TS_HAS_ADAPTATION_FIELD(*ts))
+   {
+      return NULL;
+   }
+
+   if (!(ts->flags & TS_FLAG_SCTE128_PARSED))
+   {
+      ts_parse_scte128_af_private(&ts->adaptation_field);
+      ts->flags |= TS_FLAG_SCTE128_PARSED;
+   }
+
+   return ts->adaptation_field.scte128_private_data;
+}
+
+int ts_read_inplace(ts_packet_t *ts, uint8_t *buf, size_t buf_size) 
 { 
    if (buf == NULL || buf_size < TS_SIZE || ts == NULL) 
    {
@@ -233,6 +382,9 @@ int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size)
    bs_t b; 
    bs_init(&b, buf, TS_SIZE); 
    memset(&(ts->header), 0x00, sizeof(ts_header_t)); 
+   
+   ts->bytes = buf; 
+   ts->flags |= TS_FLAG_INPLACE;
 
    int res = 0;
 
@@ -245,7 +397,7 @@ int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size)
    if (ts->header.adaptation_field_control & TS_ADAPTATION_FIELD) 
    {
       memset(&(ts->adaptation_field), 0x00, sizeof(ts_adaptation_field_t)); 
-      if ( (res = ts_read_adaptation_field(&(ts->adaptation_field), &b)) < 1 )
+      if ( (res = ts_read_adaptation_field_internal(&(ts->adaptation_field), &b, 1)) < 1 )
       {
          SAFE_REPORT_TS_ERR(-3); 
          return res;
@@ -255,8 +407,8 @@ int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size)
    if (ts->header.adaptation_field_control & TS_PAYLOAD) 
    {
       ts->payload.len = TS_SIZE - bs_pos(&b); 
-      ts->payload.bytes = malloc(ts->payload.len); 
-      bs_read_bytes(&b, ts->payload.bytes, ts->payload.len);
+      ts->payload.bytes = b.p; 
+      bs_skip_bytes(&b, ts->payload.len);
    }
    
    // FIXME read and interpret pointer field
@@ -264,6 +416,21 @@ int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size)
    return bs_pos(&b);
 }
 
+int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size) 
+{ 
+   if (buf == NULL || buf_size < TS_SIZE || ts == NULL) 
+   {
+      SAFE_REPORT_TS_ERR(-1); 
+      return TS_ERROR_NOT_ENOUGH_DATA;
+   }
+   
+   // copy the raw bytes into the packet and parse them in place there: no
+   // per-packet allocations, and the packet can still be copied later
+   // (e.g. for a PID shared by several programs)
+   memcpy(ts->storage, buf, TS_SIZE); 
+   return ts_read_inplace(ts, ts->storage, TS_SIZE);
+}
+
 int ts_adaptation_field_extension_min_length(ts_adaptation_field_t *af) 
 { 
    if (!af->adaptation_field_extension_flag) return 0; 
@@ -53,6 +53,14 @@ extern "C"
 #define PCR_MAX          (1LL << 42)
 #define PCR_INVALID       INT64_MAX
 #define PCR_IS_VALID(P)  ( ( (P) >= 0 ) && ((P) <  PCR_MAX))
+#define PCR_MODULUS      (300LL * (1LL << 33))  /// PCR wraps around at 2^33 * 300 ticks of the 27 MHz clock
+#define PCR_FREQUENCY    27000000LL
+
+#define TS_FLAG_INPLACE        0x01 /// payload and AF private data point into ts->bytes rather than own allocations
+#define TS_FLAG_SCTE128        0x02 /// AF private data on this PID is SCTE-128 formatted
+#define TS_FLAG_SCTE128_PARSED 0x04 /// scte128_private_data has been parsed (and may legitimately be NULL)
+
+#define TS_POOL_DEFAULT_SLAB_SIZE 1024
 
 typedef struct {
    uint32_t transport_error_indicator;
@@ -108,27 +116,75 @@ typedef struct {
 
 } ts_adaptation_field_t;
 
+struct _ts_pool_;
+
 typedef struct {
    ts_header_t header;
    ts_adaptation_field_t adaptation_field;
-   uint8_t *bytes;     /// bytes of the *complete* TS packet, managed by the caller. we know its size is 188 bytes
+   uint8_t *bytes;     /// bytes of the *complete* TS packet: the caller's buffer for ts_read_inplace, storage otherwise. we know its size is 188 bytes
 
    buf_t payload;      /// start of the payload
 
    uint8_t *opaque;    /// opaque user-defined pointer. memory is managed by the user
    uint64_t pcr_int;   /// interpolated PCR
+   uint64_t arrival_time;  /// receive time in ns since the epoch (e.g. from SO_TIMESTAMPNS), 0 if unknown
 
    int status;
 
+   uint32_t flags;               /// TS_FLAG_*
+   struct _ts_pool_ *pool;       /// pool the packet returns to on ts_free, NULL if heap-allocated
+   uint8_t storage[TS_SIZE];     /// packet-owned copy of the raw bytes, filled by ts_read and ts_detach
+
 } ts_packet_t;
 
+/**
+ * Slab allocator for TS packets. Packets are handed out by ts_pool_get and
+ * go back to the pool when ts_free is called on them, so steady-state ingest
+ * does no malloc/free per packet.
+ * 
+ * @note a pool is not thread-safe: get and free must happen on the same thread.
+ *       All packets must be returned before the pool itself is freed.
+ */
+typedef struct _ts_pool_ 
+{
+   ts_packet_t **free_packets; /// stack of packets available for reuse
+   size_t num_free; 
+   size_t num_packets;         /// total number of packets allocated by this pool
+   size_t slab_size;           /// number of packets allocated at once
+   vqarray_t *slabs;           /// blocks of slab_size packets
+} ts_pool_t; 
+
 ts_packet_t* ts_new();
 void ts_free(ts_packet_t *ts);
 
+ts_pool_t* ts_pool_new(size_t slab_size); 
+void ts_pool_free(ts_pool_t *pool); 
+ts_packet_t* ts_pool_get(ts_pool_t *pool); 
+
 int ts_read_header(ts_header_t *tsh, bs_t *b);
 int ts_read_adaptation_field(ts_adaptation_field_t *af, bs_t *b);
+
+/**
+ * Parse a TS packet into the packet's own storage: the 188 bytes are copied,
+ * and payload and adaptation field private data then point into storage.
+ */
 int ts_read(ts_packet_t *ts, uint8_t *buf, size_t buf_size);
 
+/**
+ * Parse a TS packet without copying: payload and adaptation field private data
+ * point into buf, which must stay valid until the packet is freed or detached.
+ * 
+ * @see ts_detach
+ */
+int ts_read_inplace(ts_packet_t *ts, uint8_t *buf, size_t buf_size);
+
+/**
+ * Make a packet parsed with ts_read_inplace independent of the caller's buffer
+ * by copying the 188 raw bytes into the packet's own storage.
+ * Must be called by anyone who keeps the packet past the current call.
+ */
+void ts_detach(ts_packet_t *ts);
+
 int ts_write_adaptation_field(ts_adaptation_field_t *af, bs_t *b);
 int ts_write_header(ts_header_t *tsh, bs_t *b);
 int ts_write(ts_packet_t *ts, uint8_t *buf, size_t buf_size);
@@ -139,6 +195,15 @@ int ts_print(const ts_packet_t *const ts, char *str, size_t str_len);
 
 int ts_parse_scte128_af_private(ts_adaptation_field_t *af);
 
+/**
+ * Get the SCTE-128 private data records of a packet, parsing them on first use.
+ * Only packets marked with TS_FLAG_SCTE128 (by the demux, for PIDs that asked for
+ * SCTE-128 parsing) are parsed; the result is cached in the packet.
+ * 
+ * @return vqarray of ts_scte128_private_data_t, or NULL if there is none
+ */
+vqarray_t* ts_get_scte128_private_data(ts_packet_t *ts);
+
 int64_t ts_read_pcr(const ts_packet_t* const ts);
 
 
@@ -0,0 +1,240 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define _DEFAULT_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ts_source.h"
+#include "libts_common.h"
+#include "log.h"
+
+// files are mapped this much at a time; each window is unmapped as soon as the reader moves past it
+#define TS_SOURCE_MMAP_WINDOW    (64 * 1024 * 1024)
+
+// read buffer for files that cannot be mapped
+#define TS_SOURCE_READ_BUF_SIZE  (4096 * TS_SIZE_RS)
+
+typedef struct
+{
+   int fd;
+   char *fname;
+   int stride;              /// packet size of the last acquire, for release
+
+   // mmap mode
+   uint64_t file_size;
+   uint64_t pos;            /// file offset of the next unconsumed byte
+   uint8_t *window;         /// current mapping, NULL if none
+   uint64_t window_start;   /// file offset of the mapping, page aligned
+   size_t window_size;
+   size_t page_size;
+
+   // read mode (buf != NULL)
+   uint8_t *buf;
+   size_t buf_bytes;        /// valid bytes in buf
+   size_t buf_pos;          /// next unconsumed byte in buf
+   int eof;
+} ts_file_source_t;
+
+ts_source_t* ts_source_new(ts_source_acquire_t acquire, ts_source_release_t release, void *arg,
+                           ts_source_arg_destructor_t arg_destructor)
+{
+   ts_source_t *src = calloc(1, sizeof(ts_source_t));
+   src->acquire = acquire;
+   src->release = release;
+   src->arg = arg;
+   src->arg_destructor = arg_destructor;
+   ts_sync_init(&src->sync);
+   return src;
+}
+
+void ts_source_free(ts_source_t *src)
+{
+   if (src == NULL) return;
+   if (src->arg_destructor != NULL) src->arg_destructor(src->arg);
+   free(src);
+}
+
+static int ts_file_source_map(ts_file_source_t *fs)
+{
+   if (fs->window != NULL)
+   {
+      munmap(fs->window, fs->window_size);
+      fs->window = NULL;
+   }
+
+   fs->window_start = fs->pos & ~((uint64_t)fs->page_size - 1);
+   uint64_t size = fs->file_size - fs->window_start;
+   fs->window_size = (size > TS_SOURCE_MMAP_WINDOW) ? TS_SOURCE_MMAP_WINDOW : (size_t)size;
+
+   void *window = mmap(NULL, fs->window_size, PROT_READ, MAP_PRIVATE, fs->fd, (off_t)fs->window_start);
+   if (window == MAP_FAILED) return -1;
+   fs->window = window;
+
+#ifdef MADV_SEQUENTIAL
+   madvise(fs->window, fs->window_size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+   madvise(fs->window, fs->window_size, MADV_WILLNEED);
+#endif
+   return 0;
+}
+
+static int ts_file_source_acquire_mmap(ts_source_t *src, uint8_t **packets, int max_packets)
+{
+   ts_file_source_t *fs = (ts_file_source_t *)src->arg;
+
+   while (fs->pos < fs->file_size)
+   {
+      if (fs->window == NULL || fs->pos >= fs->window_start + fs->window_size)
+      {
+         if (ts_file_source_map(fs) != 0)
+         {
+            LOG_ERROR_ARGS("Cannot map %s at offset %"PRIu64" - %s", fs->fname, fs->window_start, strerror(errno));
+            return -1;
+         }
+      }
+
+      uint64_t window_end = fs->window_start + fs->window_size;
+      uint8_t *buf = fs->window + (fs->pos - fs->window_start);
+      size_t start = 0;
+      int num_packets = ts_sync_scan(&src->sync, buf, (size_t)(window_end - fs->pos), window_end == fs->file_size,
+                                     max_packets, &start);
+      fs->pos += start;
+      if (num_packets > 0)
+      {
+         fs->stride = src->sync.packet_size;
+         for (int i = 0; i < num_packets; i++) packets[i] = buf + start + i * fs->stride;
+         return num_packets;
+      }
+
+      // the rest of the window is not enough to go on: map from here
+      if (fs->pos < fs->file_size && ts_file_source_map(fs) != 0)
+      {
+         LOG_ERROR_ARGS("Cannot map %s at offset %"PRIu64" - %s", fs->fname, fs->window_start, strerror(errno));
+         return -1;
+      }
+   }
+   return 0;
+}
+
+static void ts_file_source_release_mmap(ts_source_t *src, int num_packets)
+{
+   ts_file_source_t *fs = (ts_file_source_t *)src->arg;
+   fs->pos += (uint64_t)num_packets * fs->stride;
+   if (fs->pos > fs->file_size) fs->pos = fs->file_size;   // last packet of the file without its parity bytes
+}
+
+static int ts_file_source_acquire_read(ts_source_t *src, uint8_t **packets, int max_packets)
+{
+   ts_file_source_t *fs = (ts_file_source_t *)src->arg;
+
+   while (1)
+   {
+      uint8_t *buf = fs->buf + fs->buf_pos;
+      size_t start = 0;
+      int num_packets = ts_sync_scan(&src->sync, buf, fs->buf_bytes - fs->buf_pos, fs->eof, max_packets, &start);
+      fs->buf_pos += start;
+      if (num_packets > 0)
+      {
+         fs->stride = src->sync.packet_size;
+         for (int i = 0; i < num_packets; i++) packets[i] = buf + start + i * fs->stride;
+         return num_packets;
+      }
+      if (fs->eof) return 0;
+
+      // keep what is left at the front and read more behind it
+      size_t leftover = fs->buf_bytes - fs->buf_pos;
+      memmove(fs->buf, fs->buf + fs->buf_pos, leftover);
+      fs->buf_bytes = leftover;
+      fs->buf_pos = 0;
+
+      ssize_t num_read = read(fs->fd, fs->buf + fs->buf_bytes, TS_SOURCE_READ_BUF_SIZE - fs->buf_bytes);
+      if (num_read < 0)
+      {
+         if (errno == EINTR) continue;
+         LOG_ERROR_ARGS("Error reading %s - %s", fs->fname, strerror(errno));
+         return -1;
+      }
+      if (num_read == 0) fs->eof = 1;
+      fs->buf_bytes += num_read;
+   }
+}
+
+static void ts_file_source_release_read(ts_source_t *src, int num_packets)
+{
+   ts_file_source_t *fs = (ts_file_source_t *)src->arg;
+   fs->buf_pos += (size_t)num_packets * fs->stride;
+   if (fs->buf_pos > fs->buf_bytes) fs->buf_pos = fs->buf_bytes;   // last packet of the file without its parity bytes
+}
+
+static int ts_file_source_free(void *arg)
+{
+   ts_file_source_t *fs = (ts_file_source_t *)arg;
+   if (fs->window != NULL) munmap(fs->window, fs->window_size);
+   free(fs->buf);
+   free(fs->fname);
+   close(fs->fd);
+   free(fs);
+   return 0;
+}
+
+ts_source_t* ts_source_new_file(const char *fname)
+{
+   int fd = open(fname, O_RDONLY);
+   if (fd < 0)
+   {
+      LOG_ERROR_ARGS("Cannot open file %s - %s", fname, strerror(errno));
+      return NULL;
+   }
+
+   ts_file_source_t *fs = calloc(1, sizeof(ts_file_source_t));
+   fs->fd = fd;
+   fs->fname = strdup(fname);
+   fs->page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+   struct stat st;
+   if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+   {
+      fs->file_size = (uint64_t)st.st_size;
+      if (ts_file_source_map(fs) == 0)
+      {
+         return ts_source_new(ts_file_source_acquire_mmap, ts_file_source_release_mmap, fs, ts_file_source_free);
+      }
+      LOG_INFO_ARGS("Cannot map %s (%s), reading it instead", fname, strerror(errno));
+   }
+
+   fs->buf = malloc(TS_SOURCE_READ_BUF_SIZE);
+   return ts_source_new(ts_file_source_acquire_read, ts_file_source_release_read, fs, ts_file_source_free);
+}
@@ -0,0 +1,115 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _TSLIB_TS_SOURCE_H_
+#define _TSLIB_TS_SOURCE_H_
+
+#include <stdint.h>
+
+#include "ts.h"
+#include "ts_sync.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct _ts_source_;
+
+/// store pointers to up to max_packets TS packets in packets[]; returns the number of packets, 0 at end of stream, < 0 on error
+typedef int (*ts_source_acquire_t)(struct _ts_source_ *src, uint8_t **packets, int max_packets);
+/// give back num_packets packets from the start of the last acquire
+typedef void (*ts_source_release_t)(struct _ts_source_ *src, int num_packets);
+/// receive time in ns of an acquired packet, 0 if unknown
+typedef uint64_t (*ts_source_arrival_time_t)(struct _ts_source_ *src, uint8_t *packet);
+typedef int (*ts_source_arg_destructor_t)(void *);
+
+/**
+ * Source of raw TS packets for the demuxer.  Packets are handed out in place (in a file mapping, a
+ * ring buffer, ...) so they can be parsed with ts_read_inplace; they stay valid until released, and
+ * nothing may be acquired again before the previous packets are released.  Anything kept past the
+ * release must be detached (see ts_detach).  Whatever the framing of the underlying data, every
+ * packet handed out is 188 bytes starting with a sync byte.
+ *
+ * Typical use:
+ *
+ *    uint8_t *packets[TS_SOURCE_MAX_PACKETS];
+ *    while ((n = ts_source_acquire(src, packets, TS_SOURCE_MAX_PACKETS)) > 0)
+ *    {
+ *       for (int i = 0; i < n; i++) ... ts_read_inplace(ts, packets[i], TS_SIZE) ...
+ *       ts_source_release(src, n);
+ *    }
+ */
+typedef struct _ts_source_
+{
+   ts_source_acquire_t acquire;
+   ts_source_release_t release;
+   ts_source_arrival_time_t arrival_time;   /// NULL if the source has no arrival times
+   void *arg;                               /// source state
+   ts_source_arg_destructor_t arg_destructor;
+   uint64_t packets_read;                   /// total packets released so far
+   ts_sync_t sync;                          /// framing, for sources that find packets in raw bytes (files)
+} ts_source_t;
+
+#define TS_SOURCE_MAX_PACKETS 4096   /// a reasonable batch for ts_source_acquire
+
+ts_source_t* ts_source_new(ts_source_acquire_t acquire, ts_source_release_t release, void *arg,
+                           ts_source_arg_destructor_t arg_destructor);
+void ts_source_free(ts_source_t *src);
+
+/**
+ * Packets of a file.  Regular files are memory mapped a window at a time, with sequential
+ * readahead requested from the kernel and each window unmapped once it has been consumed, so
+ * captures of any size are read without copying.  Anything that cannot be mapped (a pipe, a
+ * device) is read into a buffer instead.  188, 192 (M2TS) and 204-byte packets are accepted and
+ * sync is reacquired after corruption (see ts_sync_t); src->sync has the statistics.
+ *
+ * @return the source, or NULL if the file cannot be opened
+ */
+ts_source_t* ts_source_new_file(const char *fname);
+
+static inline int ts_source_acquire(ts_source_t *src, uint8_t **packets, int max_packets)
+{
+   return src->acquire(src, packets, max_packets);
+}
+
+static inline void ts_source_release(ts_source_t *src, int num_packets)
+{
+   src->release(src, num_packets);
+   src->packets_read += num_packets;
+}
+
+static inline uint64_t ts_source_arrival_time(ts_source_t *src, uint8_t *packet)
+{
+   return (src->arrival_time == NULL) ? 0 : src->arrival_time(src, packet);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
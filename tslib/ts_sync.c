@@ -0,0 +1,207 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string.h>
+
+#include "ts_sync.h"
+#include "libts_common.h"
+#include "log.h"
+
+// tried in this order when searching
+static const int ts_sync_packet_sizes[] = { TS_SIZE, TS_SIZE_M2TS, TS_SIZE_RS };
+
+void ts_sync_init(ts_sync_t *sync)
+{
+   memset(sync, 0, sizeof(ts_sync_t));
+}
+
+void ts_sync_restart(ts_sync_t *sync)
+{
+   sync->locked = 0;
+}
+
+const char* ts_sync_packet_size_name(int packet_size)
+{
+   switch (packet_size)
+   {
+   case TS_SIZE:      return "188-byte TS";
+   case TS_SIZE_M2TS: return "192-byte M2TS";
+   case TS_SIZE_RS:   return "204-byte TS";
+   default:           return "unknown";
+   }
+}
+
+// a packet at pos can be handed out: the whole stride is there, or at least its 188 bytes at the end of the stream
+static inline int ts_sync_fits(size_t pos, size_t len, int stride, int is_eof)
+{
+   return pos + (is_eof ? TS_SIZE : stride) <= len;
+}
+
+// the sync byte at buf[pos] repeats need times at the given stride
+static inline int ts_sync_repeats(const uint8_t *buf, size_t pos, size_t len, int stride, int need)
+{
+   if (pos + (size_t)(need - 1) * stride >= len) return 0;
+   for (int k = 1; k < need; k++)
+   {
+      if (buf[pos + k * stride] != TS_SYNC_BYTE) return 0;
+   }
+   return 1;
+}
+
+/**
+ * Look for a framing starting at the sync byte at buf[pos], trying the previous packet size first.
+ * Returns the stride if the sync byte repeats at it TS_SYNC_LOCK_PACKETS times (at the end of the
+ * stream, as many times as there is data for), 0 if it does not at any stride, -1 if there is not
+ * enough data to tell yet.
+ */
+static int ts_sync_try_lock(const uint8_t *buf, size_t pos, size_t len, int is_eof, int previous_size)
+{
+   for (int s = -1; s < (int)(sizeof(ts_sync_packet_sizes) / sizeof(ts_sync_packet_sizes[0])); s++)
+   {
+      if (s >= 0 && ts_sync_packet_sizes[s] == previous_size) continue;
+      int stride = (s < 0) ? previous_size : ts_sync_packet_sizes[s];
+      if (stride == 0) continue;
+      int need = TS_SYNC_LOCK_PACKETS;
+      if (pos + (need - 1) * stride >= len)
+      {
+         if (!is_eof) return -1;
+         if (pos + TS_SIZE > len) return 0;
+         need = (len - pos - 1) / stride + 1;
+      }
+
+      if (ts_sync_repeats(buf, pos, len, stride, need)) return stride;
+   }
+   return 0;
+}
+
+int ts_sync_scan(ts_sync_t *sync, const uint8_t *buf, size_t len, int is_eof, int max_packets, size_t *start)
+{
+   size_t pos = 0;
+   int num_packets = 0;
+
+   while (max_packets > 0 && pos < len)
+   {
+      if (sync->locked)
+      {
+         int stride = sync->packet_size;
+         if (!ts_sync_fits(pos, len, stride, is_eof))
+         {
+            if (is_eof)
+            {
+               sync->skipped_bytes += len - pos;
+               pos = len;
+            }
+            break;
+         }
+
+         if (buf[pos] == TS_SYNC_BYTE)
+         {
+            num_packets = 1;
+            while (num_packets < max_packets && ts_sync_fits(pos + num_packets * stride, len, stride, is_eof) &&
+                   buf[pos + num_packets * stride] == TS_SYNC_BYTE)
+            {
+               num_packets++;
+            }
+            break;
+         }
+
+         // corrupted sync byte: drop the packet if the next one is in sync, otherwise sync is lost
+         if (pos + stride >= len)
+         {
+            if (is_eof)
+            {
+               sync->skipped_bytes += len - pos;
+               pos = len;
+            }
+            break;
+         }
+         if (buf[pos + stride] == TS_SYNC_BYTE)
+         {
+            LOG_WARN("Corrupted sync byte, dropping packet");
+            sync->skipped_bytes += stride;
+            pos += stride;
+            continue;
+         }
+
+         LOG_WARN_ARGS("Lost sync on %s packets", ts_sync_packet_size_name(stride));
+         sync->locked = 0;
+         sync->resyncing = 1;
+         sync->lost_sync_events++;
+      }
+
+      // search: memchr is vectorized in any decent libc, so junk is skipped quickly
+      const uint8_t *candidate = memchr(buf + pos, TS_SYNC_BYTE, len - pos);
+      if (candidate == NULL)
+      {
+         sync->skipped_bytes += len - pos;
+         pos = len;
+         break;
+      }
+      sync->skipped_bytes += (candidate - buf) - pos;
+      pos = candidate - buf;
+
+      int stride = ts_sync_try_lock(buf, pos, len, is_eof, sync->packet_size);
+      if (stride < 0) break;
+      if (stride == 0)
+      {
+         sync->skipped_bytes++;
+         pos++;
+         continue;
+      }
+
+      // M2TS header bytes (copy permission and arrival time stamp) can be 0x47 for many packets in a row:
+      // if the packets also line up up to 4 bytes later, that is the real sync byte
+      if (stride == TS_SIZE_M2TS)
+      {
+         for (int shift = 4; shift > 0; shift--)
+         {
+            size_t shifted = pos + shift;
+            if (shifted + TS_SIZE > len || buf[shifted] != TS_SYNC_BYTE) continue;
+
+            int need = (shifted + (TS_SYNC_LOCK_PACKETS - 1) * stride < len) ? TS_SYNC_LOCK_PACKETS :
+                       (int)((len - shifted - 1) / stride + 1);
+            if (ts_sync_repeats(buf, shifted, len, stride, need))
+            {
+               sync->skipped_bytes += shift;
+               pos = shifted;
+               break;
+            }
+         }
+      }
+
+      if (stride != sync->packet_size || sync->resyncing)
+      {
+         LOG_INFO_ARGS("Locked on %s packets", ts_sync_packet_size_name(stride));
+      }
+      sync->packet_size = stride;
+      sync->locked = 1;
+      sync->resyncing = 0;
+   }
+
+   *start = pos;
+   return num_packets;
+}
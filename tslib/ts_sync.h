@@ -0,0 +1,90 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _TSLIB_TS_SYNC_H_
+#define _TSLIB_TS_SYNC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ts.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TS_SIZE_M2TS            192  /// 4-byte TP_extra_header (BDAV/M2TS recorders) + 188
+#define TS_SIZE_RS              204  /// 188 + 16 bytes of Reed-Solomon parity (DVB-ASI)
+
+#define TS_SYNC_LOCK_PACKETS      5  /// consecutive sync bytes at the same stride needed to lock
+
+/**
+ * Packet framing of a byte stream.  Searches for sync bytes repeating at a stride of 188, 192 or
+ * 204 bytes, locks onto the first stride seen TS_SYNC_LOCK_PACKETS times in a row and from then on
+ * only checks the sync byte of each packet.  A single corrupted sync byte drops that packet; two
+ * in a row lose sync and start a new search.
+ *
+ * Whatever the stride, the packets handed out are the 188 bytes starting at each sync byte: the
+ * M2TS header before it and the parity bytes after it are skipped.
+ */
+typedef struct
+{
+   int packet_size;            /// stride of the locked framing (TS_SIZE, TS_SIZE_M2TS or TS_SIZE_RS), 0 before the first lock
+   int locked;
+   int resyncing;              /// searching again after losing sync
+   uint64_t lost_sync_events;  /// times a locked framing was lost
+   uint64_t skipped_bytes;     /// bytes discarded: searching for sync, corrupted packets, trailing partial packets
+} ts_sync_t;
+
+void ts_sync_init(ts_sync_t *sync);
+
+/**
+ * Start a new search at the next scan without counting a loss of sync, for data that does not
+ * continue the previous data's framing (e.g. each UDP datagram, which may start with an RTP header).
+ * The packet size found so far is tried first.
+ */
+void ts_sync_restart(ts_sync_t *sync);
+
+/**
+ * Frame the packets at the start of buf.
+ *
+ * On return, the first *start bytes of buf have been consumed (skipped) and the result is the
+ * number of packets found, at buf + *start + i * sync->packet_size (at most max_packets of them;
+ * the 188 bytes of each are complete).  The caller continues at the end of the last packet it
+ * takes.  A result of 0 means more data is needed: the caller appends to the unconsumed bytes and
+ * calls again, or, with is_eof set, everything has been consumed.
+ */
+int ts_sync_scan(ts_sync_t *sync, const uint8_t *buf, size_t len, int is_eof, int max_packets, size_t *start);
+
+const char* ts_sync_packet_size_name(int packet_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,442 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "video_sap.h"
+#include "h264_stream.h"
+
+
+/**
+ * Minimal bit reader over the RBSP of a NAL unit: drops emulation prevention bytes and reads
+ * exp-Golomb codes, which is all that is needed for the first fields of headers.
+ */
+typedef struct
+{
+   const uint8_t *p;
+   const uint8_t *end;
+   int zeros;           // consecutive zero bytes read
+   uint32_t cur;
+   int bits_left;
+   int error;           // ran off the end of the buffer
+} rbsp_reader_t;
+
+static void rbsp_reader_init(rbsp_reader_t *r, const uint8_t *p, const uint8_t *end)
+{
+   r->p = p;
+   r->end = end;
+   r->zeros = 0;
+   r->cur = 0;
+   r->bits_left = 0;
+   r->error = 0;
+}
+
+static uint32_t rbsp_read_u1(rbsp_reader_t *r)
+{
+   if (r->bits_left == 0)
+   {
+      if (r->p >= r->end) { r->error = 1; return 0; }
+      uint8_t byte = *r->p++;
+      if (r->zeros >= 2 && byte == 0x03)
+      {
+         // emulation_prevention_three_byte
+         r->zeros = 0;
+         if (r->p >= r->end) { r->error = 1; return 0; }
+         byte = *r->p++;
+      }
+      r->zeros = (byte == 0) ? r->zeros + 1 : 0;
+      r->cur = byte;
+      r->bits_left = 8;
+   }
+   r->bits_left--;
+   return (r->cur >> r->bits_left) & 1;
+}
+
+static uint32_t rbsp_read_u(rbsp_reader_t *r, int n)
+{
+   uint32_t val = 0;
+   while (n-- > 0) val = (val << 1) | rbsp_read_u1(r);
+   return val;
+}
+
+static void rbsp_skip_bits(rbsp_reader_t *r, int n)
+{
+   while (n-- > 0 && !r->error) rbsp_read_u1(r);
+}
+
+static uint32_t rbsp_read_ue(rbsp_reader_t *r)
+{
+   int leading_zeros = 0;
+   while (rbsp_read_u1(r) == 0 && !r->error)
+   {
+      if (++leading_zeros > 31) { r->error = 1; return 0; }
+   }
+   if (r->error) return 0;
+   return ((1u << leading_zeros) - 1) + rbsp_read_u(r, leading_zeros);
+}
+
+/**
+ * @return offset of the first byte after the next 00 00 01 start code at or after pos,
+ *         or len if there is none
+ */
+static size_t next_nal_start(const uint8_t *buf, size_t len, size_t pos)
+{
+   while (pos + 3 <= len)
+   {
+      // the third byte of a start code is 01: skip ahead quickly while it cannot be
+      if (buf[pos + 2] > 1) { pos += 3; continue; }
+      if (buf[pos + 2] == 1 && buf[pos + 1] == 0 && buf[pos] == 0) return pos + 3;
+      pos++;
+   }
+   return len;
+}
+
+static void avc_sap_read_sps(avc_sap_state_t *state, rbsp_reader_t *r)
+{
+   rbsp_read_u(r, 24);   // profile_idc, constraint flags, level_idc
+   uint32_t sps_id = rbsp_read_ue(r);
+   if (!r->error && sps_id < 32) state->sps_seen |= (1u << sps_id);
+}
+
+static void avc_sap_read_pps(avc_sap_state_t *state, rbsp_reader_t *r)
+{
+   uint32_t pps_id = rbsp_read_ue(r);
+   uint32_t sps_id = rbsp_read_ue(r);
+   if (r->error || pps_id > 255 || sps_id > 31) return;
+   state->pps_seen[pps_id >> 5] |= (1u << (pps_id & 31));
+   state->pps_sps_id[pps_id] = sps_id;
+}
+
+static int avc_sap_has_recovery_point(rbsp_reader_t *r)
+{
+   // walk the sei_message()s until the payload type of a recovery point shows up; the
+   // last byte of the NAL unit is rbsp_trailing_bits
+   while (!r->error && (r->end - r->p > 1))
+   {
+      uint32_t payload_type = 0, payload_size = 0, byte;
+      while ((byte = rbsp_read_u(r, 8)) == 0xFF && !r->error) payload_type += 255;
+      payload_type += byte;
+      while ((byte = rbsp_read_u(r, 8)) == 0xFF && !r->error) payload_size += 255;
+      payload_size += byte;
+      if (r->error) return 0;
+      if (payload_type == SEI_TYPE_RECOVERY_POINT) return 1;
+      while (payload_size-- > 0 && !r->error) rbsp_read_u(r, 8);
+   }
+   return 0;
+}
+
+void avc_sap_state_init(avc_sap_state_t *state)
+{
+   memset(state, 0, sizeof(avc_sap_state_t));
+}
+
+int avc_sap_classify(avc_sap_state_t *state, const uint8_t *buf, size_t len, int peek_slice_header,
+                     avc_sap_info_t *info)
+{
+   avc_sap_info_t local_info;
+   if (info == NULL) info = &local_info;
+
+   info->sap_type = SAP_TYPE_NONE;
+   info->nal_unit_type = -1;
+   info->first_mb_in_slice = -1;
+   info->slice_type = -1;
+   info->pic_parameter_set_id = -1;
+   info->param_sets_present = 0;
+   info->recovery_point = 0;
+
+   if (buf == NULL) return SAP_TYPE_NONE;
+
+   size_t pos = 0;
+   while ((pos = next_nal_start(buf, len, pos)) < len)
+   {
+      int nal_unit_type = buf[pos] & 0x1F;
+      rbsp_reader_t r;
+      rbsp_reader_init(&r, buf + pos + 1, buf + len);
+
+      switch (nal_unit_type)
+      {
+         case NAL_UNIT_TYPE_SPS:
+            if (state != NULL) avc_sap_read_sps(state, &r);
+            break;
+         case NAL_UNIT_TYPE_PPS:
+            if (state != NULL) avc_sap_read_pps(state, &r);
+            break;
+         case NAL_UNIT_TYPE_SEI:
+         {
+            // SEI messages are walked to the end of the NAL unit, so find where it ends
+            size_t next = next_nal_start(buf, len, pos);
+            size_t end = (next < len) ? next - 3 : len;
+            while (end > pos && buf[end - 1] == 0) end--;   // trailing_zero_8bits
+            rbsp_reader_init(&r, buf + pos + 1, buf + end);
+            if (avc_sap_has_recovery_point(&r)) info->recovery_point = 1;
+            pos = (next < len) ? next - 3 : len;
+            continue;
+         }
+
+         case NAL_UNIT_TYPE_CODED_SLICE_IDR:
+         case NAL_UNIT_TYPE_CODED_SLICE_NON_IDR:
+         case NAL_UNIT_TYPE_CODED_SLICE_DATA_PARTITION_A:
+            info->nal_unit_type = nal_unit_type;
+            if (peek_slice_header)
+            {
+               uint32_t first_mb_in_slice = rbsp_read_ue(&r);
+               uint32_t slice_type = rbsp_read_ue(&r);
+               uint32_t pps_id = rbsp_read_ue(&r);
+               if (!r.error && slice_type <= 9 && pps_id <= 255)
+               {
+                  info->first_mb_in_slice = first_mb_in_slice;
+                  info->slice_type = slice_type;
+                  info->pic_parameter_set_id = pps_id;
+                  if (state != NULL && (state->pps_seen[pps_id >> 5] & (1u << (pps_id & 31))))
+                  {
+                     info->param_sets_present =
+                        (state->sps_seen & (1u << state->pps_sps_id[pps_id])) ? 1 : 0;
+                  }
+               }
+            }
+
+            if (nal_unit_type == NAL_UNIT_TYPE_CODED_SLICE_IDR)
+            {
+               info->sap_type = 1;
+            }
+            else if (info->slice_type >= 0 &&
+               ((info->slice_type % 5) == SH_SLICE_TYPE_I || (info->slice_type % 5) == SH_SLICE_TYPE_SI))
+            {
+               info->sap_type = 3;
+            }
+            return info->sap_type;
+
+         default:
+            break;
+      }
+
+      pos++;
+   }
+
+   return SAP_TYPE_NONE;
+}
+
+
+void avc_sap_update_state(avc_sap_state_t *state, const uint8_t *buf, size_t len)
+{
+   // parameter sets precede the slices of an access unit, so the walk to the first slice sees them
+   avc_sap_classify(state, buf, len, 0, NULL);
+}
+
+static void hevc_sap_read_vps(hevc_sap_state_t *state, rbsp_reader_t *r)
+{
+   uint32_t vps_id = rbsp_read_u(r, 4);
+   if (!r->error) state->vps_seen |= (1u << vps_id);
+}
+
+static void hevc_sap_read_sps(hevc_sap_state_t *state, rbsp_reader_t *r)
+{
+   uint32_t vps_id = rbsp_read_u(r, 4);
+   int max_sub_layers_minus1 = rbsp_read_u(r, 3);
+   rbsp_read_u1(r);   // sps_temporal_id_nesting_flag
+
+   // profile_tier_level(1, sps_max_sub_layers_minus1): the general part is 96 bits, each sub-layer
+   // adds 88 bits of profile and 8 of level if present
+   rbsp_skip_bits(r, 96);
+   int sub_layer_profile_present = 0, sub_layer_level_present = 0;
+   for (int i = 0; i < max_sub_layers_minus1; i++)
+   {
+      sub_layer_profile_present += rbsp_read_u1(r);
+      sub_layer_level_present += rbsp_read_u1(r);
+   }
+   if (max_sub_layers_minus1 > 0) rbsp_skip_bits(r, 2 * (8 - max_sub_layers_minus1));
+   rbsp_skip_bits(r, 88 * sub_layer_profile_present + 8 * sub_layer_level_present);
+
+   uint32_t sps_id = rbsp_read_ue(r);
+   if (r->error || sps_id > 15) return;
+   state->sps_seen |= (1u << sps_id);
+   state->sps_vps_id[sps_id] = vps_id;
+}
+
+static void hevc_sap_read_pps(hevc_sap_state_t *state, rbsp_reader_t *r)
+{
+   uint32_t pps_id = rbsp_read_ue(r);
+   uint32_t sps_id = rbsp_read_ue(r);
+   if (r->error || pps_id > 63 || sps_id > 15) return;
+   state->pps_seen |= (1ull << pps_id);
+   state->pps_sps_id[pps_id] = sps_id;
+}
+
+static int hevc_sap_param_sets_present(const hevc_sap_state_t *state, uint32_t pps_id)
+{
+   if (!(state->pps_seen & (1ull << pps_id))) return 0;
+   uint32_t sps_id = state->pps_sps_id[pps_id];
+   if (!(state->sps_seen & (1u << sps_id))) return 0;
+   return (state->vps_seen & (1u << state->sps_vps_id[sps_id])) ? 1 : 0;
+}
+
+void hevc_sap_state_init(hevc_sap_state_t *state)
+{
+   memset(state, 0, sizeof(hevc_sap_state_t));
+}
+
+int hevc_sap_classify(hevc_sap_state_t *state, const uint8_t *buf, size_t len, int peek_slice_header,
+                      hevc_sap_info_t *info)
+{
+   hevc_sap_info_t local_info;
+   if (info == NULL) info = &local_info;
+
+   info->sap_type = SAP_TYPE_NONE;
+   info->nal_unit_type = -1;
+   info->first_slice_segment_in_pic_flag = -1;
+   info->pic_parameter_set_id = -1;
+   info->param_sets_present = 0;
+
+   if (buf == NULL) return SAP_TYPE_NONE;
+
+   size_t pos = 0;
+   while ((pos = next_nal_start(buf, len, pos)) + 1 < len)
+   {
+      // nal_unit_header(): forbidden_zero_bit, nal_unit_type(6), nuh_layer_id(6), nuh_temporal_id_plus1(3)
+      int nal_unit_type = (buf[pos] >> 1) & 0x3F;
+      rbsp_reader_t r;
+      rbsp_reader_init(&r, buf + pos + 2, buf + len);
+
+      if (nal_unit_type < HEVC_NAL_UNIT_TYPE_VPS)
+      {
+         // the first VCL NAL unit decides
+         info->nal_unit_type = nal_unit_type;
+         if (peek_slice_header)
+         {
+            uint32_t first_slice_segment_in_pic_flag = rbsp_read_u1(&r);
+            if (nal_unit_type >= HEVC_NAL_UNIT_TYPE_BLA_W_LP && nal_unit_type <= HEVC_NAL_UNIT_TYPE_RSV_IRAP_23)
+            {
+               rbsp_read_u1(&r);   // no_output_of_prior_pics_flag
+            }
+            uint32_t pps_id = rbsp_read_ue(&r);
+            if (!r.error && pps_id <= 63)
+            {
+               info->first_slice_segment_in_pic_flag = first_slice_segment_in_pic_flag;
+               info->pic_parameter_set_id = pps_id;
+               if (state != NULL) info->param_sets_present = hevc_sap_param_sets_present(state, pps_id);
+            }
+         }
+
+         switch (nal_unit_type)
+         {
+            case HEVC_NAL_UNIT_TYPE_IDR_W_RADL:
+            case HEVC_NAL_UNIT_TYPE_IDR_N_LP:
+            case HEVC_NAL_UNIT_TYPE_BLA_W_RADL:
+            case HEVC_NAL_UNIT_TYPE_BLA_N_LP:
+               info->sap_type = 1;
+               break;
+            case HEVC_NAL_UNIT_TYPE_CRA_NUT:
+            case HEVC_NAL_UNIT_TYPE_BLA_W_LP:
+               info->sap_type = 3;
+               break;
+            default:
+               break;
+         }
+         return info->sap_type;
+      }
+
+      if (state != NULL)
+      {
+         switch (nal_unit_type)
+         {
+            case HEVC_NAL_UNIT_TYPE_VPS:
+               hevc_sap_read_vps(state, &r);
+               break;
+            case HEVC_NAL_UNIT_TYPE_SPS:
+               hevc_sap_read_sps(state, &r);
+               break;
+            case HEVC_NAL_UNIT_TYPE_PPS:
+               hevc_sap_read_pps(state, &r);
+               break;
+            default:
+               break;
+         }
+      }
+
+      pos++;
+   }
+
+   return SAP_TYPE_NONE;
+}
+
+void hevc_sap_update_state(hevc_sap_state_t *state, const uint8_t *buf, size_t len)
+{
+   hevc_sap_classify(state, buf, len, 0, NULL);
+}
+
+int mpeg2_sap_classify(const uint8_t *buf, size_t len, mpeg2_sap_info_t *info)
+{
+   mpeg2_sap_info_t local_info;
+   if (info == NULL) info = &local_info;
+
+   info->sap_type = SAP_TYPE_NONE;
+   info->picture_coding_type = -1;
+   info->sequence_header = 0;
+   info->gop_header = 0;
+   info->closed_gop = -1;
+   info->broken_link = -1;
+
+   if (buf == NULL) return SAP_TYPE_NONE;
+
+   size_t pos = 0;
+   while ((pos = next_nal_start(buf, len, pos)) < len)
+   {
+      // start codes are byte aligned and never emulated, so the fields are read straight from buf
+      switch (buf[pos])
+      {
+         case MPEG2_SEQUENCE_HEADER_CODE:
+            info->sequence_header = 1;
+            break;
+
+         case MPEG2_GROUP_START_CODE:
+            // time_code(25), closed_gop(1), broken_link(1)
+            if (pos + 4 < len)
+            {
+               info->gop_header = 1;
+               info->closed_gop = (buf[pos + 4] >> 6) & 0x01;
+               info->broken_link = (buf[pos + 4] >> 5) & 0x01;
+            }
+            break;
+
+         case MPEG2_PICTURE_START_CODE:
+            // temporal_reference(10), picture_coding_type(3)
+            if (pos + 2 >= len) return SAP_TYPE_NONE;
+            info->picture_coding_type = (buf[pos + 2] >> 3) & 0x07;
+            if (info->picture_coding_type == MPEG2_PICTURE_CODING_TYPE_I)
+            {
+               info->sap_type = (info->closed_gop == 1) ? 1 : 3;
+            }
+            return info->sap_type;
+
+         default:
+            break;
+      }
+
+      pos++;
+   }
+
+   return SAP_TYPE_NONE;
+}
@@ -0,0 +1,190 @@
+/*
+ Copyright (c) 2014-, ISO/IEC JTC1/SC29/WG11
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of ISO/IEC nor the
+ names of its contributors may be used to endorse or promote products
+ derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TSLIB_VIDEO_SAP_H_
+#define _TSLIB_VIDEO_SAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SAP_TYPE_NONE   0   /// the payload does not start with a stream access point
+
+/**
+ * Per-PID parameter set state for the AVC SAP classifier.  Only the parameter set ids are
+ * kept -- enough to tell whether the SPS and PPS a slice refers to have been seen, without
+ * allocating or parsing full parameter sets.  A zero-initialized state is valid.
+ */
+typedef struct
+{
+   uint32_t sps_seen;          /// bit per seq_parameter_set_id (0..31)
+   uint32_t pps_seen[8];       /// bit per pic_parameter_set_id (0..255)
+   uint8_t pps_sps_id[256];    /// seq_parameter_set_id referenced by each PPS
+} avc_sap_state_t;
+
+/**
+ * Details of what the AVC SAP classifier saw up to (and including) the first coded slice.
+ */
+typedef struct
+{
+   int sap_type;               /// 1..3, or SAP_TYPE_NONE
+   int nal_unit_type;          /// of the first coded slice, -1 if there is none in the buffer
+   int first_mb_in_slice;      /// -1 if the slice header was not read
+   int slice_type;             /// 0..9 as coded, -1 if the slice header was not read
+   int pic_parameter_set_id;   /// -1 if the slice header was not read
+   int param_sets_present;     /// the PPS and SPS referenced by the slice have been seen on this PID
+   int recovery_point;         /// a recovery point SEI precedes the slice
+} avc_sap_info_t;
+
+void avc_sap_state_init(avc_sap_state_t *state);
+
+/**
+ * Classifies the access unit at the start of an AVC PES payload by walking NAL unit headers up
+ * to the first coded slice: an IDR picture is SAP type 1; with peek_slice_header set, a non-IDR
+ * picture whose first slice is an I or SI slice is SAP type 3 (open GOP).  SPS, PPS and SEI NAL
+ * units on the way update state and info.  Nothing is allocated and only the first few bytes of
+ * each NAL unit are read.
+ *
+ * @param state per-PID parameter set state, may be NULL
+ * @param info optional, receives the details
+ * @return the SAP type, or SAP_TYPE_NONE
+ */
+int avc_sap_classify(avc_sap_state_t *state, const uint8_t *buf, size_t len, int peek_slice_header,
+                     avc_sap_info_t *info);
+
+/**
+ * Records the SPS and PPS NAL units at the start of an AVC PES payload in state, without
+ * classifying it.  Meant for the PES packets that are not at a boundary, so that parameter sets
+ * are tracked wherever they occur; like avc_sap_classify, it stops at the first coded slice.
+ */
+void avc_sap_update_state(avc_sap_state_t *state, const uint8_t *buf, size_t len);
+
+/**
+ * HEVC NAL unit types (ITU-T H.265 Table 7-1) the classifier looks at
+ */
+#define HEVC_NAL_UNIT_TYPE_BLA_W_LP         16
+#define HEVC_NAL_UNIT_TYPE_BLA_W_RADL       17
+#define HEVC_NAL_UNIT_TYPE_BLA_N_LP         18
+#define HEVC_NAL_UNIT_TYPE_IDR_W_RADL       19
+#define HEVC_NAL_UNIT_TYPE_IDR_N_LP         20
+#define HEVC_NAL_UNIT_TYPE_CRA_NUT          21
+#define HEVC_NAL_UNIT_TYPE_RSV_IRAP_23      23
+#define HEVC_NAL_UNIT_TYPE_VPS              32
+#define HEVC_NAL_UNIT_TYPE_SPS              33
+#define HEVC_NAL_UNIT_TYPE_PPS              34
+
+/**
+ * Per-PID parameter set state for the HEVC SAP classifier: the VPS, SPS and PPS ids seen so far
+ * and what each SPS and PPS refers to.  A zero-initialized state is valid.
+ */
+typedef struct
+{
+   uint16_t vps_seen;          /// bit per vps_video_parameter_set_id (0..15)
+   uint16_t sps_seen;          /// bit per sps_seq_parameter_set_id (0..15)
+   uint64_t pps_seen;          /// bit per pps_pic_parameter_set_id (0..63)
+   uint8_t sps_vps_id[16];     /// vps_video_parameter_set_id referenced by each SPS
+   uint8_t pps_sps_id[64];     /// sps_seq_parameter_set_id referenced by each PPS
+} hevc_sap_state_t;
+
+/**
+ * Details of what the HEVC SAP classifier saw up to (and including) the first VCL NAL unit.
+ */
+typedef struct
+{
+   int sap_type;                          /// 1..3, or SAP_TYPE_NONE
+   int nal_unit_type;                     /// of the first VCL NAL unit, -1 if there is none in the buffer
+   int first_slice_segment_in_pic_flag;   /// -1 if the slice segment header was not read
+   int pic_parameter_set_id;              /// -1 if the slice segment header was not read
+   int param_sets_present;                /// the PPS, SPS and VPS referenced by the slice have been seen on this PID
+} hevc_sap_info_t;
+
+void hevc_sap_state_init(hevc_sap_state_t *state);
+
+/**
+ * Records the VPS, SPS and PPS NAL units at the start of an HEVC PES payload in state, without
+ * classifying it; the HEVC counterpart of avc_sap_update_state.
+ */
+void hevc_sap_update_state(hevc_sap_state_t *state, const uint8_t *buf, size_t len);
+
+/**
+ * Classifies the access unit at the start of an HEVC PES payload from the type of its first VCL
+ * NAL unit: IDR_W_RADL, IDR_N_LP, BLA_N_LP and BLA_W_RADL are SAP type 1, CRA and BLA_W_LP (which
+ * may be followed by RASL pictures) are SAP type 3, anything else is not a SAP.  Leading RADL
+ * pictures cannot be detected without looking past the access unit, so *_W_RADL is reported as
+ * SAP type 1 rather than 2.  VPS, SPS and PPS NAL units on the way update state; with
+ * peek_slice_header set, the slice segment header is read up to slice_pic_parameter_set_id.
+ *
+ * @param state per-PID parameter set state, may be NULL
+ * @param info optional, receives the details
+ * @return the SAP type, or SAP_TYPE_NONE
+ */
+int hevc_sap_classify(hevc_sap_state_t *state, const uint8_t *buf, size_t len, int peek_slice_header,
+                      hevc_sap_info_t *info);
+
+/**
+ * MPEG-2 video start code values (ISO/IEC 13818-2 Table 6-1) the classifier looks at
+ */
+#define MPEG2_PICTURE_START_CODE            0x00
+#define MPEG2_SEQUENCE_HEADER_CODE          0xB3
+#define MPEG2_GROUP_START_CODE              0xB8
+
+#define MPEG2_PICTURE_CODING_TYPE_I         1
+#define MPEG2_PICTURE_CODING_TYPE_P         2
+#define MPEG2_PICTURE_CODING_TYPE_B         3
+
+/**
+ * Details of what the MPEG-2 video SAP classifier saw up to (and including) the first picture header.
+ */
+typedef struct
+{
+   int sap_type;                 /// 1 or 3, or SAP_TYPE_NONE
+   int picture_coding_type;      /// of the first picture, -1 if there is no picture header in the buffer
+   int sequence_header;          /// a sequence_header() precedes the picture
+   int gop_header;               /// a group_of_pictures_header() precedes the picture
+   int closed_gop;               /// -1 if there is no GOP header
+   int broken_link;              /// -1 if there is no GOP header
+} mpeg2_sap_info_t;
+
+/**
+ * Classifies the picture at the start of an MPEG-2 video PES payload from its start codes: an I
+ * picture in a closed GOP is SAP type 1; an I picture in an open GOP, or with no GOP header in
+ * front of it, is SAP type 3 (B pictures following it may reference the previous GOP).  Only
+ * the GOP header flags and picture_coding_type are read; the scan stops at the first picture.
+ *
+ * @param info optional, receives the details
+ * @return the SAP type, or SAP_TYPE_NONE
+ */
+int mpeg2_sap_classify(const uint8_t *buf, size_t len, mpeg2_sap_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _TSLIB_VIDEO_SAP_H_